@@ -0,0 +1,181 @@
+#pragma once
+//
+//  AsyncListener.h
+//  MTH 9815
+//
+
+#ifndef AsyncListener_h
+#define AsyncListener_h
+
+#include <atomic>
+#include <thread>
+#include <optional>
+#include <functional>
+#include <cstddef>
+#include "soa.hpp"
+#include "SpscRing.h"
+
+using namespace std;
+
+/**
+* A hop between two services run on a worker thread, stopped through this base so hops of any event type can be
+* kept in one list.
+*/
+class AsyncHop
+{
+public:
+	virtual ~AsyncHop() {};
+
+	// start the worker thread
+	virtual void Start() = 0;
+
+	// deliver the events still queued and join the worker thread
+	virtual void Stop() = 0;
+};
+
+/**
+* ServiceListener that hands the events of a service to another listener on a worker thread of its own.
+* ProcessAdd, ProcessRemove and ProcessUpdate copy the event into a bounded SpscRing and return, waiting only while
+* the ring is full; the worker takes the events off in order and calls the same method of target, so target and
+* everything it notifies in turn run on the worker thread. Put one between two services with AddListener to split a
+* chain across threads, one hop at a time. The ring has one producer: register an AsyncListener with one service,
+* fed by one thread. The services behind it must not be used from other threads until Stop has returned, and the
+* products must be registered before Start. Until Start, and after Stop, events are passed to target inline; a stopped
+* listener does not start again.
+*/
+template<typename V>
+class AsyncListener : public ServiceListener<V>, public AsyncHop
+{
+private:
+	enum EventKind { EVENT_ADD, EVENT_REMOVE, EVENT_UPDATE, EVENT_JOB };
+
+	// events have no default constructor, so the slots hold them in an optional
+	struct Event
+	{
+		EventKind kind = EVENT_ADD;
+		std::optional<V> data;
+		std::function<void()> job;
+	};
+
+	ServiceListener<V>* target;
+	SpscRing<Event> ring;
+	std::thread worker;
+	std::atomic<bool> running{ false };
+	bool stopped = false;                  // the ring is closed for good once stopped
+	std::atomic<size_t> delivered{ 0 };
+
+	void Enqueue(EventKind kind, V& data)
+	{
+		Event* slot = ring.Claim();
+		slot->kind = kind;
+		slot->data.emplace(data);
+		ring.Publish();
+	};
+
+	void Deliver(Event& event)
+	{
+		switch (event.kind)
+		{
+		case EVENT_ADD: target->ProcessAdd(*event.data); break;
+		case EVENT_REMOVE: target->ProcessRemove(*event.data); break;
+		case EVENT_UPDATE: target->ProcessUpdate(*event.data); break;
+		case EVENT_JOB:
+			event.job();
+			event.job = nullptr;
+			return;
+		}
+		event.data.reset();
+		delivered.store(delivered.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	};
+
+	void Run()
+	{
+		while (Event* event = ring.Front())
+		{
+			Deliver(*event);
+			ring.Pop();
+		}
+	};
+
+public:
+	AsyncListener(ServiceListener<V>* _target, size_t queueCapacity = 1 << 12) : target(_target), ring(queueCapacity) {};
+
+	~AsyncListener()
+	{
+		Stop();
+	};
+
+	void Start()
+	{
+		if (stopped || running.exchange(true)) return;
+		worker = std::thread(&AsyncListener::Run, this);
+	};
+
+	void Stop()
+	{
+		if (!running.load()) return;
+		ring.Close();
+		worker.join();
+		running.store(false);
+		stopped = true;
+	};
+
+	void ProcessAdd(V& data)
+	{
+		if (running.load(std::memory_order_relaxed)) Enqueue(EVENT_ADD, data);
+		else target->ProcessAdd(data);
+	};
+
+	void ProcessRemove(V& data)
+	{
+		if (running.load(std::memory_order_relaxed)) Enqueue(EVENT_REMOVE, data);
+		else target->ProcessRemove(data);
+	};
+
+	void ProcessUpdate(V& data)
+	{
+		if (running.load(std::memory_order_relaxed)) Enqueue(EVENT_UPDATE, data);
+		else target->ProcessUpdate(data);
+	};
+
+	// run job on the worker thread after the events queued before it, inline if the worker is not running;
+	// call it on the thread feeding the events, the ring has one producer
+	void Post(std::function<void()> job)
+	{
+		if (!running.load(std::memory_order_relaxed))
+		{
+			job();
+			return;
+		}
+		Event* slot = ring.Claim();
+		slot->kind = EVENT_JOB;
+		slot->job = std::move(job);
+		ring.Publish();
+	};
+
+	// listener the events are handed to
+	ServiceListener<V>* GetTarget() const
+	{
+		return target;
+	};
+
+	// events handed to target on the worker thread
+	size_t GetDelivered() const
+	{
+		return delivered.load(std::memory_order_relaxed);
+	};
+
+	// times ProcessAdd found the queue full and waited, read after Stop
+	size_t GetProducerStalls() const
+	{
+		return ring.GetProducerStalls();
+	};
+
+	// largest number of queued events seen by the worker, read after Stop
+	size_t GetMaxOccupancy() const
+	{
+		return ring.GetMaxOccupancy();
+	};
+};
+
+#endif /* AsyncListener_h */
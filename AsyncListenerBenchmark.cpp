@@ -0,0 +1,145 @@
+//
+//  AsyncListenerBenchmark.cpp
+//  MTH 9815
+//
+//  Times AsyncListener hops: the latency of one hop, from ProcessAdd on the producer to the listener behind it
+//  on the worker thread, and the throughput of the market data -> algo execution -> execution -> historical
+//  execution chain with every combination of inline and async hops.
+//  usage: AsyncListenerBenchmark [passes] [latency events]
+//    passes  times input/marketdata.txt is replayed through the chain, the file is generated if missing
+//    run it from a directory with input and output folders, the chain writes output/execution.txt
+//
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include "products.hpp"
+#include "BondMarketDataService.h"
+#include "BondAlgoExecutionService.h"
+#include "BondExecutionService.h"
+#include "BondHistoricalDataService.h"
+#include "GenerateMarketDataFile.h"
+#include "AsyncListener.h"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+struct Stamp
+{
+	benchmark_clock::time_point sent;
+};
+
+// records how long each event took to arrive
+class LatencyListener : public ServiceListener<Stamp>
+{
+public:
+	std::vector<double> latencies;
+
+	void ProcessAdd(Stamp& data) override
+	{
+		latencies.push_back(std::chrono::duration<double, std::nano>(benchmark_clock::now() - data.sent).count());
+	}
+	void ProcessRemove(Stamp&) override {}
+	void ProcessUpdate(Stamp&) override {}
+};
+
+// percentiles of the latency of one hop, events sent back to back or spaced by gapMicros
+static void HopLatency(size_t events, long gapMicros)
+{
+	LatencyListener sink;
+	sink.latencies.reserve(events);
+	AsyncListener<Stamp> hop(&sink);
+	hop.Start();
+	for (size_t i = 0; i < events; ++i)
+	{
+		if (gapMicros > 0)
+		{
+			auto until = benchmark_clock::now() + std::chrono::microseconds(gapMicros);
+			while (benchmark_clock::now() < until) std::this_thread::yield();
+		}
+		Stamp stamp = { benchmark_clock::now() };
+		hop.ProcessAdd(stamp);
+	}
+	hop.Stop();
+
+	std::vector<double>& latencies = sink.latencies;
+	std::sort(latencies.begin(), latencies.end());
+	auto at = [&latencies](double q) { return latencies[std::min(latencies.size() - 1, size_t(q * latencies.size()))] / 1000; };
+	std::cout << "  " << (gapMicros > 0 ? "spaced " : "burst  ") << events << " events: p50 " << at(0.5) << " us, p99 " << at(0.99)
+		<< " us, max " << latencies.back() / 1000 << " us, producer waited " << hop.GetProducerStalls() << " times" << std::endl;
+}
+
+// passes an event on to whichever listener the current run put in slot
+template<typename V>
+class Forwarder : public ServiceListener<V>
+{
+private:
+	ServiceListener<V>** slot;
+
+public:
+	explicit Forwarder(ServiceListener<V>** _slot) : slot(_slot) {}
+	void ProcessAdd(V& data) override { (*slot)->ProcessAdd(data); }
+	void ProcessRemove(V& data) override { (*slot)->ProcessRemove(data); }
+	void ProcessUpdate(V& data) override { (*slot)->ProcessUpdate(data); }
+};
+
+// where the services of the chain send their events, services keep their listeners for good so each run
+// points these at the next listener or at an async hop in front of it
+static ServiceListener<OrderBook<Bond>>* toAlgo = nullptr;
+static ServiceListener<BondAlgoExecution>* toExecution = nullptr;
+static ServiceListener<ExecutionOrder<Bond>>* toHistorical = nullptr;
+
+// the chain with each of its three hops inline or async
+static void ChainThroughput(bool async1, bool async2, bool async3, int passes)
+{
+	AsyncListener<OrderBook<Bond>> hop1(BondAlgoExecutionServiceListener::create_listener());
+	AsyncListener<BondAlgoExecution> hop2(BondExecutionServiceListener::create_listener());
+	AsyncListener<ExecutionOrder<Bond>> hop3(BondHisExecutionServiceListener::create_listener());
+	std::vector<AsyncHop*> hops;
+	toAlgo = hop1.GetTarget();
+	toExecution = hop2.GetTarget();
+	toHistorical = hop3.GetTarget();
+	if (async1) { toAlgo = &hop1; hops.push_back(&hop1); }
+	if (async2) { toExecution = &hop2; hops.push_back(&hop2); }
+	if (async3) { toHistorical = &hop3; hops.push_back(&hop3); }
+	for (auto hop : hops) hop->Start();
+
+	std::cout.setstate(std::ios::failbit);
+	auto start = benchmark_clock::now();
+	for (int pass = 0; pass < passes; ++pass) BondMarketDataConnector::create_connector()->Subscribe();
+	auto ingested = benchmark_clock::now();
+	for (auto hop : hops) hop->Stop();
+	BondHisExecutionConnector::create_connector()->Flush();
+	auto done = benchmark_clock::now();
+	std::cout.clear();
+
+	std::cout << "  " << (async1 ? "async " : "inline") << " " << (async2 ? "async " : "inline") << " " << (async3 ? "async " : "inline")
+		<< ": ingest done " << std::chrono::duration<double, std::milli>(ingested - start).count() << " ms, chain done "
+		<< std::chrono::duration<double, std::milli>(done - start).count() << " ms" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int passes = argc > 1 ? std::atoi(argv[1]) : 20;
+	size_t events = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200000;
+
+	std::cout << "one hop, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	HopLatency(events, 0);
+	HopLatency(events / 20, 20);
+
+	if (!std::ifstream("input/marketdata.txt")) generate_marketdata();
+	std::vector<Bond> bonds = default_bonds();
+	for (auto& bond : bonds) BondProductService::create_service()->Add(bond);
+	BondHisExecutionConnector::create_connector()->SetFlushConfig(FlushConfig(FLUSH_EVERY_N, IO_DEFAULT));
+
+	// wire the chain once through forwarders
+	BondMarketDataConnector::create_connector()->GetService()->AddListener(new Forwarder<OrderBook<Bond>>(&toAlgo));
+	BondAlgoExecutionServiceListener::create_listener()->GetService()->AddListener(new Forwarder<BondAlgoExecution>(&toExecution));
+	BondExecutionServiceListener::create_listener()->GetService()->AddListener(new Forwarder<ExecutionOrder<Bond>>(&toHistorical));
+
+	std::cout << "market data -> algo execution -> execution -> historical execution, " << passes << " passes" << std::endl;
+	for (int mask = 0; mask < 8; ++mask) ChainThroughput((mask & 4) != 0, (mask & 2) != 0, (mask & 1) != 0, passes);
+	return 0;
+}
@@ -0,0 +1,250 @@
+#pragma once
+//
+//  AsyncPersister.h
+//  MTH 9815
+//
+
+#ifndef AsyncPersister_h
+#define AsyncPersister_h
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include "MpscQueue.h"
+
+using namespace std;
+
+// what Enqueue does when the persistence queue is full
+// OVERFLOW_BLOCK waits for the writer thread to make room, OVERFLOW_DROP discards the record and counts it
+enum OverflowPolicy { OVERFLOW_BLOCK, OVERFLOW_DROP };
+
+/**
+* Settings of the asynchronous persistence thread.
+*/
+struct PersistConfig
+{
+	size_t queueCapacity = 1 << 16;      // records waiting for the writer thread
+	OverflowPolicy overflow = OVERFLOW_BLOCK;
+	size_t maxBatch = 4096;              // records written per group commit at most
+
+	PersistConfig() {};
+	PersistConfig(size_t _queueCapacity, OverflowPolicy _overflow) : queueCapacity(_queueCapacity), overflow(_overflow) {};
+};
+
+// largest compact record a sink can put on the persistence queue
+const size_t PERSIST_PAYLOAD_BYTES = 120;
+
+/**
+* Destination of persisted records, typically one output file.
+* WriteRecord and Commit are only called on the persistence thread.
+*/
+class PersistSink
+{
+public:
+	virtual ~PersistSink() {};
+
+	// format one record taken off the queue
+	virtual void WriteRecord(const unsigned char* payload) = 0;
+
+	// make the records written since the last commit durable, called once per batch
+	virtual void Commit() = 0;
+};
+
+/**
+* Fixed-size entry of the persistence queue: the sink and a copy of its compact record.
+*/
+struct PersistRecord
+{
+	PersistSink* sink;
+	alignas(8) unsigned char payload[PERSIST_PAYLOAD_BYTES];
+
+	template<typename R>
+	static PersistRecord Make(PersistSink* sink, const R& record)
+	{
+		static_assert(std::is_trivially_copyable<R>::value, "persisted records are copied as bytes");
+		static_assert(sizeof(R) <= PERSIST_PAYLOAD_BYTES, "persisted record is too large");
+		PersistRecord entry;
+		entry.sink = sink;
+		std::memcpy(entry.payload, &record, sizeof(R));
+		return entry;
+	};
+
+	template<typename R>
+	static R Load(const unsigned char* payload)
+	{
+		R record;
+		std::memcpy(&record, payload, sizeof(R));
+		return record;
+	};
+};
+
+/**
+* Counters of the asynchronous persistence thread.
+*/
+struct PersistStats
+{
+	size_t enqueued = 0;     // records accepted by Enqueue
+	size_t dropped = 0;      // records discarded because the queue was full
+	size_t blocked = 0;      // Enqueue calls that had to wait for room
+	size_t written = 0;      // records written by the persistence thread
+	size_t commits = 0;      // batches committed
+	size_t largestBatch = 0;
+
+	friend ostream& operator<<(ostream& os, const PersistStats& stats)
+	{
+		os << "enqueued: " << stats.enqueued << ", written: " << stats.written << ", dropped: " << stats.dropped
+			<< ", blocked: " << stats.blocked << ", commits: " << stats.commits
+			<< ", records/commit avg/max: " << (stats.commits ? double(stats.written) / stats.commits : 0.0) << "/" << stats.largestBatch;
+		return os;
+	};
+};
+
+/**
+* Background writer for the historical data services.
+* PersistData on any thread enqueues a compact record into a bounded lock-free queue and returns; one persistence
+* thread drains the queue in batches of up to maxBatch records, hands each record to its sink and then commits
+* every sink touched by the batch once (group commit), so a slow disk costs one flush per file per batch and never
+* stalls the pricing and execution paths unless the queue is full and the overflow policy is OVERFLOW_BLOCK.
+*/
+class AsyncPersister
+{
+private:
+	PersistConfig config;
+	MpscQueue<PersistRecord> queue;
+	std::thread worker;
+	std::atomic<bool> running{ false };
+
+	// producer counters
+	std::atomic<size_t> enqueued{ 0 };
+	std::atomic<size_t> dropped{ 0 };
+	std::atomic<size_t> blocked{ 0 };
+	// persistence thread counters
+	std::atomic<size_t> written{ 0 };
+	std::atomic<size_t> commits{ 0 };
+	std::atomic<size_t> largestBatch{ 0 };
+
+	// drain up to maxBatch records and commit their sinks, returns the number of records written
+	size_t WriteBatch(std::vector<PersistSink*>& touched)
+	{
+		PersistRecord record;
+		size_t count = 0;
+		while (count < config.maxBatch && queue.TryPop(record))
+		{
+			record.sink->WriteRecord(record.payload);
+			if (std::find(touched.begin(), touched.end(), record.sink) == touched.end()) touched.push_back(record.sink);
+			++count;
+		}
+		if (count == 0) return 0;
+
+		for (auto sink : touched) sink->Commit();
+		touched.clear();
+		written.store(written.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+		commits.store(commits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (count > largestBatch.load(std::memory_order_relaxed)) largestBatch.store(count, std::memory_order_relaxed);
+		return count;
+	};
+
+	void Run()
+	{
+		std::vector<PersistSink*> touched;
+		size_t idle = 0;
+		while (true)
+		{
+			// read the flag first so records enqueued before Stop() are always drained
+			bool stopping = !running.load(std::memory_order_acquire);
+			if (WriteBatch(touched) > 0)
+			{
+				idle = 0;
+				continue;
+			}
+			if (stopping) return;
+			// back off from yielding to short sleeps while there is nothing to write
+			if (++idle < 64) std::this_thread::yield();
+			else std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	};
+
+public:
+	explicit AsyncPersister(const PersistConfig& _config = PersistConfig()) :
+		config(_config), queue(_config.queueCapacity)
+	{
+		config.maxBatch = std::max<size_t>(1, config.maxBatch);
+	};
+
+	~AsyncPersister()
+	{
+		Stop();
+	};
+
+	// start the persistence thread
+	void Start()
+	{
+		if (running.exchange(true)) return;
+		worker = std::thread(&AsyncPersister::Run, this);
+	};
+
+	// write everything still queued and stop the persistence thread
+	void Stop()
+	{
+		running.store(false, std::memory_order_release);
+		if (worker.joinable()) worker.join();
+	};
+
+	bool IsRunning() const
+	{
+		return running.load(std::memory_order_relaxed);
+	};
+
+	// queue a compact record for sink, false if it was dropped
+	template<typename R>
+	bool Enqueue(PersistSink* sink, const R& record)
+	{
+		PersistRecord entry = PersistRecord::Make(sink, record);
+		if (!queue.TryPush(entry))
+		{
+			if (config.overflow == OVERFLOW_DROP)
+			{
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			blocked.fetch_add(1, std::memory_order_relaxed);
+			while (!queue.TryPush(entry)) std::this_thread::yield();
+		}
+		enqueued.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	};
+
+	const PersistConfig& GetConfig() const
+	{
+		return config;
+	};
+
+	// counters, exact once the thread is stopped
+	PersistStats GetStats() const
+	{
+		PersistStats stats;
+		stats.enqueued = enqueued.load(std::memory_order_relaxed);
+		stats.dropped = dropped.load(std::memory_order_relaxed);
+		stats.blocked = blocked.load(std::memory_order_relaxed);
+		stats.written = written.load(std::memory_order_relaxed);
+		stats.commits = commits.load(std::memory_order_relaxed);
+		stats.largestBatch = largestBatch.load(std::memory_order_relaxed);
+		return stats;
+	};
+
+	// create the shared AsyncPersister object as a pointer, config is only used by the first call
+	static AsyncPersister* create_persister(const PersistConfig& config = PersistConfig())
+	{
+		static AsyncPersister persister(config);
+		return &persister;
+	};
+};
+
+#endif /* AsyncPersister_h */
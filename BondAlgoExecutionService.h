@@ -38,11 +38,14 @@ public:
 	ExecutionOrder() {};
 
 	// ctor for an order
-	ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder);
+	ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, TickPrice _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder);
 
 	// Get the product
 	const T& GetProduct() const;
 
+	// Get the side on this order
+	PricingSide GetSide() const;
+
 	// Get the order ID
 	const string& GetOrderId() const;
 
@@ -50,7 +53,7 @@ public:
 	OrderType GetOrderType() const;
 
 	// Get the price on this order
-	double GetPrice() const;
+	TickPrice GetPrice() const;
 
 	// Get the visible quantity on this order
 	long GetVisibleQuantity() const;
@@ -87,11 +90,11 @@ public:
 	};
 
 private:
-	T product;
+	ProductHandle<T> product;
 	PricingSide side;
 	string orderId;
 	OrderType orderType;
-	double price;
+	TickPrice price;
 	double visibleQuantity;
 	double hiddenQuantity;
 	string parentOrderId;
@@ -116,7 +119,7 @@ public:
 };
 
 template<typename T>
-ExecutionOrder<T>::ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder) :
+ExecutionOrder<T>::ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, TickPrice _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder) :
 	product(_product)
 {
 	side = _side;
@@ -132,7 +135,13 @@ ExecutionOrder<T>::ExecutionOrder(const T &_product, PricingSide _side, string _
 template<typename T>
 const T& ExecutionOrder<T>::GetProduct() const
 {
-	return product;
+	return product.Get();
+}
+
+template<typename T>
+PricingSide ExecutionOrder<T>::GetSide() const
+{
+	return side;
 }
 
 template<typename T>
@@ -148,7 +157,7 @@ OrderType ExecutionOrder<T>::GetOrderType() const
 }
 
 template<typename T>
-double ExecutionOrder<T>::GetPrice() const
+TickPrice ExecutionOrder<T>::GetPrice() const
 {
 	return price;
 }
@@ -201,8 +210,8 @@ public:
         PricingSide side;
         Order bidOrder;
         Order offerOrder;
-        double bidPrice;
-        double offerPrice;
+        TickPrice bidPrice;
+        TickPrice offerPrice;
         long bidVisQ;
         long offerVisQ;
         long hidQ = 0;
@@ -256,7 +265,7 @@ class BondAlgoExecutionService: public Service<std::string, BondAlgoExecution>
 {
 private:
 	// map to store algo stream data
-    std::map<std::string, BondAlgoExecution> algoExeData;              
+    ProductTable<BondAlgoExecution> algoExeData;              
 	// member listeners
     std::vector<ServiceListener<BondAlgoExecution>*> alExListeners;      
     BondAlgoExecutionService() {};
@@ -265,7 +274,7 @@ public:
     // get algo exe data
     BondAlgoExecution& GetData(std::string key) 
     {
-        return algoExeData.at(key);
+        return algoExeData.At(key);
     }
     
 	// no implementation
@@ -285,9 +294,9 @@ public:
     {
         // add information
         //Bond thisBond = order.GetProduct();
-        string proId = order.GetProduct().GetProductId();
+        ProductIndex proId = order.GetProduct().GetProductIndex();
         BondAlgoExecution newExe(order);
-        algoExeData.insert(std::make_pair(proId, newExe));
+        algoExeData.Insert(proId, newExe);
         
         // notify listeners 
         BondAlgoExecution algExe = algoExeData[proId];
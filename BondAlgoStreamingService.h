@@ -35,13 +35,13 @@ public:
 	PriceStreamOrder() {};
 
 	// ctor for an order
-	PriceStreamOrder(double _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side);
+	PriceStreamOrder(TickPrice _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side);
 
 	// The side on this order
 	PricingSide GetSide() const;
 
 	// Get the price on this order
-	double GetPrice() const;
+	TickPrice GetPrice() const;
 
 	// Get the visible quantity on this order
 	long GetVisibleQuantity() const;
@@ -50,7 +50,7 @@ public:
 	long GetHiddenQuantity() const;
 
 private:
-	double price;
+	TickPrice price;
 	long visibleQuantity;
 	long hiddenQuantity;
 	PricingSide side;
@@ -83,7 +83,7 @@ public:
 	const PriceStreamOrder& GetOfferOrder() const;
 
 private:
-	T product;
+	ProductHandle<T> product;
 	PriceStreamOrder bidOrder;
 	PriceStreamOrder offerOrder;
 
@@ -105,7 +105,7 @@ public:
 
 };
 
-PriceStreamOrder::PriceStreamOrder(double _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side)
+PriceStreamOrder::PriceStreamOrder(TickPrice _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side)
 {
 	price = _price;
 	visibleQuantity = _visibleQuantity;
@@ -113,7 +113,7 @@ PriceStreamOrder::PriceStreamOrder(double _price, long _visibleQuantity, long _h
 	side = _side;
 }
 
-double PriceStreamOrder::GetPrice() const
+TickPrice PriceStreamOrder::GetPrice() const
 {
 	return price;
 }
@@ -142,7 +142,7 @@ PriceStream<T>::PriceStream(const T &_product, const PriceStreamOrder &_bidOrder
 template<typename T>
 const T& PriceStream<T>::GetProduct() const
 {
-	return product;
+	return product.Get();
 }
 
 template<typename T>
@@ -173,11 +173,12 @@ public:
     // ctor with price
     BondAlgoStream (Price<Bond>& price)
 	{
-		Bond bond = price.GetProduct();
-        double midPrice = price.GetMid();
-        double spread = price.GetBidOfferSpread();
-        double bidPrice = midPrice - (spread / 2);
-        double offerPrice = midPrice + (spread / 2);
+		const Bond& bond = price.GetProduct();
+        TickPrice midPrice = price.GetMid();
+        TickPrice spread = price.GetBidOfferSpread();
+        // quote on the 1/256 grid: an odd spread puts the extra half tick on the offer side
+        TickPrice bidPrice = midPrice - spread / 2;
+        TickPrice offerPrice = bidPrice + spread;
         long bidVisQ = 1000000;  // some algorithm
         long bidHidQ = 2000000;
         long offerVisQ = 5000000;
@@ -203,25 +204,33 @@ class BondAlgoStreamingService: public Service<string, BondAlgoStream>
 {
 private:
 	// map to store algo stream data
-    std::map<std::string, BondAlgoStream> algStrData;           
+    ProductTable<BondAlgoStream> algStrData;           
 	// member listeners
     std::vector<ServiceListener<BondAlgoStream>*> alStrListeners;      
     BondAlgoStreamingService() {};
     
 public:
-	// add a price
-    void AddPrice(Price<Bond>& price)
+	// add a price, handing the algo stream to next instead of the listeners
+    template<typename Next>
+    void AddPrice(Price<Bond>& price, Next& next)
     {
         std::cout << "flow the data from bondalgostreaming to the listener." << std::endl;
         
         // add information
-        std::string prodId = price.GetProduct().GetProductId();
+        ProductIndex prodId = price.GetProduct().GetProductIndex();
         BondAlgoStream newBStream(price);
-        algStrData.insert(std::make_pair(prodId, newBStream));
+        algStrData.Insert(prodId, newBStream);
         
-        // notify all listeners 
         BondAlgoStream bStream = algStrData[prodId];
-        for (auto& listener: alStrListeners) listener->ProcessAdd(bStream);
+        next(bStream);
+    };
+    
+	// add a price
+    void AddPrice(Price<Bond>& price)
+    {
+        // notify all listeners 
+        auto notify = [this](BondAlgoStream& bStream) { for (auto& listener: alStrListeners) listener->ProcessAdd(bStream); };
+        AddPrice(price, notify);
     };
     
 	// no implementation
@@ -229,7 +238,7 @@ public:
     
     BondAlgoStream& GetData(std::string key)
     {
-        return algStrData.at(key);
+        return algStrData.At(key);
     };
     
     void AddListener(ServiceListener<BondAlgoStream> *listener) 
@@ -282,5 +291,24 @@ public:
     };
 };
 
+// stage of a StaticPipeline doing the work of BondAlgoStreamingServiceListener
+class BondAlgoStreamingStage
+{
+private:
+    BondAlgoStreamingService* bAlgStrSer;
+    
+public:
+    BondAlgoStreamingStage()
+    {
+        bAlgStrSer = BondAlgoStreamingService::create_service();
+    };
+    
+    template<typename Next>
+    void Process(Price<Bond>& price, Next& next)
+    {
+        bAlgStrSer->AddPrice(price, next);
+    };
+};
+
 #endif 
 /* BondAlgoStreamingService_h */
@@ -19,7 +19,7 @@ class BondExecutionService: public ExecutionService<Bond>
 {
 private:
 	// map for store data
-    std::map<std::string, ExecutionOrder<Bond>> exeData;
+    ProductTable<ExecutionOrder<Bond>> exeData;
     std::vector<ServiceListener<ExecutionOrder<Bond>>*> bExeListeners;
     BondExecutionService() {};
     
@@ -32,9 +32,9 @@ public:
     {
         std::cout << "Executing an order." << std::endl;
         
-        std::string prodId = order.GetProduct().GetProductId();
+        ProductIndex prodId = order.GetProduct().GetProductIndex();
         ExecutionOrder<Bond> bExeNew(order);
-        exeData.insert(std::make_pair(prodId, bExeNew));
+        exeData.Insert(prodId, bExeNew);
         
         // notify all listeners 
         ExecutionOrder<Bond> bExe = exeData[prodId];
@@ -45,7 +45,7 @@ public:
     void ExecuteAlgOrder(BondAlgoExecution &exe)
     {
         auto order = exe.GetExecutionOrder();
-        std::string prodId = order.GetProduct().GetProductId();
+        ProductIndex prodId = order.GetProduct().GetProductIndex();
         exeData[prodId] = order;
         for (auto& listener: bExeListeners) listener->ProcessAdd(order);
     };
@@ -66,7 +66,7 @@ public:
 	// pull order info
     ExecutionOrder<Bond>& GetData(std::string key) 
     {
-        return exeData.at(key);
+        return exeData.At(key);
     };
     
     // create BondHistoricalDataListener object pointer
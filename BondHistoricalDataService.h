@@ -11,6 +11,14 @@
 #include "BondExecutionService.h"
 #include "BondStreamingService.h"
 #include "BondInquiryService.h"
+#include "BufferedFileWriter.h"
+#include "AsyncPersister.h"
+#include "HistoricalLog.h"
+#include "MappedJournal.h"
+#include "DeltaLog.h"
+#include "TimeSeriesStore.h"
+#include "SegmentedLog.h"
+#include "Conflation.h"
 
 /*******************************************************************************/
 /**
@@ -22,19 +30,110 @@
 * @author Breman Thuraisingham
 */
 
+template<typename T, typename R>
+class HistoricalConnector;
+
 /**
 * Service for processing and persisting historical data to a persistent store.
 * Keyed on some persistent key.
-* Type T is the data type to persist.
+* Type T is the data type to persist, R its compact record, which is also kept in memory per CUSIP for queries.
+* The records are written by a HistoricalConnector, inline or through an AsyncPersister.
 */
-template<typename T>
+template<typename T, typename R>
 class HistoricalDataService : Service<string, T>
 {
+protected:
+	// writes the records to the output files
+	HistoricalConnector<T, R>* connector;
+	// background writer, nullptr to persist inline
+	AsyncPersister* persister = nullptr;
+	// recent history per CUSIP, filled by PersistData
+	TimeSeriesStore<R> history;
+	// drops records that repeat the last persisted one of their CUSIP, off unless configured
+	RecordConflator<R> conflator;
+	// records of the batch being persisted
+	std::vector<R> batch;
+
+	// records of count data that pass the conflator, appended to the history as PersistData does
+	std::vector<R>& AdmitBatch(T* data, size_t count)
+	{
+		batch.clear();
+		for (size_t i = 0; i < count; ++i)
+		{
+			R record = R::From(data[i]);
+			if (!conflator.Admit(record)) continue;
+			history.Append(record);
+			batch.push_back(record);
+		}
+		return batch;
+	};
+
+	explicit HistoricalDataService(HistoricalConnector<T, R>* _connector) : connector(_connector) {};
 
 public:
 
-	// Persist data to a store
-	virtual void PersistData(string persistKey, T& data) = 0;
+	// Persist data to a store, the history and the files are keyed on the CUSIP of data
+	virtual void PersistData(string, T& data)
+	{
+		// one record, with one timestamp, for the in-memory history and the output files
+		R record = R::From(data);
+		if (!conflator.Admit(record)) return;
+		history.Append(record);
+		if (persister) connector->PublishAsync(record, persister);
+		else connector->Publish(record);
+	};
+
+	// Persist count data at once, the records that pass the conflator are written as one batch
+	virtual void PersistDataBatch(T* data, size_t count)
+	{
+		std::vector<R>& records = AdmitBatch(data, count);
+		if (persister)
+		{
+			for (auto& record : records) connector->PublishAsync(record, persister);
+		}
+		else connector->PublishBatch(records.data(), records.size());
+	};
+
+	// persist through the background writer from now on, nullptr to go back to writing inline
+	void SetPersister(AsyncPersister* _persister)
+	{
+		persister = _persister;
+	};
+
+	// records of a CUSIP persisted with from <= timestamp <= to, in microseconds since the epoch, oldest first
+	std::vector<R> GetHistory(const string& cusip, int64_t from, int64_t to) const
+	{
+		return history.GetRange(cusip, from, to);
+	};
+
+	// latest record of a CUSIP persisted at or before asOf, false if there is none
+	bool GetHistoryAsOf(const string& cusip, int64_t asOf, R& record) const
+	{
+		return history.GetAsOf(cusip, asOf, record);
+	};
+
+	const TimeSeriesStore<R>& GetHistoryStore() const
+	{
+		return history;
+	};
+
+	// change how much history is kept in memory
+	void SetHistoryRetention(const HistoryRetention& retention)
+	{
+		history.SetRetention(retention);
+	};
+
+	// suppress unchanged consecutive records per CUSIP before they are kept or written
+	void SetConflation(const ConflationConfig& config)
+	{
+		conflator.SetConfig(config);
+	};
+
+	// conflation counters
+	const RecordConflator<R>& GetConflator() const
+	{
+		return conflator;
+	};
 
 };
 
@@ -49,24 +148,141 @@ using namespace std;
 /**************** BondStreamingConnector **************/
 /**************** BondInquiryConnector **************/
 
-class BondHisRiskConnector : public Connector<PV01<Bond>>
+/**
+* Publish-only connector of a historical service, writing the records of type R taken from data of type T.
+* The legacy text lines (WriteLegacyText of R) go to a SegmentedFileWriter, the records themselves to a
+* HistoricalLogBackend, or both, as SetFormat says; both files are kept open for the whole run. Only the
+* file names and the name printed per record differ between the connectors built on it.
+*/
+template<typename T, typename R>
+class HistoricalConnector : public Connector<T>, public PersistSink
 {
-public:
-	// ctor for RiskConnector
-	BondHisRiskConnector() {};
+private:
+	// output files kept open for the whole run
+	SegmentedFileWriter writer;
+	std::unique_ptr<HistoricalLogBackend<R>> log;
+	HistoricalFormat format = TEXT_LOG;
+	// kind of data, as in "Persisting risk data."
+	const char* kind;
 
+	void Announce()
+	{
+		std::cout << "Persisting " << kind << " data." << std::endl;
+	};
+
+	void WriteText(const R& record)
+	{
+		writer.BeginRecord(record.header.timestamp, LogField(record.cusip));
+		WriteLegacyText(writer.Stream(), record);
+		writer.EndRecord();
+	};
+
+	void Write(const R& record)
+	{
+		if (format != BINARY_LOG) WriteText(record);
+		if (format != TEXT_LOG) log->Append(record);
+	};
+
+protected:
+	// files output/<name>.txt and output/<name>.bin
+	HistoricalConnector(const std::string& name, const char* _kind) :
+		writer("output/" + name, ".txt"), log(new HistoricalLogWriter<R>("output/" + name + ".bin")), kind(_kind) {};
+
+public:
 	// implement no, publish-only
 	void Subscribe() {};
-	// publish data 
-	void Publish(PV01<Bond>& data)
+
+	// publish data
+	void Publish(T& data) override
+	{
+		Publish(R::From(data));
+	};
+
+	// publish a record already taken from the data
+	void Publish(const R& record)
+	{
+		Announce();
+		Write(record);
+	};
+
+	// publish count records at once, the files apply their flush policy once for all of them
+	void PublishBatch(const R* records, size_t count)
+	{
+		if (format != BINARY_LOG) writer.BeginBatch();
+		for (size_t i = 0; i < count; ++i)
+		{
+			Announce();
+			if (format != BINARY_LOG) WriteText(records[i]);
+		}
+		if (format != BINARY_LOG) writer.EndBatch();
+		if (format != TEXT_LOG) log->AppendBatch(records, count);
+	};
+
+	void PublishBatch(T* data, size_t count) override
+	{
+		std::vector<R> records;
+		records.reserve(count);
+		for (size_t i = 0; i < count; ++i) records.push_back(R::From(data[i]));
+		PublishBatch(records.data(), records.size());
+	};
+
+	// queue a record for the persistence thread, false if it was dropped
+	bool PublishAsync(const R& record, AsyncPersister* persister)
+	{
+		return persister->Enqueue(this, record);
+	};
+
+	// persistence thread: write a queued record
+	void WriteRecord(const unsigned char* payload) override
+	{
+		Write(PersistRecord::Load<R>(payload));
+	};
+
+	// persistence thread: end of a batch
+	void Commit() override
+	{
+		Flush();
+	};
+
+	// choose the text file, the binary log or both
+	void SetFormat(HistoricalFormat _format)
+	{
+		format = _format;
+	};
+
+	// replace the binary log by another backend, the connector takes ownership
+	void SetLogBackend(HistoricalLogBackend<R>* backend)
 	{
-		ofstream myfile("output/risk.txt", ios_base::app);
-		std::cout << "Persisting risk data." << std::endl;
-		std::string pv01 = std::to_string(data.GetPV01());
-		std::string output = "PV01 is: " + pv01;
-		myfile << output << std::endl;
+		if (backend) log.reset(backend);
 	};
 
+	// change when the output files are flushed
+	void SetFlushConfig(const FlushConfig& config)
+	{
+		writer.SetConfig(config);
+		log->SetConfig(config);
+	};
+
+	// cut the text file into indexed segments, see SegmentedLog.h
+	void SetRotation(const RotationConfig& rotation)
+	{
+		writer.SetRotation(rotation);
+	};
+
+	// write out all buffered records
+	void Flush()
+	{
+		writer.Flush();
+		log->Flush();
+	};
+};
+
+class BondHisRiskConnector : public HistoricalConnector<PV01<Bond>, RiskLogRecord>
+{
+public:
+	// ctor for RiskConnector
+	BondHisRiskConnector() : HistoricalConnector("risk", "risk") {};
+
 	// connector object pointer
 	static BondHisRiskConnector* create_connector()
 	{
@@ -75,23 +291,11 @@ public:
 	};
 };
 
-class BondHisExecutionConnector : public Connector<ExecutionOrder<Bond>>
+class BondHisExecutionConnector : public HistoricalConnector<ExecutionOrder<Bond>, ExecutionLogRecord>
 {
 public:
 	// ctor for ExecutionConnector
-	BondHisExecutionConnector() {};
-
-	// implement no, publish-only
-	void Subscribe() {};
-	// publish data 
-	void Publish(ExecutionOrder<Bond>& data)
-	{
-		ofstream myfile("output/execution.txt", ios_base::app);
-		std::cout << "Persisting execution data." << std::endl;
-		std::string output = "Execution detail for order Id is: " + data.GetOrderId() + ", CUSIP Id is: " + data.GetProduct().GetProductId();
-		myfile << output << std::endl;
-		myfile << data << std::endl;
-	};
+	BondHisExecutionConnector() : HistoricalConnector("execution", "execution") {};
 
 	// connector object pointer
 	static BondHisExecutionConnector* create_connector()
@@ -101,27 +305,11 @@ public:
 	};
 };
 
-class BondHisStreamingConnector : public Connector<PriceStream<Bond>>
+class BondHisStreamingConnector : public HistoricalConnector<PriceStream<Bond>, StreamingLogRecord>
 {
 public:
 	// ctor for StreamingConnector
-	BondHisStreamingConnector() {};
-
-	// no implement, publish-only
-	void Subscribe() {};
-	// publish data 
-	void Publish(PriceStream<Bond>& data)
-	{
-		ofstream myfile("output/streaming.txt", ios_base::app);
-		std::cout << "Persisting streaming data." << std::endl;
-
-		std::string productId = data.GetProduct().GetProductId();
-		std::string offer_price = std::to_string(data.GetOfferOrder().GetPrice());
-		std::string bid_price = std::to_string(data.GetBidOrder().GetPrice());
-		std::string output = "Product Id (CUSIP) is: " + productId + ", Bid price is: " + bid_price + ", Offer price is: " + offer_price + ";";
-
-		myfile << output << std::endl;
-	};
+	BondHisStreamingConnector() : HistoricalConnector("streaming", "streaming") {};
 
 	static BondHisStreamingConnector* create_connector()
 	{
@@ -130,47 +318,11 @@ public:
 	};
 };
 
-class BondHisInquiryConnector : public Connector<Inquiry<Bond>>
+class BondHisInquiryConnector : public HistoricalConnector<Inquiry<Bond>, InquiryLogRecord>
 {
 public:
-	// ctor for InquiryConnector
-	BondHisInquiryConnector() {};
-
-	// implement no, publish-only
-	void Subscribe() {};
-
-	// publish data into "allinquiries.txt" file
-	void Publish(Inquiry<Bond> &data)
-	{
-		// output data
-		ofstream myfile("output/allinquiries.txt", ios_base::app);
-		std::cout << "Persisting inquiry data." << std::endl;
-
-		std::string productId = data.GetProduct().GetProductId();
-		std::string inquiryId = data.GetInquiryId();
-		std::string price = std::to_string(data.GetPrice());
-		std::string quantity = std::to_string(data.GetQuantity());
-		std::string side;
-		if (data.GetSide() == Side::BUY)
-		{
-			side = "BUY";
-		}
-		else
-		{
-			side = "SELL";
-		}
-		std::string state;
-		if (data.GetState() == InquiryState::RECEIVED)
-		{
-			state = "RECEIVED";
-		}
-		else
-		{
-			state = "OTHERS";
-		}
-		std::string output = "Product Id: " + productId + ", Inquiry Id: " + inquiryId + ", Price: " + price + ", Quantity: " + quantity + ", Side: " + side + ", State: " + state + ";";
-		myfile << output << std::endl;
-	};
+	// ctor for InquiryConnector, publishes into "allinquiries.txt"
+	BondHisInquiryConnector() : HistoricalConnector("allinquiries", "inquiry") {};
 
 	// connector object pointer
 	static BondHisInquiryConnector* create_connector()
@@ -180,46 +332,35 @@ public:
 	};
 };
 
-
 /************************************ Definition for Services and Listeners ******************************************/
 
 // Historical Risk 
 /********************* BondRiskService ******************/
 /********************* BondRiskServiceListener *****************/
-class BondHisRiskService : public HistoricalDataService<PV01<Bond>>
+class BondHisRiskService : public HistoricalDataService<PV01<Bond>, RiskLogRecord>
 {
 private:
-	std::map<std::string, PV01<Bond>> riskData;                       // store the type data to persist
+	ProductTable<PV01<Bond>> riskData;                       // store the type data to persist
 	std::vector<ServiceListener<PV01<Bond>>*> riskListeners;      // member data for listeners
 
-	BondHisRiskConnector* bondRiskConn; // call connector to write
-	BondHisRiskService()
-	{
-		bondRiskConn = BondHisRiskConnector::create_connector();
-	}
+	BondHisRiskService() : HistoricalDataService(BondHisRiskConnector::create_connector()) {};
 
 public:
 	// get pv01 info
 	PV01<Bond>& GetData(std::string key)
 	{
-		return riskData.at(key);
+		return riskData.At(key);
 	};
 
 	// pass updates or new info
 	void OnMessage(PV01<Bond>& trade)
 	{
-		auto persistKey = trade.GetProduct().GetProductId();
+		auto persistKey = trade.GetProduct().GetProductIndex();
 		riskData[persistKey] = trade;
 		std::cout << "Data from Bond Historical Risk Service to Listener." << std::endl;
 		for (auto& listener : riskListeners) listener->ProcessAdd(trade); // notify listeners
 	};
 
-	// publish data
-	void PersistData(std::string key, PV01<Bond>& data)
-	{
-		bondRiskConn->Publish(data);
-	};
-
 	void AddListener(ServiceListener<PV01<Bond>> *listener)
 	{
 		riskListeners.push_back(listener);
@@ -254,6 +395,13 @@ public:
 		bondRiskSer->PersistData(data.GetProduct().GetProductId(), data); // to write.
 	};
 
+	// add count data, persisted as one batch
+	void ProcessAddBatch(PV01<Bond>* data, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i) bondRiskSer->OnMessage(data[i]);
+		bondRiskSer->PersistDataBatch(data, count);
+	};
+
 	// no implementation
 	void ProcessRemove(PV01<Bond>& data) {};
 	void ProcessUpdate(PV01<Bond>& data) {};
@@ -268,41 +416,31 @@ public:
 // Historical Execution
 /********************* BondExecutionService ******************/
 /********************* BondExecutionServiceListener *****************/
-class BondHisExecutionService : public HistoricalDataService<ExecutionOrder<Bond>>
+class BondHisExecutionService : public HistoricalDataService<ExecutionOrder<Bond>, ExecutionLogRecord>
 {
 private:
 	// map to store exe order data
-	std::map<std::string, ExecutionOrder<Bond>> exeData;        
+	ProductTable<ExecutionOrder<Bond>> exeData;        
 	// member listeners
 	std::vector<ServiceListener<ExecutionOrder<Bond>>*> exeListeners;      
-	BondHisExecutionConnector *bondExeConn; // call connector to output
-	BondHisExecutionService()
-	{
-		bondExeConn = BondHisExecutionConnector::create_connector();
-	};
+	BondHisExecutionService() : HistoricalDataService(BondHisExecutionConnector::create_connector()) {};
 
 public:
 	// get order info
 	ExecutionOrder<Bond>& GetData(string key)
 	{
-		return exeData.at(key);
+		return exeData.At(key);
 	};
 
 	// pass info or updates
 	void OnMessage(ExecutionOrder<Bond>& trade)
 	{
-		auto persistKey = trade.GetProduct().GetProductId();
+		auto persistKey = trade.GetProduct().GetProductIndex();
 		exeData[persistKey] = trade;
 		std::cout << "Data from Bond Historical Execution Service to Listener." << std::endl;
 		for (auto& listener : exeListeners) listener->ProcessAdd(trade); // notify listeners
 	};
 
-	// publish data
-	void PersistData(std::string persistKey, ExecutionOrder<Bond>& data)
-	{
-		bondExeConn->Publish(data);
-	};
-
 	void AddListener(ServiceListener<ExecutionOrder<Bond>> *listener)
 	{
 		exeListeners.push_back(listener);
@@ -337,6 +475,13 @@ public:
 		bondExeSer->PersistData(data.GetProduct().GetProductId(), data); // to write.
 	};
 
+	// add count data, persisted as one batch
+	void ProcessAddBatch(ExecutionOrder<Bond>* data, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i) bondExeSer->OnMessage(data[i]);
+		bondExeSer->PersistDataBatch(data, count);
+	};
+
 	// no implementation
 	void ProcessRemove(ExecutionOrder<Bond>& data) {};
 	void ProcessUpdate(ExecutionOrder<Bond>& data) {};
@@ -351,41 +496,30 @@ public:
 // Historical Streaming
 /********************* BondStreamingService ******************/
 /********************* BondStreamingServiceListener *****************/
-class BondHisStreamingService : public HistoricalDataService<PriceStream<Bond>>
+class BondHisStreamingService : public HistoricalDataService<PriceStream<Bond>, StreamingLogRecord>
 {
 private:
 	// map to store steaming data
-	std::map<std::string, PriceStream<Bond>> streamData;                      
+	ProductTable<PriceStream<Bond>> streamData;                      
 	std::vector<ServiceListener<PriceStream<Bond>>*> streamListeners;      
-	// call connector to output data
-	BondHisStreamingConnector *bondStreamConn; 
-	BondHisStreamingService()
-	{
-		bondStreamConn = BondHisStreamingConnector::create_connector();
-	};
+	BondHisStreamingService() : HistoricalDataService(BondHisStreamingConnector::create_connector()) {};
 
 public:
 	// pull price streaming data
 	PriceStream<Bond>& GetData(string key)
 	{
-		return streamData.at(key);
+		return streamData.At(key);
 	};
 
 	// pass updates or new 
 	void OnMessage(PriceStream<Bond>& trade)
 	{
-		auto persistKey = trade.GetProduct().GetProductId();
+		auto persistKey = trade.GetProduct().GetProductIndex();
 		streamData[persistKey] = trade;
 		std::cout << "Data from Bond Historical Streaming Service to Listener." << std::endl;
 		for (auto& listener : streamListeners) listener->ProcessAdd(trade); // notify listeners
 	};
 
-	// publish data
-	void PersistData(std::string persistKey, PriceStream<Bond>& data)
-	{
-		bondStreamConn->Publish(data);
-	};
-
 	void AddListener(ServiceListener<PriceStream<Bond>> *listener)
 	{
 		streamListeners.push_back(listener);
@@ -420,6 +554,13 @@ public:
 		bondStreamSer->PersistData(data.GetProduct().GetProductId(), data); // to write.
 	};
 
+	// add count data, persisted as one batch
+	void ProcessAddBatch(PriceStream<Bond>* data, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i) bondStreamSer->OnMessage(data[i]);
+		bondStreamSer->PersistDataBatch(data, count);
+	};
+
 	void ProcessRemove(PriceStream<Bond>& data) {};
 	void ProcessUpdate(PriceStream<Bond>& data) {};
 
@@ -433,40 +574,30 @@ public:
 
 
 // Historical Inquries
-class BondHisInquiryService : public HistoricalDataService<Inquiry<Bond>>
+class BondHisInquiryService : public HistoricalDataService<Inquiry<Bond>, InquiryLogRecord>
 {
 private:
 	// map to store inquiry data
-	std::map<std::string, Inquiry<Bond>> inquiryData;                       
+	ProductTable<Inquiry<Bond>> inquiryData;                       
 	std::vector<ServiceListener<Inquiry<Bond>>*> inquiryListeners;      
-	BondHisInquiryConnector *bondInqConn; // call connector to output data
 
-	BondHisInquiryService()
-	{
-		bondInqConn = BondHisInquiryConnector::create_connector();
-	};
+	BondHisInquiryService() : HistoricalDataService(BondHisInquiryConnector::create_connector()) {};
 
 public:
 	// pull inquiry info
 	Inquiry<Bond>& GetData(std::string key)
 	{
-		return inquiryData.at(key);
+		return inquiryData.At(key);
 	};
 
 	void OnMessage(Inquiry<Bond>& trade)
 	{
-		auto persistKey = trade.GetProduct().GetProductId();
+		auto persistKey = trade.GetProduct().GetProductIndex();
 		inquiryData[persistKey] = trade;
 		std::cout << "Data from Bond Historical Inquiry Service to Listener." << std::endl;
 		for (auto& listener : inquiryListeners) listener->ProcessAdd(trade); // notify listeners
 	};
 
-	// publish data
-	void PersistData(string persistKey, Inquiry<Bond>& data)
-	{
-		bondInqConn->Publish(data);
-	};
-
 	void AddListener(ServiceListener<Inquiry<Bond>> *listener)
 	{
 		inquiryListeners.push_back(listener);
@@ -501,6 +632,13 @@ public:
 		bondInqSer->PersistData(data.GetProduct().GetProductId(), data); // to write.
 	};
 
+	// add count data, persisted as one batch
+	void ProcessAddBatch(Inquiry<Bond>* data, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i) bondInqSer->OnMessage(data[i]);
+		bondInqSer->PersistDataBatch(data, count);
+	};
+
 	void ProcessRemove(Inquiry<Bond>& data) {};
 	void ProcessUpdate(Inquiry<Bond>& data) {};
 
@@ -37,7 +37,7 @@ public:
 	Inquiry() {};
 
 	// ctor for an inquiry
-	Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, double _price, InquiryState _state);
+	Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, TickPrice _price, InquiryState _state);
 
 	// Get the inquiry ID
 	const string& GetInquiryId() const;
@@ -52,20 +52,20 @@ public:
 	long GetQuantity() const;
 
 	// Get the price that we have responded back with
-	double GetPrice() const;
+	TickPrice GetPrice() const;
 
 	// Get the current state on the inquiry
 	InquiryState GetState() const;
 
 	// Set state
-	void SetState(double stPrice, InquiryState st);
+	void SetState(TickPrice stPrice, InquiryState st);
 
 private:
 	string inquiryId;
-	T product;
+	ProductHandle<T> product;
 	Side side;
 	long quantity;
-	double price;
+	TickPrice price;
 	InquiryState state;
 
 };
@@ -82,7 +82,7 @@ class InquiryService : public Service<string, Inquiry <T> >
 public:
 
 	// Send a quote back to the client
-	void SendQuote(const string &inquiryId, double price) = 0;
+	void SendQuote(const string &inquiryId, TickPrice price) = 0;
 
 	// Reject an inquiry from the client
 	void RejectInquiry(const string &inquiryId) = 0;
@@ -90,7 +90,7 @@ public:
 };
 
 template<typename T>
-Inquiry<T>::Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, double _price, InquiryState _state) :
+Inquiry<T>::Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, TickPrice _price, InquiryState _state) :
 	product(_product)
 {
 	inquiryId = _inquiryId;
@@ -109,7 +109,7 @@ const string& Inquiry<T>::GetInquiryId() const
 template<typename T>
 const T& Inquiry<T>::GetProduct() const
 {
-	return product;
+	return product.Get();
 }
 
 template<typename T>
@@ -125,7 +125,7 @@ long Inquiry<T>::GetQuantity() const
 }
 
 template<typename T>
-double Inquiry<T>::GetPrice() const
+TickPrice Inquiry<T>::GetPrice() const
 {
 	return price;
 }
@@ -137,7 +137,7 @@ InquiryState Inquiry<T>::GetState() const
 }
 
 template<typename T>
-void Inquiry<T>::SetState(double stPrice, InquiryState st)
+void Inquiry<T>::SetState(TickPrice stPrice, InquiryState st)
 {
 	price = stPrice;
 	state = st;
@@ -151,7 +151,7 @@ class BondInquiryService : public Service<std::string, Inquiry<Bond>>
 {
 private:
 	// a map for inquiry data info
-	std::map<std::string, Inquiry<Bond>> inquiryData;
+	ProductTable<Inquiry<Bond>> inquiryData;
 	std::vector<ServiceListener<Inquiry<Bond>>*> inqListeners;
 	BondInquiryService() {};
 
@@ -169,14 +169,25 @@ public:
 		for (auto& listener : inqListeners) listener->ProcessAdd(data);
 	};
 
+	// count inquiries at once, each listener gets all of them in one call
+	void OnMessageBatch(Inquiry<Bond>* data, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			cout << "You are now in the inquiry service, sending an inquiry object with QUOTED state" << endl;
+			data[i].SetState(data[i].GetPrice(), DONE);
+		}
+		for (auto& listener : inqListeners) listener->ProcessAddBatch(data, count);
+	};
+
 	// get inquiry info given key
 	Inquiry<Bond>& GetData(std::string key) override
 	{
-		return inquiryData.at(key);
+		return inquiryData.At(key);
 	};
 
 	// override virtual function, no implementation
-	void SendQuote(const std::string& inquiryId, double price) {};
+	void SendQuote(const std::string& inquiryId, TickPrice price) {};
 
 	// Reject an inquiry
 	void RejectInquiry(const std::string& inquiryId) {};
@@ -200,13 +211,30 @@ public:
 };
 
 
+/**
+* A decoded row of inquiries.txt, reused across rows by the connector.
+*/
+struct InquiryRow
+{
+	SecurityId cusip;
+	Side side;
+	long quantity;
+	TickPrice price;
+	InquiryState state;
+	long timestamp;  // microseconds since the session start, 0 if the file has none
+};
+
 class BondInquiryConnector : public Connector<Inquiry<Bond>>
 {
 private:
 	BondInquiryService *bondInqServ;
 	BondProductService *productService;
+	// events waiting for the next OnMessageBatch
+	EventBatcher<Inquiry<Bond>> batcher;
+	// id given to the inquiries of the current Subscribe() run
+	int inqIndex = 1;
 
-	BondInquiryConnector()
+	BondInquiryConnector() : batcher(BondInquiryService::create_service())
 	{
 		bondInqServ = BondInquiryService::create_service();
 		productService = BondProductService::create_service();
@@ -216,106 +244,128 @@ public:
 	// override virtual function, no implementation
 	void Publish(Inquiry<Bond>& data) {};
 
-	// read the inquiries.txt
-	void Subscribe()
+	// decode the fields of one row, false for blank or truncated rows, for a CUSIP failing its check digit and for a
+	// quantity, price or timestamp that is not a number
+	static bool ParseRow(const std::vector<std::string_view>& data, InquiryRow& row)
 	{
-		// read data from each line
-		auto readLine = [](std::string& row)
+		if (data.size() < 5) return false;
+		row.cusip = SecurityId::Parse(data[0]);
+		if (!AcceptInputSecurity(row.cusip, data[0])) return false;
+		if (!FieldToLong(data[2], row.quantity)) return RejectInputField();  //convert to the long type
+		// quotes are in fractional notation, plain decimal prices such as "100" are taken to the nearest tick
+		if (!TickPrice::Parse(data[3], row.price))
 		{
-			stringstream line(row);
-			std::vector<std::string> mystring;
-			std::string str;
-
-			while (getline(line, str, ','))
-			{
-				mystring.push_back(str);
-			}
+			double decimal;
+			if (!FieldToDouble(data[3], decimal)) return RejectInputField();
+			row.price = TickPrice::FromDouble(decimal);
+		}
 
-			return mystring;
-		};
+		if (data[1] == "BUY")
+		{
+			row.side = Side::BUY;
+		}
+		else
+		{
+			row.side = Side::SELL;
+		}
 
-		// convert string to actual price
-		auto strToPrice = [](std::string& str)
+		if (data[4] == "RECEIVED")
 		{
-			// get size of the string
-			int size = str.size();
-			// get the last digit of the string
-			char lstChar = str[size - 1];
-			// convert the last character
-			int lstDigit;
-			if (lstChar == '+') { lstDigit = 4; }
-			else { lstDigit = lstChar - '0'; } // converts a character to the integer value
-
-			// convert string in the middle
-			auto index = str.find_first_of("-");
-			int midDigit = std::stoi(str.substr(index + 1, 2));
-
-			// covert the first integer
-			double firstDigit = std::stoi(str.substr(0, index));
-
-			// combination of each part
-			double res = firstDigit + midDigit / 32.0 + lstDigit / 256.0;
-			return res;
-		};
+			row.state = InquiryState::RECEIVED;
+		}
+		else
+		{
+			row.state = InquiryState::DONE;
+		}
+		row.timestamp = 0;
+		if (data.size() > 5 && !FieldToLong(data[5], row.timestamp)) return RejectInputField();
+		return true;
+	};
 
-		std::cout << "Reading inquiry data from inquiries.txt" << std::endl;
+	// build the inquiry of a decoded row and pass it to the service
+	void DeliverRow(const InquiryRow& row)
+	{
+		// convert to string
+		std::string inquiryId = std::to_string(inqIndex);
+
+		// Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate);
+		//Bond& bond = bondMap[cusip];
+		// createa Bond object reference
+		const Bond &bond = productService->GetData(row.cusip);
+
+		// Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, TickPrice _price, InquiryState _state);
+		// create Inquiry object from several attributes
+		Inquiry<Bond> inqB(inquiryId, bond, row.side, row.quantity, row.price, row.state);
+		batcher.Add(std::move(inqB));
+	};
 
-		static int inqIndex = 1;
-		fstream myfile("input/inquiries.txt");
-		std::string row;
-		getline(myfile, row);
+	// read the inquiries.txt
+	void Subscribe()
+	{
+		std::cout << "Reading inquiry data from inquiries.txt" << std::endl;
+		MappedFileReader myfile("input/inquiries.txt");
 
-		InquiryState inqState;
-		Side inqSide;
-		std::string cusip, price, quantity, side, state;
+		// fields of the current row, views into the mapped file
+		std::vector<std::string_view> data;
+		InquiryRow row;
 
-		while (getline(myfile, row))
+		myfile.NextRow(data);
+		while (myfile.NextRow(data))
 		{
-			// store the data from the txt file i vec
-			std::vector<string> data = readLine(row);
-			cusip = data[0];
-			side = data[1];
-			quantity = data[2];
-			price = data[3];
-			state = data[4];
-
-			// convert to string
-			std::string inquiryId = std::to_string(inqIndex);
-
-			// Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate);
-			//Bond& bond = bondMap[cusip];
-			// createa Bond object reference
-			Bond &bond = productService->GetData(cusip);
-
-			long inqQuantity = std::stol(quantity);  //convert to the long type
-			double inqPrice = std::stod(price);  //convert to the long type
-
-			if (side == "BUY")
-			{
-				inqSide = Side::BUY;
-			}
-			else
-			{
-				inqSide = Side::SELL;
-			}
-
-			if (state == "RECEIVED")
-			{
-				inqState = InquiryState::RECEIVED;
-			}
-			else
-			{
-				inqState = InquiryState::DONE;
-			}
-
-			// Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, double _price, InquiryState _state);
-			// create Inquiry object from several attributes
-			Inquiry<Bond> inqB(inquiryId, bond, inqSide, inqQuantity, inqPrice, inqState);
-			bondInqServ->OnMessage(inqB);
+			if (ParseRow(data, row)) DeliverRow(row);
 		};
+		batcher.Flush();
+
+		inqIndex++;
+		std::cout << "Reading inquiry data is done. All inquiry data is generated." << std::endl;
+	};
+
+	// read the inquiries.txt, parsing on a separate thread that feeds this one through a ring of capacity rows
+	IngestStats SubscribePipelined(size_t capacity = 1024)
+	{
+		std::cout << "Reading inquiry data from inquiries.txt (pipelined)" << std::endl;
+		MappedFileReader myfile("input/inquiries.txt");
+
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		IngestStats stats = RunPipelined<InquiryRow>(myfile, capacity, &BondInquiryConnector::ParseRow,
+			[this](InquiryRow& row) { DeliverRow(row); });
+		batcher.Flush();
+
+		inqIndex++;
+		std::cout << "Inquiry ingest " << stats << std::endl;
+		std::cout << "Reading inquiry data is done. All inquiry data is generated." << std::endl;
+		return stats;
+	};
+
+	// read data from inquiries.txt, parsing chunks of the file on threads worker threads, delivered in file order
+	size_t SubscribeParallel(size_t threads = std::thread::hardware_concurrency())
+	{
+		std::cout << "Reading inquiry data from inquiries.txt (" << threads << " threads)" << std::endl;
+		MappedFileReader myfile("input/inquiries.txt");
+
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		size_t events = RunParallel<InquiryRow>(myfile, threads, &BondInquiryConnector::ParseRow,
+			[this](InquiryRow& row) { DeliverRow(row); });
+		batcher.Flush();
 
 		inqIndex++;
+		std::cout << "Inquiry ingest events: " << events << std::endl;
 		std::cout << "Reading inquiry data is done. All inquiry data is generated." << std::endl;
+		return events;
+	};
+
+	// events per OnMessageBatch call, 1 passes every event on as it is read
+	void SetBatchSize(size_t batchSize)
+	{
+		batcher.SetBatchSize(batchSize);
+	};
+
+	// pass on the events held for the current batch
+	void FlushBatch()
+	{
+		batcher.Flush();
 	};
 
 	// get the service
@@ -0,0 +1,382 @@
+#pragma once
+//
+//  BondMarketDataFile.h
+//  MTH 9815
+//
+
+#ifndef BondMarketDataFile_h
+#define BondMarketDataFile_h
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include "MappedFileReader.h"
+#include "TickPrice.h"
+#include "SecurityId.h"
+
+using namespace std;
+
+/**
+* Binary columnar file format for 5-deep order book snapshots.
+*
+* [header][block]...[block][cusip index]
+*
+* Each block holds up to blockRows snapshots stored column by column:
+*   uint32 rows, uint32 padding
+*   uint16 cusip index per row, padded to 8 bytes
+*   int32 price in 1/256 ticks per row, for bid levels 1-5 then offer levels 1-5
+*   int64 quantity per row, for bid levels 1-5 then offer levels 1-5
+* The cusip index at the end of the file lists the 9-character CUSIPs in index order.
+* All integers are in host byte order.
+*/
+
+// depth of the book stored in each snapshot
+const int MARKET_DATA_DEPTH = 5;
+// number of price (and quantity) columns, bid then offer levels
+const int MARKET_DATA_LEVELS = 2 * MARKET_DATA_DEPTH;
+// width of a CUSIP entry in the index
+const int MARKET_DATA_CUSIP_WIDTH = 12;
+// number of CUSIPs the uint16 id column can name
+const size_t MARKET_DATA_MAX_CUSIPS = size_t(UINT16_MAX) + 1;
+
+struct MarketDataFileHeader
+{
+	char magic[4];         // "BMDF"
+	uint32_t version;
+	uint32_t depth;        // levels per side
+	uint32_t blockRows;    // max snapshots per block
+	uint64_t rowCount;     // total snapshots in the file
+	uint64_t blockCount;
+	uint64_t indexOffset;  // file offset of the cusip index
+	uint32_t cusipCount;
+	uint32_t reserved;
+};
+
+const char MARKET_DATA_FILE_MAGIC[4] = { 'B', 'M', 'D', 'F' };
+const uint32_t MARKET_DATA_FILE_VERSION = 1;
+
+// size of the uint16 cusip column rounded up so the following columns stay 8-byte aligned
+inline size_t MarketDataCusipColumnSize(size_t rows)
+{
+	return (rows * sizeof(uint16_t) + 7) & ~size_t(7);
+}
+
+// total size in bytes of a block with the given number of rows
+inline size_t MarketDataBlockSize(size_t rows)
+{
+	return 8 + MarketDataCusipColumnSize(rows) + MARKET_DATA_LEVELS * rows * (sizeof(int32_t) + sizeof(int64_t));
+}
+
+/**
+* Column pointers of one block, valid while the reader is alive.
+* Level l of the row r is prices[l][r] and quantities[l][r], levels 0-4 are bids and 5-9 offers.
+*/
+struct MarketDataBlock
+{
+	uint32_t rows = 0;
+	const uint16_t* cusips = nullptr;
+	const int32_t* prices[MARKET_DATA_LEVELS];
+	const int64_t* quantities[MARKET_DATA_LEVELS];
+};
+
+/**
+* Reader over a mapped binary market data file.
+*/
+class MarketDataFileReader
+{
+private:
+	MappedFile file;
+	MarketDataFileHeader header;
+	std::vector<std::string> cusipIndex;
+	size_t pos = 0;
+	uint64_t blocksRead = 0;
+	bool valid = false;
+
+public:
+	explicit MarketDataFileReader(const std::string& path) : file(path, InputBackend())
+	{
+		if (file.Size() < sizeof(header)) return;
+		std::memcpy(&header, file.Data(), sizeof(header));
+		if (std::memcmp(header.magic, MARKET_DATA_FILE_MAGIC, 4) != 0
+			|| header.version != MARKET_DATA_FILE_VERSION
+			|| header.depth != MARKET_DATA_DEPTH
+			|| header.indexOffset + uint64_t(header.cusipCount) * MARKET_DATA_CUSIP_WIDTH > file.Size())
+		{
+			return;
+		}
+
+		const char* index = file.Data() + header.indexOffset;
+		for (uint32_t i = 0; i < header.cusipCount; ++i)
+		{
+			const char* entry = index + i * MARKET_DATA_CUSIP_WIDTH;
+			cusipIndex.emplace_back(entry, strnlen(entry, MARKET_DATA_CUSIP_WIDTH));
+		}
+		pos = sizeof(header);
+		valid = true;
+	};
+
+	// whether the file exists and has a valid header
+	bool IsValid() const
+	{
+		return valid;
+	};
+
+	const MarketDataFileHeader& GetHeader() const
+	{
+		return header;
+	};
+
+	// CUSIPs in index order
+	const std::vector<std::string>& GetCusips() const
+	{
+		return cusipIndex;
+	};
+
+	// point block at the next block of the file, false at the end or on a truncated or corrupt block
+	bool NextBlock(MarketDataBlock& block)
+	{
+		if (!valid || blocksRead == header.blockCount) return false;
+		if (pos + 8 > header.indexOffset) return false;
+
+		const char* p = file.Data() + pos;
+		uint32_t rows;
+		std::memcpy(&rows, p, sizeof(rows));
+		if (rows > header.blockRows || pos + MarketDataBlockSize(rows) > header.indexOffset) return false;
+
+		p += 8;
+		// every id must name an entry of the cusip index
+		const uint16_t* cusips = reinterpret_cast<const uint16_t*>(p);
+		for (uint32_t r = 0; r < rows; ++r)
+		{
+			if (cusips[r] >= cusipIndex.size()) return false;
+		}
+		block.rows = rows;
+		block.cusips = cusips;
+		p += MarketDataCusipColumnSize(rows);
+		for (int l = 0; l < MARKET_DATA_LEVELS; ++l)
+		{
+			block.prices[l] = reinterpret_cast<const int32_t*>(p);
+			p += rows * sizeof(int32_t);
+		}
+		for (int l = 0; l < MARKET_DATA_LEVELS; ++l)
+		{
+			block.quantities[l] = reinterpret_cast<const int64_t*>(p);
+			p += rows * sizeof(int64_t);
+		}
+
+		pos += MarketDataBlockSize(rows);
+		++blocksRead;
+		return true;
+	};
+};
+
+/**
+* Writer that buffers one block of snapshots in columns and appends it to the file when full.
+*/
+class MarketDataFileWriter
+{
+private:
+	ofstream out;
+	MarketDataFileHeader header;
+	std::map<std::string, uint16_t, std::less<>> cusipIds;
+	std::vector<std::string> cusipIndex;
+	std::vector<uint16_t> cusipColumn;
+	std::vector<int32_t> priceColumns[MARKET_DATA_LEVELS];
+	std::vector<int64_t> quantityColumns[MARKET_DATA_LEVELS];
+	// whether Close() wrote the whole file
+	bool closed = false;
+
+	// false if the stream failed writing the block or before it
+	bool WriteBlock()
+	{
+		uint32_t rows = uint32_t(cusipColumn.size());
+		if (rows == 0) return bool(out);
+
+		uint32_t pad = 0;
+		out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+		out.write(reinterpret_cast<const char*>(&pad), sizeof(pad));
+
+		size_t cusipBytes = rows * sizeof(uint16_t);
+		out.write(reinterpret_cast<const char*>(cusipColumn.data()), cusipBytes);
+		static const char zeros[8] = {};
+		out.write(zeros, MarketDataCusipColumnSize(rows) - cusipBytes);
+
+		for (auto& column : priceColumns)
+		{
+			out.write(reinterpret_cast<const char*>(column.data()), rows * sizeof(int32_t));
+			column.clear();
+		}
+		for (auto& column : quantityColumns)
+		{
+			out.write(reinterpret_cast<const char*>(column.data()), rows * sizeof(int64_t));
+			column.clear();
+		}
+		cusipColumn.clear();
+
+		header.rowCount += rows;
+		header.blockCount++;
+		return bool(out);
+	};
+
+public:
+	MarketDataFileWriter(const std::string& path, uint32_t blockRows = 4096) :
+		out(path, ios_base::binary | ios_base::trunc)
+	{
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, MARKET_DATA_FILE_MAGIC, 4);
+		header.version = MARKET_DATA_FILE_VERSION;
+		header.depth = MARKET_DATA_DEPTH;
+		header.blockRows = blockRows;
+		// placeholder, rewritten with the final counts on Close()
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		cusipColumn.reserve(blockRows);
+		for (auto& column : priceColumns) column.reserve(blockRows);
+		for (auto& column : quantityColumns) column.reserve(blockRows);
+	};
+
+	~MarketDataFileWriter()
+	{
+		Close();
+	};
+
+	bool IsOpen() const
+	{
+		return out.is_open();
+	};
+
+	// false once a write to the file has failed
+	bool IsGood() const
+	{
+		return bool(out);
+	};
+
+	// append one snapshot, prices in ticks and quantities for bid levels 1-5 then offer levels 1-5
+	// false if the snapshot names a new CUSIP once the index already holds MARKET_DATA_MAX_CUSIPS,
+	// or if writing a full block failed
+	bool Add(std::string_view cusip, const long* ticks, const long* quantities)
+	{
+		auto it = cusipIds.find(cusip);
+		if (it == cusipIds.end())
+		{
+			if (cusipIndex.size() == MARKET_DATA_MAX_CUSIPS) return false;
+			it = cusipIds.emplace(std::string(cusip), uint16_t(cusipIndex.size())).first;
+			cusipIndex.emplace_back(cusip);
+		}
+		cusipColumn.push_back(it->second);
+		for (int l = 0; l < MARKET_DATA_LEVELS; ++l)
+		{
+			priceColumns[l].push_back(int32_t(ticks[l]));
+			quantityColumns[l].push_back(int64_t(quantities[l]));
+		}
+		if (cusipColumn.size() == header.blockRows) return WriteBlock();
+		return true;
+	};
+
+	// write the last block, the cusip index and the final header
+	// false if any write failed, the file is then incomplete and must not be read
+	bool Close()
+	{
+		if (!out.is_open()) return closed;
+		if (!WriteBlock())
+		{
+			out.close();
+			return false;
+		}
+
+		header.indexOffset = uint64_t(out.tellp());
+		header.cusipCount = uint32_t(cusipIndex.size());
+		for (auto& cusip : cusipIndex)
+		{
+			char entry[MARKET_DATA_CUSIP_WIDTH] = {};
+			std::memcpy(entry, cusip.data(), std::min(cusip.size(), size_t(MARKET_DATA_CUSIP_WIDTH)));
+			out.write(entry, MARKET_DATA_CUSIP_WIDTH);
+		}
+
+		if (!out)
+		{
+			out.close();
+			return false;
+		}
+
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.close();
+		closed = bool(out);
+		return closed;
+	};
+};
+
+// whether binPath is a readable binary market data file written after txtPath last changed, so it holds the same books
+inline bool MarketDataFileIsCurrent(const std::string& txtPath, const std::string& binPath)
+{
+	if (!MarketDataFileReader(binPath).IsValid()) return false;
+	std::error_code txtError, binError;
+	auto txtTime = std::filesystem::last_write_time(txtPath, txtError);
+	auto binTime = std::filesystem::last_write_time(binPath, binError);
+	return !txtError && !binError && binTime >= txtTime;
+}
+
+// convert a marketdata.txt file into the binary columnar format, returns the number of snapshots
+inline uint64_t convert_marketdata(const std::string& txtPath = "input/marketdata.txt", const std::string& binPath = "input/marketdata.bin")
+{
+	cout << "Converting " << txtPath << " to " << binPath << endl;
+
+	MappedFileReader myfile(txtPath);
+	MarketDataFileWriter writer(binPath);
+	if (!myfile.IsOpen() || !writer.IsOpen())
+	{
+		cout << "Cannot open market data files for conversion." << endl;
+		return 0;
+	}
+
+	std::vector<std::string_view> data;
+	long ticks[MARKET_DATA_LEVELS];
+	long quantities[MARKET_DATA_LEVELS];
+	uint64_t rows = 0;
+
+	// skip the header
+	myfile.NextRow(data);
+	while (myfile.NextRow(data))
+	{
+		if (data.size() < 1 + 2 * MARKET_DATA_LEVELS) continue;
+		if (!AcceptInputSecurity(SecurityId::Parse(data[0]), data[0])) continue;
+		// bids are fields 1-10 and offers 11-20, price and quantity interleaved
+		ParseTicksBatch(&data[1], MARKET_DATA_LEVELS, 2, ticks);
+		bool numbers = true;
+		for (int l = 0; l < MARKET_DATA_LEVELS && numbers; ++l) numbers = FieldToLong(data[2 + 2 * l], quantities[l]);
+		if (!numbers)
+		{
+			RejectInputField();
+			continue;
+		}
+		if (!writer.Add(data[0], ticks, quantities))
+		{
+			if (writer.IsGood()) cout << "Cannot convert " << txtPath << ", it has more than " << MARKET_DATA_MAX_CUSIPS << " CUSIPs." << endl;
+			else cout << "Cannot write " << binPath << "." << endl;
+			writer.Close();
+			std::remove(binPath.c_str());
+			return 0;
+		}
+		++rows;
+	}
+	if (!writer.Close())
+	{
+		cout << "Cannot write " << binPath << "." << endl;
+		std::remove(binPath.c_str());
+		return 0;
+	}
+
+	cout << "Converting market data is done, " << rows << " order books written." << endl;
+	return rows;
+}
+
+#endif /* BondMarketDataFile_h */
@@ -15,6 +15,12 @@
 #include <map>
 #include "soa.hpp"
 #include "products.hpp"
+#include "MappedFileReader.h"
+#include "TickPrice.h"
+#include "BondMarketDataFile.h"
+#include "PipelinedIngest.h"
+#include "EventBatch.h"
+#include "ParallelLoader.h"
 
 /*******************************************************************************/
 /**
@@ -39,10 +45,10 @@ public:
 	Order() {};
 
 	// ctor for an order
-	Order(double _price, long _quantity, PricingSide _side);
+	Order(TickPrice _price, long _quantity, PricingSide _side);
 
 	// Get the price on the order
-	double GetPrice() const;
+	TickPrice GetPrice() const;
 
 	// Get the quantity on the order
 	long GetQuantity() const;
@@ -51,7 +57,7 @@ public:
 	PricingSide GetSide() const;
 
 private:
-	double price;
+	TickPrice price;
 	long quantity;
 	PricingSide side;
 
@@ -105,7 +111,7 @@ public:
 	const vector<Order>& GetOfferStack() const;
 
 private:
-	T product;
+	ProductHandle<T> product;
 	vector<Order> bidStack;
 	vector<Order> offerStack;
 
@@ -130,14 +136,14 @@ public:
 
 };
 
-Order::Order(double _price, long _quantity, PricingSide _side)
+Order::Order(TickPrice _price, long _quantity, PricingSide _side)
 {
 	price = _price;
 	quantity = _quantity;
 	side = _side;
 }
 
-double Order::GetPrice() const
+TickPrice Order::GetPrice() const
 {
 	return price;
 }
@@ -176,7 +182,7 @@ OrderBook<T>::OrderBook(const T &_product, const vector<Order> &_bidStack, const
 template<typename T>
 const T& OrderBook<T>::GetProduct() const
 {
-	return product;
+	return product.Get();
 }
 
 template<typename T>
@@ -199,7 +205,7 @@ class BondMarketDataService : public Service<std::string, OrderBook<Bond>>
 {
 private:
 	// a map for market data info
-	std::map<std::string, OrderBook<Bond>> marketData;
+	ProductTable<OrderBook<Bond>> marketData;
 	std::vector<ServiceListener<OrderBook<Bond>>*> mdListeners;
 	BondMarketDataService() {};
 
@@ -216,10 +222,16 @@ public:
 		}
 	};
 
+	// count books at once, each listener gets all of them in one call
+	void OnMessageBatch(OrderBook<Bond>* data, size_t count) override
+	{
+		for (auto& listener : mdListeners) listener->ProcessAddBatch(data, count);
+	};
+
 	// get orderbook info given a key
 	OrderBook<Bond>& GetData(std::string key) override
 	{
-		return marketData.at(key);
+		return marketData.At(key);
 	};
 
 	void AddListener(ServiceListener<OrderBook<Bond>> *listener) override
@@ -241,15 +253,32 @@ public:
 };
 
 
+/**
+* A decoded row of marketdata.txt, reused across rows by the connector.
+* Levels 0-4 are the bid stack and 5-9 the offer stack, best first.
+*/
+struct MarketDataRow
+{
+	SecurityId cusip;
+	long ticks[MARKET_DATA_LEVELS];       // prices in 1/256
+	long quantities[MARKET_DATA_LEVELS];
+	long timestamp;  // microseconds since the session start, 0 if the file has none
+};
+
 class BondMarketDataConnector : public Connector<OrderBook<Bond>>
 {
 private:
 	// define the bond_service pointer
 	BondMarketDataService *bondMDSer;
 	BondProductService *productService;
+	// events waiting for the next OnMessageBatch
+	EventBatcher<OrderBook<Bond>> batcher;
+	// order stacks reused for every book
+	std::vector<Order> bidOrder;
+	std::vector<Order> offerOrder;
 
 	// initialize object pointers
-	BondMarketDataConnector()
+	BondMarketDataConnector() : batcher(BondMarketDataService::create_service())
 	{
 		bondMDSer = BondMarketDataService::create_service();
 		productService = BondProductService::create_service();
@@ -259,103 +288,154 @@ public:
 	// override virtual function, no implementation
 	void Publish(OrderBook<Bond> &data) {};
 
+	// decode the fields of one row, false for blank or truncated rows, for a CUSIP failing its check digit and for a
+	// quantity or timestamp that is not a number
+	static bool ParseRow(const std::vector<std::string_view>& data, MarketDataRow& row)
+	{
+		if (data.size() < 1 + 2 * MARKET_DATA_LEVELS) return false;
+		row.cusip = SecurityId::Parse(data[0]);
+		if (!AcceptInputSecurity(row.cusip, data[0])) return false;
+		// translate all prices of the row at once, bids start at field 1 and offers at 11
+		ParseTicksBatch(&data[1], MARKET_DATA_LEVELS, 2, row.ticks);
+		for (int l = 0; l < MARKET_DATA_LEVELS; ++l)
+		{
+			if (!FieldToLong(data[2 + 2 * l], row.quantities[l])) return RejectInputField();
+		}
+		row.timestamp = 0;
+		if (data.size() > 1 + 2 * MARKET_DATA_LEVELS && !FieldToLong(data[1 + 2 * MARKET_DATA_LEVELS], row.timestamp)) return RejectInputField();
+		return true;
+	};
+
+	// build the order book of a decoded row and pass it to the service
+	void DeliverRow(const MarketDataRow& row)
+	{
+		// each row is a full 5-deep snapshot, keep the capacity but not the previous orders
+		bidOrder.clear();
+		offerOrder.clear();
+		for (int i = 0; i < MARKET_DATA_DEPTH; ++i)
+		{
+			int o = MARKET_DATA_DEPTH + i;
+			// Order(TickPrice _price, long _quantity, PricingSide _side);
+			bidOrder.push_back(Order(TickPrice(row.ticks[i]), row.quantities[i], BID));
+			offerOrder.push_back(Order(TickPrice(row.ticks[o]), row.quantities[o], OFFER));
+		}
+		// create Bond object reference
+		//Bond& bond = bondMap[cusip];
+		const Bond &bond = productService->GetData(row.cusip);
+		// OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack);
+		OrderBook<Bond> bondOrderBook(bond, bidOrder, offerOrder);
+		batcher.Add(std::move(bondOrderBook));
+	};
+
 	// read the data from marketdata.txt
 	void Subscribe()
 	{
-		// read data from each line
-		auto readLine = [](std::string& row)
-		{
-			stringstream line(row);
-			std::vector<std::string> mystring;
-			std::string str;
+		std::cout << "Reading market data from marketdata.txt" << std::endl;
+		MappedFileReader myfile("input/marketdata.txt");
 
-			while (getline(line, str, ','))
-			{
-				mystring.push_back(str);
-			}
-			return mystring;
-		};
+		// fields of the current row, views into the mapped file
+		std::vector<std::string_view> data;
+		MarketDataRow row;
 
-		// convert string to actual price
-		auto strToPrice = [](std::string& str)
+		myfile.NextRow(data);
+		while (myfile.NextRow(data))
 		{
-			// get size of the string
-			int size = str.size();
-			// get the last digit of the string
-			char lstChar = str[size - 1];
-			// convert the last character
-			int lstDigit;
-			if (lstChar == '+') { lstDigit = 4; }
-			else { lstDigit = lstChar - '0'; } // converts a character to the integer value
-
-			// convert string in the middle
-			size_t index = str.find_first_of('-');
-			int midDigit = std::stoi(str.substr(index + 1, 2));
-
-			// covert the first integer
-			double firstDigit = std::stoi(str.substr(0, index));
-
-			// combination of each part
-			double res = firstDigit + midDigit / 32.0 + lstDigit / 256.0;
-			return res;
-		};
+			if (ParseRow(data, row)) DeliverRow(row);
+		}
+		batcher.Flush();
 
-		std::cout << "Reading market data from marketdata.txt" << std::endl;
-		ifstream myfile("input/marketdata.txt");
-		string row;
-
-		PricingSide bidSide = BID; //initialize the bid price side
-		PricingSide offerSide = OFFER; //initialize the offer price side
-		std::vector<Order> bidOrder; //initialize the bid order vector
-		std::vector<Order> offerOrder; //initialize the offer order vector
-		string cusip;
-		double bidPrice;
-		double offerPrice;
-		long bidQuantity;
-		long offerQuantity;
-		int bidIndex = 1;
-		int offerIndex = 11;
-
-		getline(myfile, row);
-		while (getline(myfile, row))
+		std::cout << "Reading market data is done. Execution data is generated." << std::endl;
+	};
+
+	// read the data from marketdata.txt, parsing on a separate thread that feeds this one through a ring of capacity rows
+	IngestStats SubscribePipelined(size_t capacity = 1024)
+	{
+		std::cout << "Reading market data from marketdata.txt (pipelined)" << std::endl;
+		MappedFileReader myfile("input/marketdata.txt");
+
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		IngestStats stats = RunPipelined<MarketDataRow>(myfile, capacity, &BondMarketDataConnector::ParseRow,
+			[this](MarketDataRow& row) { DeliverRow(row); });
+		batcher.Flush();
+
+		std::cout << "Market data ingest " << stats << std::endl;
+		std::cout << "Reading market data is done. Execution data is generated." << std::endl;
+		return stats;
+	};
+
+	// read data from marketdata.txt, parsing chunks of the file on threads worker threads, delivered in file order
+	size_t SubscribeParallel(size_t threads = std::thread::hardware_concurrency())
+	{
+		std::cout << "Reading market data from marketdata.txt (" << threads << " threads)" << std::endl;
+		MappedFileReader myfile("input/marketdata.txt");
+
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		size_t events = RunParallel<MarketDataRow>(myfile, threads, &BondMarketDataConnector::ParseRow,
+			[this](MarketDataRow& row) { DeliverRow(row); });
+		batcher.Flush();
+
+		std::cout << "Market data ingest events: " << events << std::endl;
+		std::cout << "Reading market data is done. Execution data is generated." << std::endl;
+		return events;
+	};
+
+	// read order books from a binary file written by convert_marketdata(), no text parsing involved
+	void SubscribeBinary(const std::string& path = "input/marketdata.bin")
+	{
+		std::cout << "Reading market data from " << path << std::endl;
+		MarketDataFileReader myfile(path);
+		if (!myfile.IsValid())
 		{
-			bidIndex = 1;
-			offerIndex = 11;
+			std::cout << "Cannot read binary market data from " << path << std::endl;
+			return;
+		}
+
+		// resolve every CUSIP of the index once instead of once per book
+		std::vector<const Bond*> bonds;
+		for (auto& cusip : myfile.GetCusips()) bonds.push_back(&productService->GetData(cusip));
 
-			// initialzie the string vector to store the data read from the txt file
-			std::vector<std::string> data = readLine(row);
-			cusip = data[0];
-			for (int i = 0; i < 5; ++i)
+		MarketDataBlock block;
+		uint64_t blocks = 0;
+		while (myfile.NextBlock(block))
+		{
+			++blocks;
+			for (uint32_t r = 0; r < block.rows; ++r)
 			{
-				// bidOrder
-				// translate the price
-				bidPrice = strToPrice(data[bidIndex++]);
-				bidQuantity = std::stol(data[bidIndex++]);  //convert string to long
-															
-			    // Order(double _price, long _quantity, PricingSide _side);
-				Order bid_order(bidPrice, bidQuantity, bidSide);
-				// push back the Order object to the vector
-				bidOrder.push_back(bid_order);
-
-				// offerOrder
-				// translate the price
-				offerPrice = strToPrice(data[offerIndex++]);
-				offerQuantity = std::stol(data[offerIndex++]); //convert string to long
-				Order offer_order(offerPrice, offerQuantity, offerSide);
-				// push back the Order object to the vector
-				offerOrder.push_back(offer_order);
+				bidOrder.clear();
+				offerOrder.clear();
+				for (int i = 0; i < MARKET_DATA_DEPTH; ++i)
+				{
+					int o = MARKET_DATA_DEPTH + i;
+					bidOrder.push_back(Order(TickPrice(block.prices[i][r]), long(block.quantities[i][r]), BID));
+					offerOrder.push_back(Order(TickPrice(block.prices[o][r]), long(block.quantities[o][r]), OFFER));
+				}
+				OrderBook<Bond> bondOrderBook(*bonds[block.cusips[r]], bidOrder, offerOrder);
+				batcher.Add(std::move(bondOrderBook));
 			}
-			// create Bond object reference
-			//Bond& bond = bondMap[cusip];
-			Bond &bond = productService->GetData(cusip);
-			// OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack);
-			OrderBook<Bond> bondOrderBook(bond, bidOrder, offerOrder);
-			bondMDSer->OnMessage(bondOrderBook);
+		}
+		batcher.Flush();
+		if (blocks < myfile.GetHeader().blockCount)
+		{
+			std::cout << "Stopped at a truncated or corrupt block " << blocks << " of " << path << std::endl;
 		}
 
 		std::cout << "Reading market data is done. Execution data is generated." << std::endl;
 	};
 
+	// events per OnMessageBatch call, 1 passes every event on as it is read
+	void SetBatchSize(size_t batchSize)
+	{
+		batcher.SetBatchSize(batchSize);
+	};
+
+	// pass on the events held for the current batch
+	void FlushBatch()
+	{
+		batcher.Flush();
+	};
+
 	// get service of a listener
 	BondMarketDataService *GetService()
 	{
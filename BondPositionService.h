@@ -54,7 +54,7 @@ public:
 	void AddPosition(const std::string& book, long& pos);
 
 private:
-	T product;
+	ProductHandle<T> product;
 	map<string, long> positions;
 
 };
@@ -88,7 +88,7 @@ Position<T>::Position(const T &_product) :
 template<typename T>
 const T& Position<T>::GetProduct() const
 {
-	return product;
+	return product.Get();
 }
 
 template<typename T>
@@ -121,8 +121,8 @@ void Position<T>::AddPosition(const std::string& book, long& pos)
 class BondPositionService : public Service<std::string, Position<Bond>>
 {
 private:
-	// a map for pos data, cusip -> position
-	std::map<std::string, Position<Bond>> posData; 
+	// pos data by product index
+	ProductTable<Position<Bond>> posData;
 	std::vector<ServiceListener<Position<Bond>>*> posListeners;
 	BondPositionService() {};
 
@@ -130,14 +130,14 @@ public:
 	// add a position
 	void Add(Position<Bond>& pos)
 	{
-		posData.insert(std::make_pair(pos.GetProduct().GetProductId(), pos));
+		posData.Insert(pos.GetProduct().GetProductIndex(), pos);
 	};
 
 	// add a trade to the service
 	void AddTrade(const Trade<Bond>& trade)
 	{
 		// store the data
-		std::string prodId = trade.GetProduct().GetProductId();
+		ProductIndex prodId = trade.GetProduct().GetProductIndex();
 		long quantity = trade.GetQuantity();
 		long Tquantity;
 		if (trade.GetSide() == Side::BUY) { Tquantity = quantity; }
@@ -151,7 +151,7 @@ public:
 	// get price info given cusip
 	Position<Bond>& GetData(std::string cusip) override
 	{
-		return posData.at(cusip);
+		return posData.At(cusip);
 	};
 
 	// override virtual
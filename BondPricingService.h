@@ -14,6 +14,11 @@
 #include <sstream>
 #include "soa.hpp"
 #include "products.hpp"
+#include "MappedFileReader.h"
+#include "TickPrice.h"
+#include "PipelinedIngest.h"
+#include "EventBatch.h"
+#include "ParallelLoader.h"
 
 /*************************************************************************************/
 /**
@@ -36,21 +41,21 @@ public:
 	Price() {};
 
 	// ctor for a price
-	Price(const T &_product, double _mid, double _bidOfferSpread);
+	Price(const T &_product, TickPrice _mid, TickPrice _bidOfferSpread);
 
 	// Get the product
 	const T& GetProduct() const;
 
 	// Get the mid price
-	double GetMid() const;
+	TickPrice GetMid() const;
 
 	// Get the bid/offer spread around the mid
-	double GetBidOfferSpread() const;
+	TickPrice GetBidOfferSpread() const;
 
 private:
-	const T& product;
-	double mid;
-	double bidOfferSpread;
+	ProductHandle<T> product;
+	TickPrice mid;
+	TickPrice bidOfferSpread;
 
 };
 
@@ -65,7 +70,7 @@ class PricingService : public Service<string, Price <T> >
 };
 
 template<typename T>
-Price<T>::Price(const T &_product, double _mid, double _bidOfferSpread) :
+Price<T>::Price(const T &_product, TickPrice _mid, TickPrice _bidOfferSpread) :
 	product(_product)
 {
 	mid = _mid;
@@ -75,17 +80,17 @@ Price<T>::Price(const T &_product, double _mid, double _bidOfferSpread) :
 template<typename T>
 const T& Price<T>::GetProduct() const
 {
-	return product;
+	return product.Get();
 }
 
 template<typename T>
-double Price<T>::GetMid() const
+TickPrice Price<T>::GetMid() const
 {
 	return mid;
 }
 
 template<typename T>
-double Price<T>::GetBidOfferSpread() const
+TickPrice Price<T>::GetBidOfferSpread() const
 {
 	return bidOfferSpread;
 }
@@ -97,7 +102,7 @@ class BondPricingService : public Service<std::string, Price<Bond>>
 {
 private:
 	// a map for price data
-	std::map<std::string, Price<Bond>> priceData;
+	ProductTable<Price<Bond>> priceData;
 	// member data for listeners
 	std::vector<ServiceListener<Price<Bond>>*> priceListeners;     
 	BondPricingService() {};
@@ -107,7 +112,7 @@ public:
 	//virtual Price<Bond>& GetData(string key) override {};
 
 	// Price ctor:
-	// const T &_product, double _mid, double _bidOfferSpread
+	// const T &_product, TickPrice _mid, TickPrice _bidOfferSpread
 	void OnMessage(Price<Bond>& price) override
 	{
 		// get the bid offer spread
@@ -118,17 +123,27 @@ public:
 		//double offerPrice = mid_price + price_spread / 2;
 		//double bidPrice = mid_price - price_spread / 2;
 
-		auto prodId = price.GetProduct().GetProductId();
-		priceData.insert(std::make_pair(prodId, price));
+		priceData.Insert(price.GetProduct().GetProductIndex(), price);
 
 		std::cout << "flow the data from pricingservice to the listener." << std::endl;
 		for (auto& listener : priceListeners) listener->ProcessAdd(price);
 	};
 
+	// count prices at once, each listener gets all of them in one call
+	void OnMessageBatch(Price<Bond>* prices, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			priceData.Insert(prices[i].GetProduct().GetProductIndex(), prices[i]);
+			std::cout << "flow the data from pricingservice to the listener." << std::endl;
+		}
+		for (auto& listener : priceListeners) listener->ProcessAddBatch(prices, count);
+	};
+
 	// get price info given a key
 	Price<Bond>& GetData(std::string key) override
 	{
-		return priceData.at(key);
+		return priceData.At(key);
 	};
 
 	void AddListener(ServiceListener<Price<Bond>> *listener) override
@@ -150,15 +165,28 @@ public:
 };
 
 
+/**
+* A decoded row of prices.txt, reused across rows by the connector.
+*/
+struct PriceRow
+{
+	SecurityId cusip;
+	TickPrice mid;
+	TickPrice spread;
+	long timestamp;  // microseconds since the session start, 0 if the file has none
+};
+
 class BondPricingConnector : public Connector<Price<Bond>>
 {
 private:
 	// BondPricingService object pointer
 	BondPricingService *bondServ;
 	BondProductService *productService;
+	// events waiting for the next OnMessageBatch
+	EventBatcher<Price<Bond>> batcher;
 
 	// cretae object pointers 
-	BondPricingConnector()
+	BondPricingConnector() : batcher(BondPricingService::create_service())
 	{
 		bondServ = BondPricingService::create_service();
 		productService = BondProductService::create_service();
@@ -169,81 +197,98 @@ public:
 	// override virtual function, no implementation
 	void Publish(Price<Bond>& data) {};
 
+	// decode the fields of one row, false for blank or truncated rows, for a CUSIP failing its check digit and for a
+	// timestamp that is not a number
+	static bool ParseRow(const std::vector<std::string_view>& data, PriceRow& row)
+	{
+		if (data.size() < 3) return false;
+		row.cusip = SecurityId::Parse(data[0]);
+		if (!AcceptInputSecurity(row.cusip, data[0])) return false;
+		// translate the price
+		row.mid = TickPrice::FromString(data[1]);
+		row.spread = TickPrice::FromString(data[2]);
+		row.timestamp = 0;
+		if (data.size() > 3 && !FieldToLong(data[3], row.timestamp)) return RejectInputField();
+		return true;
+	};
+
+	// build the price of a decoded row and pass it to the service
+	void DeliverRow(const PriceRow& row)
+	{
+		// initialize a Bond object 
+		//Bond& bond = bondMap[cusip];
+		const Bond &bond = productService->GetData(row.cusip);
+
+		// (const T &_product, TickPrice _mid, TickPrice _bidOfferSpread);
+		Price<Bond> bPrice(bond, row.mid, row.spread);
+
+		// publish price data
+		batcher.Add(std::move(bPrice));
+	};
+
 	// read data from price.txt file
 	void Subscribe()
 	{
 		std::cout << "Reading pricing data from prices.txt" << std::endl;
-		ifstream myfile("input/prices.txt");
+		MappedFileReader myfile("input/prices.txt");
 
-		string row;
-		string cusip, midPrice, bid_offer_spread;
+		// fields of the current row, views into the mapped file
+		std::vector<std::string_view> data;
+		PriceRow row;
 
-		// read data from each line
-		auto readLine = [](std::string& row)
+		myfile.NextRow(data);
+		while (myfile.NextRow(data))
 		{
-			stringstream line(row);
-			std::vector<std::string> mystring;
-			std::string str;
+			if (ParseRow(data, row)) DeliverRow(row);
+		}
+		batcher.Flush();
+		std::cout << "Reading pricing data is done. Streaming data is generated. " << std::endl;
+	};
 
-			while (getline(line, str, ','))
-			{
-				mystring.push_back(str);
-			}
+	// read data from price.txt file, parsing on a separate thread that feeds this one through a ring of capacity rows
+	IngestStats SubscribePipelined(size_t capacity = 1024)
+	{
+		std::cout << "Reading pricing data from prices.txt (pipelined)" << std::endl;
+		MappedFileReader myfile("input/prices.txt");
 
-			return mystring;
-		};
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		IngestStats stats = RunPipelined<PriceRow>(myfile, capacity, &BondPricingConnector::ParseRow,
+			[this](PriceRow& row) { DeliverRow(row); });
+		batcher.Flush();
 
-		// convert string to actual price
-		auto strToPrice = [](std::string& str)
-		{
-			// get size of the string
-			int size = str.size();
-			// get the last digit of the string
-			char lstChar = str[size - 1];
-			// convert the last character
-			int lstDigit;
-			if (lstChar == '+') { lstDigit = 4; }
-			else { lstDigit = lstChar - '0'; } // converts a character to the integer value
-
-			// convert string in the middle
-			size_t index = str.find_first_of('-');
-			int midDigit = std::stoi(str.substr(index + 1, 2));
-
-			// covert the first integer
-			double firstDigit = std::stoi(str.substr(0, index));
-
-			// combination of each part
-			double res = firstDigit + midDigit / 32.0 + lstDigit / 256.0;
-			return res;
-		};
-
-		getline(myfile, row);
-
-		while (getline(myfile, row))
-		{
-			// store strings from price.txt to a vector
-			std::vector<std::string> data = readLine(row);
+		std::cout << "Price ingest " << stats << std::endl;
+		std::cout << "Reading pricing data is done. Streaming data is generated. " << std::endl;
+		return stats;
+	};
 
-			//tie(product_type, mid_price, bid_offer_spread) = make_tuple(data[0], data[1], data[2]);
-			cusip = data[0];
-			midPrice = data[1];
-			bid_offer_spread = data[2];
+	// read data from prices.txt, parsing chunks of the file on threads worker threads, delivered in file order
+	size_t SubscribeParallel(size_t threads = std::thread::hardware_concurrency())
+	{
+		std::cout << "Reading pricing data from prices.txt (" << threads << " threads)" << std::endl;
+		MappedFileReader myfile("input/prices.txt");
 
-			// translate the price
-			double mid = strToPrice(midPrice);
-			double spread = strToPrice(bid_offer_spread);
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		size_t events = RunParallel<PriceRow>(myfile, threads, &BondPricingConnector::ParseRow,
+			[this](PriceRow& row) { DeliverRow(row); });
+		batcher.Flush();
 
-			// initialize a Bond object 
-			//Bond& bond = bondMap[cusip];
-			Bond &bond = productService->GetData(cusip);
+		std::cout << "Price ingest events: " << events << std::endl;
+		std::cout << "Reading pricing data is done. Streaming data is generated. " << std::endl;
+		return events;
+	};
 
-			// (const T &_product, double _mid, double _bidOfferSpread);
-			Price<Bond> bPrice(bond, mid, spread);
+	// events per OnMessageBatch call, 1 passes every event on as it is read
+	void SetBatchSize(size_t batchSize)
+	{
+		batcher.SetBatchSize(batchSize);
+	};
 
-			// publish price data
-			bondServ->OnMessage(bPrice);
-		}
-		std::cout << "Reading pricing data is done. Streaming data is generated. " << std::endl;
+	// pass on the events held for the current batch
+	void FlushBatch()
+	{
+		batcher.Flush();
 	};
 
 	// get service of a listener
@@ -0,0 +1,253 @@
+#pragma once
+//
+//  BondReplayEngine.h
+//  MTH 9815
+//
+
+#ifndef BondReplayEngine_h
+#define BondReplayEngine_h
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <queue>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include "MappedFileReader.h"
+#include "BondTradeBookingService.h"
+#include "BondPricingService.h"
+#include "BondMarketDataService.h"
+#include "BondInquiryService.h"
+
+using namespace std;
+
+// pacing of a replay
+// REAL_TIME follows the timestamps, ACCELERATED runs them speed times faster, AS_FAST_AS_POSSIBLE never waits
+enum ReplayMode { REAL_TIME, ACCELERATED, AS_FAST_AS_POSSIBLE };
+
+/**
+* Histogram of durations in nanoseconds with power-of-two buckets.
+* Percentiles are reported as the upper bound of their bucket.
+*/
+class LatencyHistogram
+{
+private:
+	uint64_t buckets[64] = {};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t maximum = 0;
+
+public:
+	void Record(uint64_t nanos)
+	{
+		int b = 0;
+		while (b < 63 && (uint64_t(1) << (b + 1)) <= nanos) ++b;
+		++buckets[b];
+		++count;
+		sum += nanos;
+		if (nanos > maximum) maximum = nanos;
+	};
+
+	uint64_t Count() const
+	{
+		return count;
+	};
+
+	double Mean() const
+	{
+		return count ? double(sum) / count : 0.0;
+	};
+
+	uint64_t Max() const
+	{
+		return maximum;
+	};
+
+	// smallest bucket bound below which at least fraction p of the samples fall
+	uint64_t Percentile(double p) const
+	{
+		uint64_t target = uint64_t(p * count);
+		uint64_t seen = 0;
+		for (int b = 0; b < 64; ++b)
+		{
+			seen += buckets[b];
+			if (seen > target || seen == count) return std::min(maximum, (uint64_t(1) << (b + 1)) - 1);
+		}
+		return maximum;
+	};
+
+	friend ostream& operator<<(ostream& os, const LatencyHistogram& h)
+	{
+		os << "mean " << h.Mean() << "ns, p50 <" << h.Percentile(0.5) << "ns, p99 <" << h.Percentile(0.99) << "ns, max " << h.Max() << "ns";
+		return os;
+	};
+};
+
+/**
+* Counters reported by a replay.
+*/
+struct ReplayStats
+{
+	size_t events = 0;
+	double seconds = 0.0;
+	LatencyHistogram processing;  // time spent delivering each event through the services
+	LatencyHistogram lateness;    // how far behind its scheduled time each event was dispatched
+
+	friend ostream& operator<<(ostream& os, const ReplayStats& stats)
+	{
+		os << "events: " << stats.events << ", seconds: " << stats.seconds
+			<< ", events/s: " << (stats.seconds > 0 ? stats.events / stats.seconds : 0.0) << endl;
+		os << "  processing " << stats.processing << endl;
+		os << "  lateness " << stats.lateness;
+		return os;
+	};
+};
+
+/**
+* A time-ordered stream of events read from one input file.
+*/
+class ReplaySource
+{
+public:
+	virtual ~ReplaySource() {};
+
+	// move to the next event, false when the source is exhausted
+	virtual bool Advance() = 0;
+
+	// timestamp of the current event in microseconds
+	virtual long Timestamp() const = 0;
+
+	// push the current event into the services
+	virtual void Deliver() = 0;
+};
+
+/**
+* Replay source over an input file, decoded with ParseRow and delivered with DeliverRow of a connector.
+*/
+template<typename C, typename Row>
+class ConnectorReplaySource : public ReplaySource
+{
+private:
+	MappedFileReader reader;
+	C* connector;
+	Row row;
+	std::vector<std::string_view> data;
+
+public:
+	ConnectorReplaySource(const std::string& path, C* _connector) : reader(path), connector(_connector)
+	{
+		// skip the header
+		reader.NextRow(data);
+	};
+
+	bool Advance() override
+	{
+		while (reader.NextRow(data))
+		{
+			if (C::ParseRow(data, row)) return true;
+		}
+		return false;
+	};
+
+	long Timestamp() const override
+	{
+		return row.timestamp;
+	};
+
+	void Deliver() override
+	{
+		// events are paced one by one, none is held for a batch
+		connector->DeliverRow(row);
+		connector->FlushBatch();
+	};
+};
+
+/**
+* Merges the trades, prices, market data and inquiries files into one stream ordered by timestamp and drives the
+* services through the connectors. Each file must be in time order; events with equal timestamps are delivered in
+* the order the sources were added.
+*/
+class BondReplayEngine
+{
+private:
+	std::vector<std::unique_ptr<ReplaySource>> sources;
+
+public:
+	// add a source of events
+	void AddSource(std::unique_ptr<ReplaySource> source)
+	{
+		sources.push_back(std::move(source));
+	};
+
+	// add the input file of a connector
+	template<typename Row, typename C>
+	void AddConnector(C* connector, const std::string& path)
+	{
+		AddSource(std::unique_ptr<ReplaySource>(new ConnectorReplaySource<C, Row>(path, connector)));
+	};
+
+	// the four default input files
+	void AddDefaultSources()
+	{
+		AddConnector<TradeRow>(BondTradeBookingConnector::create_connector(), "input/trades.txt");
+		AddConnector<PriceRow>(BondPricingConnector::create_connector(), "input/prices.txt");
+		AddConnector<MarketDataRow>(BondMarketDataConnector::create_connector(), "input/marketdata.txt");
+		AddConnector<InquiryRow>(BondInquiryConnector::create_connector(), "input/inquiries.txt");
+	};
+
+	// replay every source to the end
+	ReplayStats Run(ReplayMode mode = AS_FAST_AS_POSSIBLE, double speed = 1.0)
+	{
+		using clock = std::chrono::steady_clock;
+		if (mode == REAL_TIME || speed <= 0) speed = 1.0;
+		std::cout << "Replaying " << sources.size() << " sources." << std::endl;
+
+		// min-heap of (timestamp, source index) over the current event of every source
+		typedef std::pair<long, size_t> Entry;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> next;
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			if (sources[i]->Advance()) next.push(Entry(sources[i]->Timestamp(), i));
+		}
+
+		ReplayStats stats;
+		clock::time_point start = clock::now();
+		long base = next.empty() ? 0 : next.top().first;
+		while (!next.empty())
+		{
+			Entry entry = next.top();
+			next.pop();
+			ReplaySource& source = *sources[entry.second];
+
+			if (mode != AS_FAST_AS_POSSIBLE)
+			{
+				auto offset = std::chrono::duration<double, std::micro>((entry.first - base) / speed);
+				clock::time_point due = start + std::chrono::duration_cast<clock::duration>(offset);
+				clock::time_point now = clock::now();
+				if (now < due)
+				{
+					std::this_thread::sleep_until(due);
+					now = clock::now();
+				}
+				stats.lateness.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count());
+			}
+
+			clock::time_point before = clock::now();
+			source.Deliver();
+			stats.processing.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - before).count());
+			++stats.events;
+
+			if (source.Advance()) next.push(Entry(source.Timestamp(), entry.second));
+		}
+		stats.seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+		std::cout << "Replay is done, " << stats << std::endl;
+		return stats;
+	};
+};
+
+#endif /* BondReplayEngine_h */
@@ -7,6 +7,7 @@
 #define BondRiskService_h
 
 #include "BondPositionService.h"
+#include "GenerateFile.h"
 
 /******************************************************************************************/
 
@@ -36,7 +37,7 @@ public:
 	// Get the product on this PV01 value
 	const T& GetProduct() const
 	{
-		return product;
+		return product.Get();
 	}
 
 	// Get the PV01 value
@@ -56,7 +57,7 @@ public:
 	void UpdatePV01(double pv01);
 
 private:
-	T product;
+	ProductHandle<T> product;
 	double pv01;
 	long quantity;
 
@@ -150,11 +151,27 @@ const string& BucketedSector<T>::GetName() const
 
 using namespace std;
 
+// base seed of the per-product pv01 draws of BondRiskService
+const uint64_t RISK_PV01_SEED = 9815;
+
 class BondRiskService : public Service<std::string, PV01<Bond>>
 {
 private:
-	// a map for pv01 risk data
-	std::map<std::string, PV01<Bond>> riskData;
+	// pv01 risk of a product and the random stream its pv01 moves are drawn from, seeded from the product index so
+	// the draws of a product do not depend on the order the products are risked in, or on which shard risks them
+	struct RiskSlot
+	{
+		PV01<Bond> pv01;
+		GeneratorRng draws;
+
+		RiskSlot(const PV01<Bond>& _pv01, ProductIndex index) :
+			pv01(_pv01), draws(GeneratorRng::ForPartition(RISK_PV01_SEED, index))
+		{
+		};
+	};
+
+	// pv01 risk data by product index
+	ProductTable<RiskSlot> riskData;
 	std::vector<ServiceListener<PV01<Bond>>*> riskListeners;
 	BondRiskService() {};
 
@@ -180,39 +197,53 @@ public:
 		riskMap["912828U24"] = 0.1627;
 		riskMap["912828U40"] = 0.1695;
 		}*/
-		std::string prodId = position.GetProduct().GetProductId();
+		ProductIndex prodId = position.GetProduct().GetProductIndex();
+		if (!riskData.Contains(prodId)) riskData.Insert(prodId, RiskSlot(PV01<Bond>(), prodId));
+		RiskSlot& slot = riskData.At(prodId);
 		// get the pv01 risk based on the productID it retrieve
-		double addPV01 = (rand() % 1000) / 100000.0;
-		riskData[prodId].UpdatePV01(addPV01);
+		double addPV01 = slot.draws.Uniform(1000) / 100000.0;
+		slot.pv01.UpdatePV01(addPV01);
 		// get the position it holds
 		long addQ = position.GetAggregatePosition();
-		riskData[prodId].AddQuantity(addQ);
+		slot.pv01.AddQuantity(addQ);
 		std::cout << "Updating risk." << std::endl;
 		// Review of PV01 ctor:
 		// PV01(const vector<T> &_products, double _pv01, long _quantity);
-		PV01<Bond>& pv01B = riskData[prodId];
 		// Initialize a BondHistoricalDataService object pointer and use risk connector to publish the data
-		for (auto& listener : riskListeners) { listener->ProcessAdd(riskData[prodId]); }
+		for (auto& listener : riskListeners) { listener->ProcessAdd(slot.pv01); }
 	};
 
 	// get the bucketed risk for a given bucket sector
 	double GetBucketedRisk(const BucketedSector<Bond>& sector)
 	{
 		double pv01 = 0;
-		for (auto& bond : sector.GetProducts()) pv01 = pv01 + riskData.at(bond.GetProductId()).GetPV01();
+		for (auto& bond : sector.GetProducts()) pv01 = pv01 + riskData.At(bond.GetProductIndex()).pv01.GetPV01();
+		return pv01;
+	};
+
+	// bucketed risk of the products of a sector for which owns(index) is true, the part of one shard
+	template<typename F>
+	double GetBucketedRisk(const BucketedSector<Bond>& sector, F owns)
+	{
+		double pv01 = 0;
+		for (auto& bond : sector.GetProducts())
+		{
+			if (owns(bond.GetProductIndex())) pv01 = pv01 + riskData.At(bond.GetProductIndex()).pv01.GetPV01();
+		}
 		return pv01;
 	};
 
 	// add pv01 data
 	void Add(PV01<Bond>& data)
 	{
-		riskData.insert(std::make_pair(data.GetProduct().GetProductId(), data));
+		ProductIndex index = data.GetProduct().GetProductIndex();
+		riskData.Insert(index, RiskSlot(data, index));
 	};
 
 	// get the pv01 data given a cusip key
 	PV01<Bond>& GetData(std::string key) override
 	{
-		return riskData.at(key);
+		return riskData.At(key).pv01;
 	};
 
 	// add a listener for add, remove, and update operations
@@ -21,35 +21,60 @@ class BondStreamingService: public StreamingService<Bond>
 {
 private:
 	// a map for price streaming data
-    std::map<std::string, PriceStream<Bond>> streamData;
+    ProductTable<PriceStream<Bond>> streamData;
     std::vector<ServiceListener<PriceStream<Bond>>*> strListeners;
-    BondStreamingService() {};
+    
+    // next of the dynamically wired methods
+    struct NotifyListeners
+    {
+        BondStreamingService* service;
+        void operator()(PriceStream<Bond>& ps)
+        {
+            for (auto& listener: service->strListeners) listener->ProcessAdd(ps);
+        };
+    } notifyListeners;
+    
+    BondStreamingService() : notifyListeners{ this } {};
     
 public:
-    // publish price streaming data
-    void PublishPrice(const PriceStream<Bond>& priceStream)
+    // publish price streaming data, handing it to next instead of the listeners
+    template<typename Next>
+    void PublishPrice(const PriceStream<Bond>& priceStream, Next& next)
     {
         // get cusip
         //Bond thisBond = priceStream.GetProduct();
-        std::string prodId = priceStream.GetProduct().GetProductId();
+        ProductIndex prodId = priceStream.GetProduct().GetProductIndex();
         
         PriceStream<Bond> newStr(priceStream);
-        streamData.insert(std::make_pair(prodId, newStr));
+        streamData.Insert(prodId, newStr);
         
-        // notify the listeners
         PriceStream<Bond> ps = streamData[prodId];
-        for (auto& listener: strListeners) listener->ProcessAdd(ps);
+        next(ps);
     };
     
-	// apply algo price stream
-    void PassBondAlgoStream(const BondAlgoStream& algStr)
+    // publish price streaming data
+    void PublishPrice(const PriceStream<Bond>& priceStream)
+    {
+        // notify the listeners
+        PublishPrice(priceStream, notifyListeners);
+    };
+    
+	// apply algo price stream, handing it to next instead of the listeners
+    template<typename Next>
+    void PassBondAlgoStream(const BondAlgoStream& algStr, Next& next)
     {
         // get price stream data
         auto ps = algStr.GetPriceStream();
-        std::string prodId = ps.GetProduct().GetProductId();
+        ProductIndex prodId = ps.GetProduct().GetProductIndex();
         streamData[prodId] = ps;
         std::cout << "flow the data from bondstreamingservice to the listener." << std::endl;
-        for (auto& listener: strListeners) listener->ProcessAdd(ps);
+        next(ps);
+    };
+    
+	// apply algo price stream
+    void PassBondAlgoStream(const BondAlgoStream& algStr)
+    {
+        PassBondAlgoStream(algStr, notifyListeners);
     };
     
 	// no implementation
@@ -68,7 +93,7 @@ public:
 	// get price stream info given cusip
     PriceStream<Bond>& GetData(std::string key)
     {
-        return streamData.at(key);
+        return streamData.At(key);
     };
     
 	// create pointer
@@ -116,4 +141,25 @@ public:
     };
 };
 
+// stage of a StaticPipeline doing the work of BondStreamingServiceListener, two price streams out per algo stream
+class BondStreamingStage
+{
+private:
+    BondStreamingService* bondStrServ;
+    
+public:
+    BondStreamingStage()
+    {
+        bondStrServ = BondStreamingService::create_service();
+    };
+    
+    template<typename Next>
+    void Process(BondAlgoStream& str, Next& next)
+    {
+        auto ps = str.GetPriceStream();
+        bondStrServ->PassBondAlgoStream(str, next);
+        bondStrServ->PublishPrice(ps, next);
+    };
+};
+
 #endif /* BondStreamingService_h */
@@ -15,6 +15,11 @@
 #include <map>
 #include "soa.hpp"
 #include "products.hpp"
+#include "MappedFileReader.h"
+#include "TickPrice.h"
+#include "PipelinedIngest.h"
+#include "EventBatch.h"
+#include "ParallelLoader.h"
 
 /***************************************************************************/
 
@@ -40,7 +45,7 @@ public:
 
 	Trade() {};
 	// ctor for a trade
-	Trade(const T &_product, string _tradeId, double _price, string _book, long _quantity, Side _side);
+	Trade(const T &_product, string _tradeId, TickPrice _price, string _book, long _quantity, Side _side);
 
 	// Get the product
 	const T& GetProduct() const;
@@ -49,7 +54,7 @@ public:
 	const string& GetTradeId() const;
 
 	// Get the mid price
-	double GetPrice() const;
+	TickPrice GetPrice() const;
 
 	// Get the book
 	const string& GetBook() const;
@@ -61,9 +66,9 @@ public:
 	Side GetSide() const;
 
 private:
-	T product;
+	ProductHandle<T> product;
 	string tradeId;
-	double price;
+	TickPrice price;
 	string book;
 	long quantity;
 	Side side;
@@ -87,7 +92,7 @@ public:
 };
 
 template<typename T>
-Trade<T>::Trade(const T &_product, string _tradeId, double _price, string _book, long _quantity, Side _side) :
+Trade<T>::Trade(const T &_product, string _tradeId, TickPrice _price, string _book, long _quantity, Side _side) :
 	product(_product)
 {
 	tradeId = _tradeId;
@@ -100,7 +105,7 @@ Trade<T>::Trade(const T &_product, string _tradeId, double _price, string _book,
 template<typename T>
 const T& Trade<T>::GetProduct() const
 {
-	return product;
+	return product.Get();
 }
 
 template<typename T>
@@ -110,7 +115,7 @@ const string& Trade<T>::GetTradeId() const
 }
 
 template<typename T>
-double Trade<T>::GetPrice() const
+TickPrice Trade<T>::GetPrice() const
 {
 	return price;
 }
@@ -149,7 +154,7 @@ private:
 	// ctor
 	BondTradeBookingService() {};
 	// member bond trade data
-	std::map<std::string, Trade<Bond>> tradeData;
+	ProductTable<Trade<Bond>> tradeData;
 	// member bond listeners
 	std::vector<ServiceListener<Trade<Bond>>*> bondListeners;
 
@@ -166,15 +171,21 @@ public:
 	// The callback that a Connector should invoke for any new or updated data
 	void OnMessage(Trade<Bond>& trade) override
 	{
-		auto cusip = trade.GetProduct().GetProductId();
-		tradeData.insert(std::make_pair(cusip, trade));
+		tradeData.Insert(trade.GetProduct().GetProductIndex(), trade);
 		BookTrade(trade);
 	};
 
+	// book count trades, each listener gets all of them in one call
+	void OnMessageBatch(Trade<Bond>* trades, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i) tradeData.Insert(trades[i].GetProduct().GetProductIndex(), trades[i]);
+		for (auto& listener : bondListeners) listener->ProcessAddBatch(trades, count);
+	};
+
 	// get bond trade data given cusip
 	Trade<Bond>& GetData(std::string cusip) override
 	{
-		return tradeData.at(cusip);
+		return tradeData.At(cusip);
 	};
 
 	// add a listener
@@ -198,6 +209,20 @@ public:
 };
 
 
+/**
+* A decoded row of trades.txt, reused across rows by the connector.
+*/
+struct TradeRow
+{
+	SecurityId cusip;
+	std::string tradeId;
+	std::string book;
+	TickPrice price;
+	long quantity;
+	Side side;
+	long timestamp;  // microseconds since the session start, 0 if the file has none
+};
+
 // connector
 class BondTradeBookingConnector : public Connector<Trade<Bond>>
 {
@@ -205,92 +230,116 @@ private:
 	// Bondtradeservice object pointer
 	BondTradeBookingService *bookingService;
 	BondProductService *productService;
+	// events waiting for the next OnMessageBatch
+	EventBatcher<Trade<Bond>> batcher;
 
 	// ctor: initialzie the bond_service as object pointer of Bondtradeservice
-	BondTradeBookingConnector()
+	BondTradeBookingConnector() : batcher(BondTradeBookingService::create_service())
 	{
 		bookingService = BondTradeBookingService::create_service();
 		productService = BondProductService::create_service();
 	};
 
 public:
+	// decode the fields of one row, false for blank or truncated rows, for a CUSIP failing its check digit and for a
+	// quantity or timestamp that is not a number
+	static bool ParseRow(const std::vector<std::string_view>& data, TradeRow& row)
+	{
+		if (data.size() < 6) return false;
+		// pass the data to each bond attribute
+		row.cusip = SecurityId::Parse(data[0]);
+		if (!AcceptInputSecurity(row.cusip, data[0])) return false;
+		row.tradeId.assign(data[1]);
+		row.book.assign(data[2]);
+		row.price = TickPrice::FromString(data[3]);
+		if (!FieldToLong(data[4], row.quantity)) return RejectInputField();
+		if (data[5] == "BUY") { row.side = Side::BUY; }
+		else { row.side = Side::SELL; }
+		row.timestamp = 0;
+		if (data.size() > 6 && !FieldToLong(data[6], row.timestamp)) return RejectInputField();
+		return true;
+	};
+
+	// build the trade of a decoded row and pass it to the service
+	void DeliverRow(const TradeRow& row)
+	{
+		// Initialize a Bond object based on the product type
+		//Bond &bond = bondMap[cusip];
+		const Bond &bond = productService->GetData(row.cusip);
+		Trade<Bond> bondTrade(bond, row.tradeId, row.price, row.book, row.quantity, row.side);
+		batcher.Add(std::move(bondTrade));
+	};
+
 	// read data from txt file
 	void Subscribe()
 	{
-		// read data from each line
-		auto readLine = [](std::string& row)
-		{
-			stringstream line(row);
-			std::vector<std::string> mystring;
-			std::string str;
-
-			while (getline(line, str, ','))
-			{
-				mystring.push_back(str);
-			}
-			return mystring;
-		};
-
-		// convert string to actual price
-		auto strToPrice = [](std::string& str)
-		{
-			// get size of the string
-			int size = str.size();
-			// get the last digit of the string
-			char lstChar = str[size - 1];
-			// convert the last character
-			int lstDigit;
-			if (lstChar == '+') { lstDigit = 4; }
-			else { lstDigit = lstChar - '0'; } // converts a character to the integer value
-
-											   // convert string in the middle
-			auto index = str.find_first_of("-");
-			int midDigit = std::stoi(str.substr(index + 1, 2));
-
-			// covert the first integer
-			double firstDigit = std::stoi(str.substr(0, index));
-
-			// combination of each part
-			double res = firstDigit + midDigit / 32.0 + lstDigit / 256.0;
-			return res;
-		};
-
 		std::cout << "Reading data from trades.txt" << std::endl;
-		ifstream myfile("input/trades.txt");
+		MappedFileReader myfile("input/trades.txt");
 
-		// bond trade attributes
-		std::string cusip, tradeId, book, price, quantity, side;
-		std::string row;
+		// fields of the current row, views into the mapped file
+		std::vector<std::string_view> data;
+		TradeRow row;
 
 		// skip the first line
-		getline(myfile, row);
-		while (getline(myfile, row))
+		myfile.NextRow(data);
+		while (myfile.NextRow(data))
 		{
-			// read the line and store the string into a vector
-			std::vector<std::string> data = readLine(row);
-			// pass the data to each bond attribute
-			cusip = data[0];
-			tradeId = data[1];
-			book = data[2];
-			price = data[3];
-			quantity = data[4];
-			side = data[5];
-			// Initialize a Bond object based on the product type
-			//Bond &bond = bondMap[cusip];
-			Bond &bond = productService->GetData(cusip);
-			Side tradeSide;
-			if (side == "BUY") { tradeSide = Side::BUY; }
-			else { tradeSide = Side::SELL; }
-			double tradePrice = strToPrice(price);
-			Trade<Bond> bondTrade(bond, tradeId, tradePrice, book, stol(quantity), tradeSide);
-			bookingService->OnMessage(bondTrade);
+			if (ParseRow(data, row)) DeliverRow(row);
 		}
+		batcher.Flush();
 		std::cout << "Risk data is outputed." << std::endl;
 	};
 
+	// read data from txt file, parsing on a separate thread that feeds this one through a ring of capacity rows
+	IngestStats SubscribePipelined(size_t capacity = 1024)
+	{
+		std::cout << "Reading data from trades.txt (pipelined)" << std::endl;
+		MappedFileReader myfile("input/trades.txt");
+
+		// skip the first line
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		IngestStats stats = RunPipelined<TradeRow>(myfile, capacity, &BondTradeBookingConnector::ParseRow,
+			[this](TradeRow& row) { DeliverRow(row); });
+		batcher.Flush();
+
+		std::cout << "Trade ingest " << stats << std::endl;
+		std::cout << "Risk data is outputed." << std::endl;
+		return stats;
+	};
+
+	// read data from trades.txt, parsing chunks of the file on threads worker threads, delivered in file order
+	size_t SubscribeParallel(size_t threads = std::thread::hardware_concurrency())
+	{
+		std::cout << "Reading data from trades.txt (" << threads << " threads)" << std::endl;
+		MappedFileReader myfile("input/trades.txt");
+
+		std::vector<std::string_view> data;
+		myfile.NextRow(data);
+		size_t events = RunParallel<TradeRow>(myfile, threads, &BondTradeBookingConnector::ParseRow,
+			[this](TradeRow& row) { DeliverRow(row); });
+		batcher.Flush();
+
+		std::cout << "Trade ingest events: " << events << std::endl;
+		std::cout << "Risk data is outputed." << std::endl;
+		return events;
+	};
+
 	// override the virtual function, subscribe-only connector
 	void Publish(Trade<Bond>& data) {};
 
+	// events per OnMessageBatch call, 1 passes every event on as it is read
+	void SetBatchSize(size_t batchSize)
+	{
+		batcher.SetBatchSize(batchSize);
+	};
+
+	// pass on the events held for the current batch
+	void FlushBatch()
+	{
+		batcher.Flush();
+	};
+
 	BondTradeBookingService *GetService()
 	{
 		return bookingService;
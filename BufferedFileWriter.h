@@ -0,0 +1,311 @@
+#pragma once
+//
+//  BufferedFileWriter.h
+//  MTH 9815
+//
+
+#ifndef BufferedFileWriter_h
+#define BufferedFileWriter_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include "UringFile.h"
+
+using namespace std;
+
+// when a BufferedFileWriter hands its buffer to the operating system
+// FLUSH_PER_EVENT after every record, FLUSH_EVERY_N after every records records,
+// FLUSH_INTERVAL on the first record after intervalMicros have passed, FLUSH_ON_SHUTDOWN only when full or closed
+enum FlushPolicy { FLUSH_PER_EVENT, FLUSH_EVERY_N, FLUSH_INTERVAL, FLUSH_ON_SHUTDOWN };
+
+/**
+* Flush settings of a BufferedFileWriter.
+*/
+struct FlushConfig
+{
+	FlushPolicy policy = FLUSH_EVERY_N;
+	size_t records = 1024;           // records per flush for FLUSH_EVERY_N
+	long intervalMicros = 100000;    // time between flushes for FLUSH_INTERVAL
+	size_t bufferBytes = 1 << 20;    // the buffer is also written out whenever it fills up
+	FileIoBackend io = IO_DEFAULT;   // stdio writes or io_uring writes
+
+	FlushConfig() {};
+	FlushConfig(FlushPolicy _policy, FileIoBackend _io = IO_DEFAULT) : policy(_policy), io(_io) {};
+};
+
+/**
+* Long-lived append-only text file with a large in-process buffer.
+* Records are formatted into the buffer through Stream() and closed with EndRecord(), which applies the flush
+* policy. A flush is a single write of the whole buffer; std::endl or std::flush on the stream do not reach the
+* file, only the policy, Flush() and Close() do. The file is opened in append mode on the first flush and closed,
+* after a final flush, when the writer is destroyed.
+* With io IO_URING the records are formatted straight into the buffers of a UringFileWriter and a flush queues the
+* buffer without waiting for the write; Close() waits for all of them.
+*/
+class BufferedFileWriter : private std::streambuf
+{
+private:
+	typedef std::chrono::steady_clock clock;
+
+	std::string path;
+	FlushConfig config;
+	std::FILE* file = nullptr;
+#ifndef _WIN32
+	std::unique_ptr<UringFileWriter> uring;
+#endif
+	std::vector<char> buffer;
+	std::ostream stream;
+	size_t pending = 0;              // records since the last flush
+	bool batching = false;           // between BeginBatch and EndBatch
+	clock::time_point lastFlush;
+	size_t flushes = 0;
+	size_t bytesWritten = 0;
+	size_t syscalls = 0;
+	size_t droppedBytes = 0;         // bytes that could not be written, the file could not be opened or was full
+	bool openFailed = false;         // the last attempt to open the file failed, reported once
+	size_t fileBytes = 0;            // where the file ends, the writes queued on io_uring included
+#ifndef _WIN32
+	size_t uringSyscalls = 0;        // counts of the current UringFileWriter already added to the ones above
+	size_t uringWritten = 0;
+	size_t uringDropped = 0;
+#endif
+
+	// report that the file cannot be opened, once until it opens again
+	void ReportOpenFailure()
+	{
+		if (!openFailed) std::cout << "Cannot open " << path << " for writing" << std::endl;
+		openFailed = true;
+	};
+
+	// flush if the policy says so
+	void ApplyPolicy()
+	{
+		switch (config.policy)
+		{
+		case FLUSH_PER_EVENT: Flush(); break;
+		case FLUSH_EVERY_N: if (pending >= config.records) Flush(); break;
+		case FLUSH_INTERVAL:
+			if (clock::now() - lastFlush >= std::chrono::microseconds(config.intervalMicros)) Flush();
+			break;
+		default: break;
+		}
+	};
+
+	// hand the buffered bytes to the operating system
+	void WriteBuffer()
+	{
+		size_t size = pptr() - pbase();
+		if (size == 0) return;
+#ifndef _WIN32
+		if (config.io == IO_URING)
+		{
+			// the first flush after opening copies out of the plain buffer, later ones hand over the ring's own buffer
+			if (!uring)
+			{
+				uring.reset(new UringFileWriter(path, buffer.size()));
+				uringSyscalls = uringWritten = uringDropped = 0;
+			}
+			if (!uring->IsOpen())
+			{
+				// the buffer is dropped and the file tried again on the next flush
+				ReportOpenFailure();
+				droppedBytes += size;
+				uring.reset();
+				setp(buffer.data(), buffer.data() + buffer.size());
+				return;
+			}
+			openFailed = false;
+			if (pbase() != uring->Buffer()) std::memcpy(uring->Buffer(), pbase(), size);
+			uring->Write(size);
+			AccountUring();
+			++flushes;
+			setp(uring->Buffer(), uring->Buffer() + uring->BufferBytes());
+			return;
+		}
+#endif
+		if (!file)
+		{
+			file = std::fopen(path.c_str(), "ab");
+			// the buffer here is the only one, the FILE writes straight through
+			if (file) std::setvbuf(file, nullptr, _IONBF, 0);
+		}
+		if (file)
+		{
+			// only what reached the file counts, so GetOffset stays at the real end of the file
+			size_t written = std::fwrite(pbase(), 1, size, file);
+			++syscalls;
+			++flushes;
+			bytesWritten += written;
+			fileBytes += written;
+			droppedBytes += size - written;
+			openFailed = false;
+		}
+		else
+		{
+			ReportOpenFailure();
+			droppedBytes += size;
+		}
+		setp(buffer.data(), buffer.data() + buffer.size());
+	};
+
+#ifndef _WIN32
+	// add what the ring writer did since the last call: the writes completed or dropped, and its system calls
+	void AccountUring()
+	{
+		syscalls += uring->GetSyscalls() - uringSyscalls;
+		bytesWritten += uring->GetBytesWritten() - uringWritten;
+		droppedBytes += uring->GetDroppedBytes() - uringDropped;
+		uringSyscalls = uring->GetSyscalls();
+		uringWritten = uring->GetBytesWritten();
+		uringDropped = uring->GetDroppedBytes();
+		fileBytes = size_t(uring->GetOffset());
+	};
+
+	// wait for the queued writes and go back to the plain buffer
+	void CloseUring()
+	{
+		if (!uring) return;
+		uring->Drain();
+		AccountUring();
+		uring.reset();
+		setp(buffer.data(), buffer.data() + buffer.size());
+	};
+#endif
+
+protected:
+	// buffer full: write it out and keep going
+	int_type overflow(int_type ch) override
+	{
+		WriteBuffer();
+		if (!traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+		return traits_type::not_eof(ch);
+	};
+
+	// std::flush and std::endl end up here, flushing is left to the policy
+	int sync() override
+	{
+		return 0;
+	};
+
+public:
+	explicit BufferedFileWriter(const std::string& _path, const FlushConfig& _config = FlushConfig()) :
+		path(_path), config(_config), buffer(std::max<size_t>(1, _config.bufferBytes)), stream(this), lastFlush(clock::now())
+	{
+		setp(buffer.data(), buffer.data() + buffer.size());
+		std::error_code ec;
+		uintmax_t size = std::filesystem::file_size(path, ec);
+		if (!ec) fileBytes = size_t(size);
+	};
+
+	~BufferedFileWriter()
+	{
+		Close();
+	};
+
+	BufferedFileWriter(const BufferedFileWriter&) = delete;
+	BufferedFileWriter& operator=(const BufferedFileWriter&) = delete;
+
+	// stream to format the current record into
+	std::ostream& Stream()
+	{
+		return stream;
+	};
+
+	// mark the end of a record and flush if the policy says so
+	void EndRecord()
+	{
+		++pending;
+		if (!batching) ApplyPolicy();
+	};
+
+	// the records up to EndBatch are written as one: the flush policy is applied once, at EndBatch
+	void BeginBatch()
+	{
+		batching = true;
+	};
+
+	void EndBatch()
+	{
+		batching = false;
+		if (pending > 0) ApplyPolicy();
+	};
+
+	// write out everything buffered so far
+	void Flush()
+	{
+		WriteBuffer();
+		pending = 0;
+		lastFlush = clock::now();
+	};
+
+	// flush and close the file, a later record opens it again
+	void Close()
+	{
+		Flush();
+		if (file) std::fclose(file);
+		file = nullptr;
+#ifndef _WIN32
+		CloseUring();
+#endif
+	};
+
+	// change the flush settings, flushing what is buffered under the old ones
+	void SetConfig(const FlushConfig& _config)
+	{
+		Flush();
+#ifndef _WIN32
+		CloseUring();
+#endif
+		config = _config;
+		buffer.assign(std::max<size_t>(1, config.bufferBytes), 0);
+		setp(buffer.data(), buffer.data() + buffer.size());
+	};
+
+	const FlushConfig& GetConfig() const
+	{
+		return config;
+	};
+
+	// number of writes to the file so far
+	size_t GetFlushes() const
+	{
+		return flushes;
+	};
+
+	// bytes written to the file so far, io_uring writes count once they have completed
+	size_t GetBytesWritten() const
+	{
+		return bytesWritten;
+	};
+
+	// bytes given up on because the file could not be opened or written
+	size_t GetDroppedBytes() const
+	{
+		return droppedBytes;
+	};
+
+	// offset in the file the next byte formatted into Stream() will land at
+	size_t GetOffset() const
+	{
+		return fileBytes + size_t(pptr() - pbase());
+	};
+
+	// system calls made for writing so far, io_uring_enter calls included
+	size_t GetSyscalls() const
+	{
+		return syscalls;
+	};
+};
+
+#endif /* BufferedFileWriter_h */
@@ -0,0 +1,125 @@
+#pragma once
+//
+//  Conflation.h
+//  MTH 9815
+//
+
+#ifndef Conflation_h
+#define Conflation_h
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include "HistoricalLog.h"
+#include "FlatHashMap.h"
+
+using namespace std;
+
+/**
+* Whether the historical services drop records that repeat the last one persisted for their CUSIP.
+*/
+struct ConflationConfig
+{
+	bool enabled = false;
+	int64_t maxStalenessMicros = 1000000;   // an unchanged record is still persisted once this long after the last one, 0 never
+
+	ConflationConfig() {};
+	ConflationConfig(bool _enabled, int64_t _maxStalenessMicros) : enabled(_enabled), maxStalenessMicros(_maxStalenessMicros) {};
+};
+
+/**
+* Persist-time conflation of compact records of type R, keyed on CUSIP.
+* A record is unchanged when everything after its header (sequence and timestamp) is byte for byte the last one
+* admitted for its CUSIP; the records are built zero-initialized, so padding compares equal. Unchanged records are
+* suppressed until maxStalenessMicros have passed since the last admitted one, then one goes through as a heartbeat.
+* Staleness is checked as records arrive: a CUSIP that stops updating is not written again.
+*/
+template<typename R>
+class RecordConflator
+{
+private:
+	struct Last
+	{
+		R record;
+		int64_t written;
+	};
+
+	static const size_t HEADER = sizeof(HistoricalRecordHeader);
+
+	ConflationConfig config;
+	FlatHashMap<std::string, Last> last;
+	uint64_t admitted = 0;
+	uint64_t suppressed = 0;
+	uint64_t heartbeats = 0;
+
+public:
+	explicit RecordConflator(const ConflationConfig& _config = ConflationConfig()) : config(_config) {};
+
+	// true if record is to be persisted, false if it repeats the last one of its CUSIP
+	bool Admit(const R& record)
+	{
+		if (!config.enabled)
+		{
+			++admitted;
+			return true;
+		}
+		std::string_view cusip = LogField(record.cusip);
+		Last* found = last.Find(cusip);
+		if (!found)
+		{
+			last.Insert(std::string(cusip), Last{ record, record.header.timestamp });
+			++admitted;
+			return true;
+		}
+		Last& previous = *found;
+		const char* now = reinterpret_cast<const char*>(&record);
+		const char* then = reinterpret_cast<const char*>(&previous.record);
+		if (std::memcmp(now + HEADER, then + HEADER, sizeof(R) - HEADER) == 0)
+		{
+			if (config.maxStalenessMicros <= 0 || record.header.timestamp - previous.written < config.maxStalenessMicros)
+			{
+				++suppressed;
+				return false;
+			}
+			++heartbeats;
+		}
+		previous.record = record;
+		previous.written = record.header.timestamp;
+		++admitted;
+		return true;
+	};
+
+	// records let through, heartbeats included
+	uint64_t GetAdmitted() const
+	{
+		return admitted;
+	};
+
+	// records dropped as unchanged
+	uint64_t GetSuppressed() const
+	{
+		return suppressed;
+	};
+
+	// unchanged records let through because the last one was stale
+	uint64_t GetHeartbeats() const
+	{
+		return heartbeats;
+	};
+
+	// change the settings, forgetting the last records
+	void SetConfig(const ConflationConfig& _config)
+	{
+		config = _config;
+		last.Clear();
+	};
+
+	const ConflationConfig& GetConfig() const
+	{
+		return config;
+	};
+};
+
+#endif /* Conflation_h */
@@ -0,0 +1,406 @@
+#pragma once
+//
+//  DeltaLog.h
+//  MTH 9815
+//
+
+#ifndef DeltaLog_h
+#define DeltaLog_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <string_view>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include "HistoricalLog.h"
+#include "FlatHashMap.h"
+
+using namespace std;
+
+/**
+* Compressed historical logs. Same header as a binary log with magic BHLD, then one variable-length entry per record:
+*   varint  slot of the CUSIP, numbered in order of first appearance; a new slot is followed by the 12 CUSIP bytes
+*   varint  zigzag of sequence - (previous sequence + 1)
+*   varint  zigzag of timestamp - previous timestamp
+*   bytes   one bit per 8-byte word of the record after its header, set if the word changed since the previous
+*           record of the same CUSIP
+*   varint  zigzag of the difference of each changed word, in word order
+* Repeated prices and quantities cost one bit, a one-tick move one byte, so a streaming record usually takes 5-7 bytes
+* instead of 80. The format is lossless for every record kind, strings and doubles included.
+*/
+
+const char DELTA_LOG_MAGIC[4] = { 'B', 'H', 'L', 'D' };
+const uint16_t DELTA_LOG_VERSION = 1;
+
+// append v as a little-endian base-128 varint
+inline unsigned char* PutVarint(unsigned char* out, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		*out++ = uint8_t(v) | 0x80;
+		v >>= 7;
+	}
+	*out++ = uint8_t(v);
+	return out;
+}
+
+// read a varint, nullptr if it runs past end or is too long
+inline const unsigned char* GetVarint(const unsigned char* in, const unsigned char* end, uint64_t& v)
+{
+	// most values of a delta log fit in one byte
+	if (in < end && *in < 0x80)
+	{
+		v = *in;
+		return in + 1;
+	}
+	uint64_t result = 0;
+	for (unsigned shift = 0; in < end && shift < 64; shift += 7)
+	{
+		uint8_t byte = *in++;
+		result |= uint64_t(byte & 0x7f) << shift;
+		if (byte < 0x80)
+		{
+			v = result;
+			return in;
+		}
+	}
+	return nullptr;
+}
+
+// map signed values to unsigned so small negative differences stay small
+inline uint64_t ZigZag(int64_t v)
+{
+	return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+inline int64_t UnZigZag(uint64_t v)
+{
+	return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+/**
+* Per-CUSIP delta coder for records of type R. Encoder and decoder each keep the last record of every CUSIP,
+* so a stream has to be decoded from its start with a fresh codec.
+*/
+template<typename R>
+class DeltaRecordCodec
+{
+public:
+	static const size_t WORDS = (sizeof(R) - sizeof(HistoricalRecordHeader)) / 8;
+	static const size_t MASK_BYTES = (WORDS + 7) / 8;
+	// largest entry of one record
+	static const size_t MAX_BYTES = 10 + 12 + 10 + 10 + MASK_BYTES + 10 * WORDS;
+
+private:
+	static_assert(sizeof(R) % 8 == 0, "records are coded as 8-byte words");
+	static_assert(offsetof(R, cusip) == sizeof(HistoricalRecordHeader), "the cusip follows the record header");
+
+	typedef std::array<uint64_t, WORDS> Words;
+
+	std::vector<Words> last;                           // last record of each slot
+	FlatHashMap<std::string, uint32_t> slots;         // slot of each CUSIP
+	uint64_t nextSequence = 0;
+	int64_t lastTimestamp = 0;
+
+	static Words NewSlot(const char* cusip)
+	{
+		Words words;
+		words.fill(0);
+		std::memcpy(words.data(), cusip, 12);
+		return words;
+	};
+
+public:
+	// write the entry of record to out, which has room for MAX_BYTES, returns its length
+	size_t Encode(const R& record, unsigned char* out)
+	{
+		unsigned char* p = out;
+		std::string_view key(record.cusip, sizeof(record.cusip));
+		const uint32_t* found = slots.Find(key);
+		uint32_t slot;
+		if (!found)
+		{
+			slot = uint32_t(last.size());
+			slots.Insert(std::string(key), slot);
+			last.push_back(NewSlot(record.cusip));
+			p = PutVarint(p, slot);
+			std::memcpy(p, record.cusip, 12);
+			p += 12;
+		}
+		else
+		{
+			slot = *found;
+			p = PutVarint(p, slot);
+		}
+
+		p = PutVarint(p, ZigZag(int64_t(record.header.sequence - nextSequence)));
+		p = PutVarint(p, ZigZag(int64_t(uint64_t(record.header.timestamp) - uint64_t(lastTimestamp))));
+		nextSequence = record.header.sequence + 1;
+		lastTimestamp = record.header.timestamp;
+
+		Words words;
+		std::memcpy(words.data(), reinterpret_cast<const char*>(&record) + sizeof(HistoricalRecordHeader), sizeof(words));
+		Words& previous = last[slot];
+		unsigned char* mask = p;
+		std::memset(mask, 0, MASK_BYTES);
+		p += MASK_BYTES;
+		for (size_t i = 0; i < WORDS; ++i)
+		{
+			if (words[i] == previous[i]) continue;
+			mask[i >> 3] |= uint8_t(1u << (i & 7));
+			p = PutVarint(p, ZigZag(int64_t(words[i] - previous[i])));
+			previous[i] = words[i];
+		}
+		return size_t(p - out);
+	};
+
+	// decode the entry at in into record, returns the next entry or nullptr if the entry is incomplete or corrupt,
+	// in which case the codec is left as it was
+	const unsigned char* Decode(const unsigned char* in, const unsigned char* end, R& record)
+	{
+		uint64_t slot, sequence, timestamp;
+		if (!(in = GetVarint(in, end, slot)) || slot > last.size()) return nullptr;
+		const char* cusip = nullptr;
+		if (slot == last.size())
+		{
+			if (end - in < 12) return nullptr;
+			cusip = reinterpret_cast<const char*>(in);
+			in += 12;
+		}
+		if (!(in = GetVarint(in, end, sequence)) || !(in = GetVarint(in, end, timestamp))) return nullptr;
+		if (size_t(end - in) < MASK_BYTES) return nullptr;
+		const unsigned char* mask = in;
+		in += MASK_BYTES;
+
+		// visit the changed words only
+		Words words = cusip ? NewSlot(cusip) : last[slot];
+		for (size_t byte = 0; byte < MASK_BYTES; ++byte)
+		{
+			size_t i = byte * 8;
+			for (unsigned bits = mask[byte]; bits != 0; bits >>= 1, ++i)
+			{
+				if (!(bits & 1)) continue;
+				uint64_t delta;
+				if (i >= WORDS || !(in = GetVarint(in, end, delta))) return nullptr;
+				words[i] += uint64_t(UnZigZag(delta));
+			}
+		}
+
+		// the entry is complete, commit it; the slot is registered too so an encoder can continue the stream
+		if (cusip)
+		{
+			slots.Insert(std::string(cusip, 12), uint32_t(last.size()));
+			last.push_back(words);
+		}
+		else last[slot] = words;
+		record.header.sequence = nextSequence + uint64_t(UnZigZag(sequence));
+		record.header.timestamp = int64_t(uint64_t(lastTimestamp) + uint64_t(UnZigZag(timestamp)));
+		nextSequence = record.header.sequence + 1;
+		lastTimestamp = record.header.timestamp;
+		std::memcpy(reinterpret_cast<char*>(&record) + sizeof(HistoricalRecordHeader), words.data(), sizeof(words));
+		return in;
+	};
+
+	// CUSIPs seen so far
+	size_t SlotCount() const
+	{
+		return last.size();
+	};
+};
+
+/**
+* Read-only view of a compressed historical log, memory mapped. Records are decoded front to back.
+*/
+class DeltaLogReader
+{
+private:
+	MappedFile file;
+	HistoricalLogHeader header;
+	bool valid = false;
+
+public:
+	explicit DeltaLogReader(const std::string& path) : file(path)
+	{
+		if (!file.IsOpen() || file.Size() < sizeof(HistoricalLogHeader)) return;
+		std::memcpy(&header, file.Data(), sizeof(header));
+		valid = std::memcmp(header.magic, DELTA_LOG_MAGIC, 4) == 0 && header.version == DELTA_LOG_VERSION && header.recordSize > 0;
+	};
+
+	// the file exists and starts with a compressed log header
+	bool IsValid() const
+	{
+		return valid;
+	};
+
+	const HistoricalLogHeader& GetHeader() const
+	{
+		return header;
+	};
+
+	HistoricalKind GetKind() const
+	{
+		return HistoricalKind(header.kind);
+	};
+
+	// size of the file
+	size_t Bytes() const
+	{
+		return file.Size();
+	};
+
+	// call f(record) for every complete record of type R, returns the number of records visited
+	template<typename R, typename F>
+	size_t ForEach(F f) const
+	{
+		if (!valid || header.kind != R::KIND || header.recordSize != sizeof(R)) return 0;
+		DeltaRecordCodec<R> codec;
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(file.Data()) + sizeof(HistoricalLogHeader);
+		const unsigned char* end = reinterpret_cast<const unsigned char*>(file.Data()) + file.Size();
+		R record;
+		size_t count = 0;
+		while (in < end && (in = codec.Decode(in, end, record)))
+		{
+			f(record);
+			++count;
+		}
+		return count;
+	};
+
+	// complete records in the file, decodes all of them
+	size_t Count() const
+	{
+		switch (GetKind())
+		{
+		case RISK_RECORD: return ForEach<RiskLogRecord>([](const RiskLogRecord&) {});
+		case EXECUTION_RECORD: return ForEach<ExecutionLogRecord>([](const ExecutionLogRecord&) {});
+		case STREAMING_RECORD: return ForEach<StreamingLogRecord>([](const StreamingLogRecord&) {});
+		case INQUIRY_RECORD: return ForEach<InquiryLogRecord>([](const InquiryLogRecord&) {});
+		default: return 0;
+		}
+	};
+};
+
+/**
+* Historical log backend writing records of type R delta-compressed, buffered like HistoricalLogWriter.
+*/
+template<typename R>
+class DeltaLogWriter : public HistoricalLogBackend<R>
+{
+private:
+	std::string path;
+	FlushConfig config;
+	std::unique_ptr<BufferedFileWriter> writer;
+	DeltaRecordCodec<R> codec;
+	uint64_t sequence = 0;
+	size_t bytes = 0;
+
+	void Open()
+	{
+		// a valid log of this kind is continued: replay it to rebuild the codec and drop a partly written tail
+		bool valid = false;
+		size_t complete = 0;
+		{
+			MappedFile file(path);
+			HistoricalLogHeader header;
+			if (file.IsOpen() && file.Size() >= sizeof(header))
+			{
+				std::memcpy(&header, file.Data(), sizeof(header));
+				valid = std::memcmp(header.magic, DELTA_LOG_MAGIC, 4) == 0 && header.version == DELTA_LOG_VERSION
+					&& header.kind == R::KIND && header.recordSize == sizeof(R);
+			}
+			if (valid)
+			{
+				const unsigned char* begin = reinterpret_cast<const unsigned char*>(file.Data());
+				const unsigned char* in = begin + sizeof(HistoricalLogHeader);
+				const unsigned char* end = begin + file.Size();
+				R record;
+				while (in < end)
+				{
+					const unsigned char* next = codec.Decode(in, end, record);
+					if (!next) break;
+					in = next;
+					sequence = record.header.sequence + 1;
+				}
+				complete = size_t(in - begin);
+				bytes = complete;
+			}
+		}
+		std::error_code ec;
+		if (!valid) std::remove(path.c_str());
+		else if (std::filesystem::file_size(path, ec) != complete) std::filesystem::resize_file(path, complete, ec);
+
+		writer.reset(new BufferedFileWriter(path, config));
+		if (!valid)
+		{
+			HistoricalLogHeader header = {};
+			std::memcpy(header.magic, DELTA_LOG_MAGIC, 4);
+			header.version = DELTA_LOG_VERSION;
+			header.kind = R::KIND;
+			header.recordSize = sizeof(R);
+			header.createdMicros = LogClockMicros();
+			writer->Stream().write(reinterpret_cast<const char*>(&header), sizeof(header));
+			bytes = sizeof(header);
+			sequence = 0;
+		}
+	};
+
+public:
+	explicit DeltaLogWriter(const std::string& _path, const FlushConfig& _config = FlushConfig()) :
+		path(_path), config(_config)
+	{
+	};
+
+	// append a record, its sequence number is assigned here
+	void Append(R record) override
+	{
+		if (!writer) Open();
+		record.header.sequence = sequence++;
+		unsigned char entry[DeltaRecordCodec<R>::MAX_BYTES];
+		size_t size = codec.Encode(record, entry);
+		writer->Stream().write(reinterpret_cast<const char*>(entry), size);
+		writer->EndRecord();
+		bytes += size;
+	};
+
+	// append count records, flushed as the policy says for all of them at once
+	void AppendBatch(const R* records, size_t count) override
+	{
+		if (!writer) Open();
+		writer->BeginBatch();
+		for (size_t i = 0; i < count; ++i) Append(records[i]);
+		writer->EndBatch();
+	};
+
+	// write out all buffered records
+	void Flush() override
+	{
+		if (writer) writer->Flush();
+	};
+
+	// change when the file is flushed
+	void SetConfig(const FlushConfig& _config) override
+	{
+		config = _config;
+		if (writer) writer->SetConfig(config);
+	};
+
+	// sequence number of the next record
+	uint64_t NextSequence() const
+	{
+		return sequence;
+	};
+
+	// size of the log including what is still buffered
+	size_t Bytes() const
+	{
+		return bytes;
+	};
+};
+
+#endif /* DeltaLog_h */
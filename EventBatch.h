@@ -0,0 +1,120 @@
+#pragma once
+//
+//  EventBatch.h
+//  MTH 9815
+//
+
+#ifndef EventBatch_h
+#define EventBatch_h
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "soa.hpp"
+
+using namespace std;
+
+/**
+* Events a subscribing connector has built, handed to its service OnMessageBatch batchSize at a time.
+* With a batch size of 1 every event goes straight to OnMessage, as it did before batches. A larger one saves the
+* dispatch and listener iteration per event at the cost of holding the first events of a batch back until it is
+* full; Flush hands over what is held, and the connectors call it at the end of their input.
+*/
+template<typename V>
+class EventBatcher
+{
+private:
+	Service<std::string, V>* service;
+	size_t batchSize = 1;
+	std::vector<V> events;
+
+public:
+	explicit EventBatcher(Service<std::string, V>* _service) : service(_service) {};
+
+	// pass event to the service, or keep it for the next batch
+	void Add(V&& event)
+	{
+		if (batchSize <= 1)
+		{
+			service->OnMessage(event);
+			return;
+		}
+		events.push_back(std::move(event));
+		if (events.size() >= batchSize) Flush();
+	};
+
+	// hand the events kept so far to the service
+	void Flush()
+	{
+		if (events.empty()) return;
+		service->OnMessageBatch(events.data(), events.size());
+		events.clear();
+	};
+
+	// events per OnMessageBatch call, the events kept are handed over first
+	void SetBatchSize(size_t _batchSize)
+	{
+		Flush();
+		batchSize = _batchSize;
+		events.reserve(batchSize);
+	};
+
+	size_t GetBatchSize() const
+	{
+		return batchSize;
+	};
+};
+
+/**
+* ServiceListener that collects the adds of a service and passes them on to target through ProcessAddBatch,
+* batchSize at a time. Removes and updates pass the adds held first and then go through one by one. Flush hands over
+* the adds still held; call it once the thread feeding the listener is done, after any async hop in front of it stopped.
+*/
+template<typename V>
+class BatchingListener : public ServiceListener<V>
+{
+private:
+	ServiceListener<V>* target;
+	size_t batchSize;
+	std::vector<V> events;
+
+public:
+	BatchingListener(ServiceListener<V>* _target, size_t _batchSize) : target(_target), batchSize(_batchSize)
+	{
+		events.reserve(batchSize);
+	};
+
+	void ProcessAdd(V& data) override
+	{
+		events.push_back(data);
+		if (events.size() >= batchSize) Flush();
+	};
+
+	void ProcessAddBatch(V* data, size_t count) override
+	{
+		events.insert(events.end(), data, data + count);
+		if (events.size() >= batchSize) Flush();
+	};
+
+	void ProcessRemove(V& data) override
+	{
+		Flush();
+		target->ProcessRemove(data);
+	};
+
+	void ProcessUpdate(V& data) override
+	{
+		Flush();
+		target->ProcessUpdate(data);
+	};
+
+	// pass the adds held so far to target
+	void Flush()
+	{
+		if (events.empty()) return;
+		target->ProcessAddBatch(events.data(), events.size());
+		events.clear();
+	};
+};
+
+#endif /* EventBatch_h */
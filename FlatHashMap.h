@@ -0,0 +1,323 @@
+#pragma once
+//
+//  FlatHashMap.h
+//  MTH 9815
+//
+
+#ifndef FlatHashMap_h
+#define FlatHashMap_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2 1
+#endif
+
+using namespace std;
+
+// hash for FlatHashMap keys, strings hash as string_view so either can be looked up
+template<typename K>
+struct FlatHash : std::hash<K>
+{
+};
+
+template<>
+struct FlatHash<std::string>
+{
+	size_t operator()(std::string_view key) const
+	{
+		return std::hash<std::string_view>()(key);
+	};
+};
+
+/**
+* Open-addressing hash map for service state, keyed on K with values V.
+* The table is a flat array of one control byte and one key per slot. The control byte holds 7 bits of the hash
+* of a used slot, and a lookup compares a group of 16 control bytes against them in one SSE2 instruction (a plain
+* loop without SSE2), probing whole groups until one has an empty slot. The values live apart from the table in a
+* deque that never moves them, so references returned by operator[], Find and At stay valid across inserts and
+* rehashes until the key is erased, as GetData returning V& needs. Not synchronized.
+*/
+template<typename K, typename V, typename Hash = FlatHash<K>, typename Equal = std::equal_to<>>
+class FlatHashMap
+{
+private:
+	static constexpr size_t GROUP = 16;
+	static constexpr int8_t EMPTY = -128;
+	static constexpr int8_t DELETED = -2;
+
+	// control bytes, the first GROUP - 1 repeated at the end so a group can be loaded at any slot
+	std::vector<int8_t> control;
+	std::vector<K> keys;
+	std::vector<uint32_t> slotValues;    // index in values of the value of each used slot
+	std::deque<std::optional<V>> values;
+	std::vector<uint32_t> freeValues;
+	size_t capacity = 0;                 // slots, a power of two
+	size_t size = 0;
+	size_t deleted = 0;
+	Hash hasher;
+	Equal equal;
+
+	// bit i set where control byte i of the group at position is byte
+	uint32_t Match(size_t position, int8_t byte) const
+	{
+#ifdef FLAT_HASH_MAP_SSE2
+		__m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control.data() + position));
+		return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte))));
+#else
+		uint32_t mask = 0;
+		for (size_t i = 0; i < GROUP; ++i) mask |= uint32_t(control[position + i] == byte) << i;
+		return mask;
+#endif
+	};
+
+	// bit i set where slot i of the group at position is empty or deleted
+	uint32_t MatchFree(size_t position) const
+	{
+#ifdef FLAT_HASH_MAP_SSE2
+		// both have the top bit set and used slots do not
+		__m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control.data() + position));
+		return uint32_t(_mm_movemask_epi8(group));
+#else
+		uint32_t mask = 0;
+		for (size_t i = 0; i < GROUP; ++i) mask |= uint32_t(control[position + i] < 0) << i;
+		return mask;
+#endif
+	};
+
+	static int LowestBit(uint32_t mask)
+	{
+		int bit = 0;
+		while (!(mask & 1))
+		{
+			mask >>= 1;
+			++bit;
+		}
+		return bit;
+	};
+
+	void SetControl(size_t slot, int8_t byte)
+	{
+		control[slot] = byte;
+		if (slot < GROUP - 1) control[capacity + slot] = byte;
+	};
+
+	// slot holding key, capacity if there is none
+	template<typename Q>
+	size_t FindSlot(const Q& key, size_t hash) const
+	{
+		if (capacity == 0) return capacity;
+		size_t mask = capacity - 1;
+		int8_t tag = int8_t(hash & 0x7F);
+		size_t position = (hash >> 7) & mask;
+		for (size_t step = GROUP; ; step += GROUP)
+		{
+			for (uint32_t match = Match(position, tag); match; match &= match - 1)
+			{
+				size_t slot = (position + LowestBit(match)) & mask;
+				if (equal(keys[slot], key)) return slot;
+			}
+			if (Match(position, EMPTY)) return capacity;
+			position = (position + step) & mask;
+		}
+	};
+
+	// first empty or deleted slot on the probe sequence of hash
+	size_t FreeSlot(size_t hash) const
+	{
+		size_t mask = capacity - 1;
+		size_t position = (hash >> 7) & mask;
+		for (size_t step = GROUP; ; step += GROUP)
+		{
+			uint32_t free = MatchFree(position);
+			if (free) return (position + LowestBit(free)) & mask;
+			position = (position + step) & mask;
+		}
+	};
+
+	// rebuild the table with room for newCapacity slots, the values stay where they are
+	void Rehash(size_t newCapacity)
+	{
+		std::vector<int8_t> oldControl(std::move(control));
+		std::vector<K> oldKeys(std::move(keys));
+		std::vector<uint32_t> oldValues(std::move(slotValues));
+		size_t oldCapacity = capacity;
+
+		capacity = newCapacity;
+		control.assign(capacity + GROUP - 1, EMPTY);
+		keys.assign(capacity, K());
+		slotValues.assign(capacity, 0);
+		deleted = 0;
+		for (size_t i = 0; i < oldCapacity; ++i)
+		{
+			if (oldControl[i] < 0) continue;
+			size_t hash = hasher(oldKeys[i]);
+			size_t slot = FreeSlot(hash);
+			SetControl(slot, int8_t(hash & 0x7F));
+			keys[slot] = std::move(oldKeys[i]);
+			slotValues[slot] = oldValues[i];
+		}
+	};
+
+	// make room for one more key, keeping the table at most 7/8 full
+	void Grow()
+	{
+		if (capacity == 0) Rehash(GROUP);
+		else if ((size + deleted + 1) * 8 > capacity * 7) Rehash(size * 2 + 2 > capacity ? capacity * 2 : capacity);
+	};
+
+	template<typename... Args>
+	uint32_t NewValue(Args&&... args)
+	{
+		uint32_t index;
+		if (!freeValues.empty())
+		{
+			index = freeValues.back();
+			freeValues.pop_back();
+		}
+		else
+		{
+			index = uint32_t(values.size());
+			values.emplace_back();
+		}
+		values[index].emplace(std::forward<Args>(args)...);
+		return index;
+	};
+
+public:
+	FlatHashMap() {};
+
+	// value of key, nullptr if there is none
+	template<typename Q>
+	V* Find(const Q& key)
+	{
+		size_t slot = FindSlot(key, hasher(key));
+		return slot == capacity ? nullptr : &*values[slotValues[slot]];
+	};
+
+	template<typename Q>
+	const V* Find(const Q& key) const
+	{
+		size_t slot = FindSlot(key, hasher(key));
+		return slot == capacity ? nullptr : &*values[slotValues[slot]];
+	};
+
+	// value of key, std::out_of_range if there is none, as std::map::at
+	template<typename Q>
+	V& At(const Q& key)
+	{
+		V* value = Find(key);
+		if (!value) throw std::out_of_range("FlatHashMap: no value for key");
+		return *value;
+	};
+
+	template<typename Q>
+	const V& At(const Q& key) const
+	{
+		const V* value = Find(key);
+		if (!value) throw std::out_of_range("FlatHashMap: no value for key");
+		return *value;
+	};
+
+	// value of key, constructed from args if key is new, and whether it was
+	template<typename... Args>
+	std::pair<V*, bool> TryEmplace(const K& key, Args&&... args)
+	{
+		size_t hash = hasher(key);
+		size_t slot = FindSlot(key, hash);
+		if (slot != capacity) return std::make_pair(&*values[slotValues[slot]], false);
+		Grow();
+		slot = FreeSlot(hash);
+		if (control[slot] == DELETED) --deleted;
+		SetControl(slot, int8_t(hash & 0x7F));
+		keys[slot] = key;
+		slotValues[slot] = NewValue(std::forward<Args>(args)...);
+		++size;
+		return std::make_pair(&*values[slotValues[slot]], true);
+	};
+
+	// store value unless key already has one, as std::map::insert, true if stored
+	bool Insert(const K& key, const V& value)
+	{
+		return TryEmplace(key, value).second;
+	};
+
+	// value of key, default constructed if it has none, as std::map::operator[]
+	V& operator[](const K& key)
+	{
+		return *TryEmplace(key).first;
+	};
+
+	// remove key and its value, false if it had none
+	template<typename Q>
+	bool Erase(const Q& key)
+	{
+		size_t slot = FindSlot(key, hasher(key));
+		if (slot == capacity) return false;
+		values[slotValues[slot]].reset();
+		freeValues.push_back(slotValues[slot]);
+		keys[slot] = K();
+		SetControl(slot, DELETED);
+		++deleted;
+		--size;
+		return true;
+	};
+
+	// room for count keys without a rehash
+	void Reserve(size_t count)
+	{
+		size_t wanted = GROUP;
+		while (wanted * 7 < count * 8) wanted *= 2;
+		if (wanted > capacity) Rehash(wanted);
+	};
+
+	size_t Size() const
+	{
+		return size;
+	};
+
+	bool Empty() const
+	{
+		return size == 0;
+	};
+
+	// call f(key, value) for every key, in no particular order
+	template<typename F>
+	void ForEach(F f)
+	{
+		for (size_t i = 0; i < capacity; ++i)
+		{
+			if (control[i] >= 0) f(static_cast<const K&>(keys[i]), *values[slotValues[i]]);
+		}
+	};
+
+	template<typename F>
+	void ForEach(F f) const
+	{
+		for (size_t i = 0; i < capacity; ++i)
+		{
+			if (control[i] >= 0) f(keys[i], *values[slotValues[i]]);
+		}
+	};
+
+	void Clear()
+	{
+		control.clear();
+		keys.clear();
+		slotValues.clear();
+		values.clear();
+		freeValues.clear();
+		capacity = size = deleted = 0;
+	};
+};
+
+#endif /* FlatHashMap_h */
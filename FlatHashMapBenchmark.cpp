@@ -0,0 +1,128 @@
+//
+//  FlatHashMapBenchmark.cpp
+//  MTH 9815
+//
+//  Checks FlatHashMap against std::unordered_map over random inserts, erases and lookups, including that the
+//  values do not move, then times inserts and lookups against std::map and std::unordered_map at 6, 10k and 1M
+//  keys, with CUSIP strings and with SecurityId keys.
+//  usage: FlatHashMapBenchmark
+//    returns 1 if the check fails
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include "FlatHashMap.h"
+#include "SecurityId.h"
+
+// random operations on both maps, false if they disagree or a value moved
+static bool Check()
+{
+	std::mt19937 rng(9);
+	FlatHashMap<std::string, long> flat;
+	std::unordered_map<std::string, long> reference;
+	std::unordered_map<std::string, long*> addresses;
+	size_t bad = 0;
+	for (long i = 0; i < 2000000; ++i)
+	{
+		std::string key = "K" + std::to_string(rng() % 50000);
+		unsigned op = rng() % 10;
+		if (op < 5)
+		{
+			flat[key] += i;
+			reference[key] += i;
+			if (!addresses.count(key)) addresses[key] = flat.Find(key);
+		}
+		else if (op < 7)
+		{
+			if (flat.Erase(key) != (reference.erase(key) == 1)) ++bad;
+			addresses.erase(key);
+		}
+		else
+		{
+			long* value = flat.Find(std::string_view(key));
+			auto it = reference.find(key);
+			if ((value == nullptr) != (it == reference.end()) || (value && *value != it->second)) ++bad;
+		}
+	}
+	for (auto& address : addresses)
+	{
+		if (flat.Find(address.first) != address.second) ++bad;
+	}
+	size_t visited = 0;
+	flat.ForEach([&](const std::string& key, long value) { ++visited; if (reference.at(key) != value) ++bad; });
+	if (visited != reference.size() || flat.Size() != reference.size()) ++bad;
+	std::cout << "2M random operations against std::unordered_map: " << bad << " mismatches" << std::endl;
+	return bad == 0;
+}
+
+struct Timing
+{
+	double insert;
+	double lookup;
+};
+
+static double Nanoseconds(std::chrono::steady_clock::time_point start, size_t count)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+static long checksum = 0;
+
+// ns per insert of every key and per lookup of the queried ones
+template<typename Map, typename Key, typename Find>
+static Timing Time(const std::vector<Key>& keys, const std::vector<size_t>& queries, Find find)
+{
+	Map map;
+	Timing timing;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < keys.size(); ++i) map[keys[i]] = long(i);
+	timing.insert = Nanoseconds(start, keys.size());
+	start = std::chrono::steady_clock::now();
+	for (size_t query : queries) checksum += find(map, keys[query]);
+	timing.lookup = Nanoseconds(start, queries.size());
+	return timing;
+}
+
+static void Print(const char* name, Timing timing)
+{
+	std::cout << "  " << name << timing.insert << " ns insert, " << timing.lookup << " ns lookup" << std::endl;
+}
+
+int main()
+{
+	if (!Check()) return 1;
+
+	auto findFlat = [](auto& map, auto& key) { return *map.Find(key); };
+	auto findStd = [](auto& map, auto& key) { return map.find(key)->second; };
+	const char* alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	std::mt19937 rng(5);
+	for (size_t count : { size_t(6), size_t(10000), size_t(1000000) })
+	{
+		std::vector<std::string> cusips;
+		std::vector<SecurityId> ids;
+		while (cusips.size() < count)
+		{
+			std::string cusip(9, '0');
+			for (auto& c : cusip) c = alphabet[rng() % 36];
+			cusips.push_back(cusip);
+			ids.push_back(SecurityId::Parse(cusip));
+		}
+		std::vector<size_t> queries(1 << 22);
+		for (auto& query : queries) query = rng() % count;
+
+		std::cout << count << " keys, " << queries.size() << " random lookups" << std::endl;
+		Print("std::map<string>               ", Time<std::map<std::string, long>>(cusips, queries, findStd));
+		Print("std::unordered_map<string>     ", Time<std::unordered_map<std::string, long>>(cusips, queries, findStd));
+		Print("FlatHashMap<string>            ", Time<FlatHashMap<std::string, long>>(cusips, queries, findFlat));
+		Print("std::map<SecurityId>           ", Time<std::map<SecurityId, long>>(ids, queries, findStd));
+		Print("std::unordered_map<SecurityId> ", Time<std::unordered_map<SecurityId, long>>(ids, queries, findStd));
+		Print("FlatHashMap<SecurityId>        ", Time<FlatHashMap<SecurityId, long>>(ids, queries, findFlat));
+	}
+	std::cout << "(checksum " << checksum % 7 << ")" << std::endl;
+	return 0;
+}
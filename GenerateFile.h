@@ -0,0 +1,224 @@
+//
+//  GenerateFile.h
+//  MTH 9815
+//
+
+#ifndef GenerateFile_h
+#define GenerateFile_h
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include "TickPrice.h"
+
+using namespace std;
+
+/**
+* Settings shared by the input file generators.
+* Rows cycle through the CUSIP universe and end with a timestamp column in microseconds since the start of the
+* session; row i is stamped somewhere in [i * intervalMicros, (i + 1) * intervalMicros) so every file is in time
+* order. The file is produced in partitions of partitionRows rows, each with its own random stream derived from
+* seed, so the output only depends on rows, cusips, seed, partitionRows and intervalMicros and is identical
+* whatever the number of threads.
+*/
+struct GeneratorConfig
+{
+	size_t rows;                          // data rows to write, excluding the header
+	std::vector<std::string> cusips;      // CUSIP universe
+	uint64_t seed = 9815;                 // base seed of the random streams
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t partitionRows = 1 << 16;       // rows formatted per partition
+	long intervalMicros = 1000;           // average time between two rows
+
+	GeneratorConfig(size_t _rows, const std::vector<std::string>& _cusips) :
+		rows(_rows), cusips(_cusips)
+	{
+	};
+};
+
+/**
+* Small reproducible random generator (SplitMix64).
+* Unlike rand() and the std distributions it gives the same sequence on every platform.
+*/
+class GeneratorRng
+{
+private:
+	uint64_t state;
+
+public:
+	explicit GeneratorRng(uint64_t seed) : state(seed) {};
+
+	// random stream of a partition, decorrelated from its neighbours
+	static GeneratorRng ForPartition(uint64_t seed, uint64_t partition)
+	{
+		GeneratorRng mix(seed ^ (partition * 0xD1B54A32D192ED03ULL));
+		return GeneratorRng(mix.Next());
+	};
+
+	uint64_t Next()
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	};
+
+	// integer between 0 and n - 1
+	long Uniform(long n)
+	{
+		return long(Next() % uint64_t(n));
+	};
+};
+
+/**
+* Append-only cursor into a text buffer sized up front for the rows expected.
+* Every append checks the room left and grows the buffer when it is short, so a row longer than expected costs a
+* reallocation instead of writing past the end.
+*/
+class RowWriter
+{
+private:
+	std::vector<char>& buffer;
+	size_t length = 0;
+
+	// where to append up to n more bytes, growing the buffer if they do not fit
+	char* Reserve(size_t n)
+	{
+		if (length + n > buffer.size()) buffer.resize(std::max(2 * buffer.size(), length + n));
+		return buffer.data() + length;
+	};
+
+public:
+	explicit RowWriter(std::vector<char>& _buffer) : buffer(_buffer) {};
+
+	// bytes written so far, from the start of the buffer
+	size_t Length() const
+	{
+		return length;
+	};
+
+	RowWriter& Text(std::string_view str)
+	{
+		std::memcpy(Reserve(str.size()), str.data(), str.size());
+		length += str.size();
+		return *this;
+	};
+
+	RowWriter& Char(char c)
+	{
+		*Reserve(1) = c;
+		++length;
+		return *this;
+	};
+
+	RowWriter& Integer(long value)
+	{
+		char* p = Reserve(24);
+		length += std::to_chars(p, p + 24, value).ptr - p;
+		return *this;
+	};
+
+	// price in 1/256 ticks, in fractional notation
+	RowWriter& Ticks(long ticks)
+	{
+		length += FormatTicks(ticks, Reserve(MAX_TICK_PRICE_LENGTH));
+		return *this;
+	};
+};
+
+/**
+* Write header and config.rows rows to path.
+* formatRow(writer, rowIndex, cusip, rng) appends the fields of one row, maxRowBytes is what a row usually takes
+* and sizes the buffers up front, a longer row grows them; the timestamp column and the newline are added here. Partitions are formatted on config.threads threads while
+* the calling thread writes the finished buffers to the file in order. Returns the number of bytes written.
+*/
+template<typename FormatRow>
+size_t GeneratePartitioned(const std::string& path, const std::string& header, const GeneratorConfig& config, size_t maxRowBytes, FormatRow formatRow)
+{
+	ofstream out(path, ios_base::binary | ios_base::trunc);
+	out.write(header.data(), header.size());
+	size_t bytes = header.size();
+	if (config.rows == 0 || config.cusips.empty()) return bytes;
+
+	size_t partitionRows = std::max<size_t>(1, config.partitionRows);
+	size_t partitions = (config.rows + partitionRows - 1) / partitionRows;
+	size_t threads = std::max<size_t>(1, std::min(config.threads, partitions));
+	size_t window = 2 * threads;
+
+	// one buffer per slot of the window, partition p uses slot p % window
+	std::vector<std::vector<char>> buffers(window);
+	std::vector<size_t> lengths(partitions, 0);
+	std::vector<char> done(partitions, 0);
+	size_t nextPartition = 0;
+	size_t written = 0;
+	std::mutex mtx;
+	std::condition_variable partitionDone;
+	std::condition_variable partitionFreed;
+
+	auto worker = [&]()
+	{
+		while (true)
+		{
+			size_t p;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				partitionFreed.wait(lock, [&]() { return nextPartition >= partitions || nextPartition < written + window; });
+				if (nextPartition >= partitions) return;
+				p = nextPartition++;
+			}
+
+			size_t first = p * partitionRows;
+			size_t last = std::min(config.rows, first + partitionRows);
+			std::vector<char>& buffer = buffers[p % window];
+			buffer.resize((last - first) * (maxRowBytes + 24));
+			GeneratorRng rng = GeneratorRng::ForPartition(config.seed, p);
+			RowWriter writer(buffer);
+			for (size_t row = first; row < last; ++row)
+			{
+				long timestamp = long(row) * config.intervalMicros + rng.Uniform(std::max(1L, config.intervalMicros));
+				formatRow(writer, row, config.cusips[row % config.cusips.size()], rng);
+				writer.Char(',').Integer(timestamp).Char('\n');
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				lengths[p] = writer.Length();
+				done[p] = 1;
+			}
+			partitionDone.notify_all();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t t = 0; t < threads; ++t) pool.emplace_back(worker);
+
+	for (size_t p = 0; p < partitions; ++p)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			partitionDone.wait(lock, [&]() { return done[p] != 0; });
+		}
+		out.write(buffers[p % window].data(), lengths[p]);
+		bytes += lengths[p];
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			written = p + 1;
+		}
+		partitionFreed.notify_all();
+	}
+
+	for (auto& t : pool) t.join();
+	return bytes;
+}
+
+#endif /* GenerateFile_h */
@@ -9,50 +9,34 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <random>
 #include "GenerateTradeFile.h"
 
 using namespace std;
 
-void generate_inquiry()
+// create inquiries.txt file,
+// with attributes of product, side, quantity, price, state, and timestamp
+// 10 inquiries for each security by default
+void generate_inquiry(const GeneratorConfig& config = GeneratorConfig(60, default_cusips()))
 {
     cout << "Generating inquiry data." << endl;
     
-    ofstream inquiryFile;
-    inquiryFile.open("input/inquiries.txt");
-
     // add header of the inquiries data
-    inquiryFile << "product, side, quantity, price, state" << endl;
-    
-    // create inquiries of 6 securities
-    for (int i = 0; i < 6; i++)
+    std::string header = "product, side, quantity, price, state, timestamp\n";
+
+    auto formatRow = [](RowWriter& out, size_t, const std::string& cusip, GeneratorRng& rng)
     {
-        string cusip = cusips[i];
-        
-        // 10 inquiries for each security
-        for (int j = 0; j < 10; j++)
-        {
-            // set price default as 100
-            string price = "100";
-            
-            // quantity of the inquiry
-            int quantity = 100 * (rand() % 9 + 1);
-            
-            // side of the inquiry
-            string side;
-            if (rand() % 2 == 0) { side = "BUY"; }
-            else {side = "SELL"; }
-            
-            // set state default as received
-            string state = "RECEIVED";
-            
-            // output 
-            inquiryFile << cusip << "," << side << "," << quantity << "," << price << "," << state << std::endl;
-        }
-    }
-    
-    inquiryFile.close();
-    cout << "Generating inquiries.txt file is done." << endl;
+        // quantity of the inquiry
+        long quantity = 100 * (rng.Uniform(9) + 1);
+
+        // side of the inquiry
+        std::string_view side = rng.Uniform(2) == 0 ? "BUY" : "SELL";
+
+        // price defaults to 100 and state to received
+        out.Text(cusip).Char(',').Text(side).Char(',').Integer(quantity).Text(",100,RECEIVED");
+    };
+
+    size_t bytes = GeneratePartitioned("input/inquiries.txt", header, config, 64, formatRow);
+    cout << "Generating inquiries.txt file is done, " << config.rows << " rows, " << bytes << " bytes." << endl;
 }
 
 #endif /* GenerateInquiryFile_h */
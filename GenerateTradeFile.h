@@ -9,7 +9,10 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <random>
+#include <vector>
+#include <iterator>
+#include "products.hpp"
+#include "GenerateFile.h"
 
 using namespace std;
 
@@ -22,59 +25,56 @@ std::string cusips [] = {"9128283H1", // 2yr
                      "912810RZ3"}; // 30yr
 
 
+// the CUSIP universe above, as used by default by the generators
+inline std::vector<std::string> default_cusips()
+{
+    return std::vector<std::string>(std::begin(cusips), std::end(cusips));
+}
+
+// reference data of the CUSIP universe above
+inline std::vector<Bond> default_bonds()
+{
+    return std::vector<Bond>{
+        Bond(cusips[0], BondIdType::CUSIP, "T", 0.002100, date(2019,12,28)),
+        Bond(cusips[1], BondIdType::CUSIP, "T", 0.002600, date(2020,12,28)),
+        Bond(cusips[2], BondIdType::CUSIP, "T", 0.002900, date(2022,12,28)),
+        Bond(cusips[3], BondIdType::CUSIP, "T", 0.003500, date(2024,12,28)),
+        Bond(cusips[4], BondIdType::CUSIP, "T", 0.003800, date(2027,12,18)),
+        Bond(cusips[5], BondIdType::CUSIP, "T", 0.005000, date(2047,12,28))
+    };
+}
+
 // create trades.txt file,
-// with attributes of product, tradeId, book, quantity, and side
-void generate_trades ()
+// with attributes of product, tradeId, book, price, quantity, side, and timestamp
+// 10 trades for each security by default
+void generate_trades(const GeneratorConfig& config = GeneratorConfig(60, default_cusips()))
 {
     cout << "Generating trade data." << endl;
-    
-    ofstream tradesFile;
-    tradesFile.open("input/trades.txt");
-    
+
     // add header of the trades
-    tradesFile << "product, tradeId, book, price, quantity, side" << endl;
-    
-    // create trades of 6 securities
-    for (int i = 0; i < 6; i++)
+    std::string header = "product, tradeId, book, price, quantity, side, timestamp\n";
+
+    auto formatRow = [](RowWriter& out, size_t row, const std::string& cusip, GeneratorRng& rng)
     {
-        string cusip = cusips[i];
-        
-        // 10 trades for each security
-        for (int j = 0; j < 10; j++)
-        {
-            // tradeId
-            int tradeid = i * 100 + j * 30;
-            
-            // book
-            int book = rand() % 3 + 1;
-
-			// price
-			int num = rand() % (256 * 2 + 1);
-			int num1 = num / 256; 
-			int num2 = num % 256;
-			int num3 = num2 / 8; 
-			int num4 = num2 % 8;
-			string str1 = std::to_string(99 + num1) + "-";
-			string str2 = std::to_string(num3);
-			string str3 = std::to_string(num4);
-			if (num4 == 4)	str3 = "+";
-			if (num3 < 10) str2 = "0" + str2;
-            
-            // quantity, 1 million to 5 million
-            int quantity = 100000 * (rand() % 5 + 1);
-            
-            // side
-            string side;
-            if (rand() % 2 == 0) {side = "SELL";}
-            else {side = "BUY";}
-            
-            // output data
-            tradesFile << cusip << ",T" << tradeid << ",TRSY" << book << "," << str1 + str2 + str3 << "," << quantity << "," << side << endl;
-        }
-    }
-    
-    tradesFile.close();
-    cout << "Generating trades.txt file is done." << endl;
+        // book
+        long book = rng.Uniform(3) + 1;
+
+        // price between 99-000 and 101-000
+        long ticks = 99 * TICKS_PER_POINT + rng.Uniform(2 * TICKS_PER_POINT + 1);
+
+        // quantity, 1 million to 5 million
+        long quantity = 100000 * (rng.Uniform(5) + 1);
+
+        // side
+        std::string_view side = rng.Uniform(2) == 0 ? "SELL" : "BUY";
+
+        // output data, the tradeId is the row number
+        out.Text(cusip).Text(",T").Integer(long(row)).Text(",TRSY").Integer(book).Char(',')
+            .Ticks(ticks).Char(',').Integer(quantity).Char(',').Text(side);
+    };
+
+    size_t bytes = GeneratePartitioned("input/trades.txt", header, config, 128, formatRow);
+    cout << "Generating trades.txt file is done, " << config.rows << " rows, " << bytes << " bytes." << endl;
 }
 
 #endif /* GenerateTradeFile_h */
@@ -0,0 +1,530 @@
+#pragma once
+//
+//  HistoricalLog.h
+//  MTH 9815
+//
+
+#ifndef HistoricalLog_h
+#define HistoricalLog_h
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <chrono>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include "products.hpp"
+#include "TickPrice.h"
+#include "MappedFileReader.h"
+#include "BufferedFileWriter.h"
+#include "BondRiskService.h"
+#include "BondAlgoExecutionService.h"
+#include "BondAlgoStreamingService.h"
+#include "BondInquiryService.h"
+
+using namespace std;
+
+/**
+* Binary append-only logs of the historical data, one file per kind of record.
+* A file starts with a HistoricalLogHeader followed by fixed-size records of its kind. Every record starts with a
+* HistoricalRecordHeader holding a sequence number (0, 1, 2, ... within the file) and a timestamp in microseconds
+* since the epoch taken when the event was persisted. Prices are integer 1/256 ticks, identifiers are fixed-width
+* null-padded text. All fields are little-endian as written by the host.
+*/
+
+// what the historical connectors write
+// TEXT_LOG the legacy text files, BINARY_LOG the binary logs next to them (.bin), TEXT_AND_BINARY_LOG both
+enum HistoricalFormat { TEXT_LOG, BINARY_LOG, TEXT_AND_BINARY_LOG };
+
+// kind of the records of a historical log
+enum HistoricalKind : uint16_t { RISK_RECORD = 1, EXECUTION_RECORD = 2, STREAMING_RECORD = 3, INQUIRY_RECORD = 4 };
+
+const char HISTORICAL_LOG_MAGIC[4] = { 'B', 'H', 'L', 'G' };
+const uint16_t HISTORICAL_LOG_VERSION = 1;
+
+struct HistoricalLogHeader
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t kind;
+	uint32_t recordSize;
+	uint32_t reserved;
+	int64_t createdMicros;
+};
+
+struct HistoricalRecordHeader
+{
+	uint64_t sequence;
+	int64_t timestamp;
+};
+
+static_assert(sizeof(HistoricalLogHeader) == 24, "log header layout");
+static_assert(sizeof(HistoricalRecordHeader) == 16, "record header layout");
+
+// copy str into a fixed-width null-padded field, truncating it if needed
+template<size_t N>
+inline void SetLogField(char(&field)[N], std::string_view str)
+{
+	size_t size = std::min(str.size(), N);
+	std::memcpy(field, str.data(), size);
+	std::memset(field + size, 0, N - size);
+}
+
+// text of a fixed-width null-padded field
+template<size_t N>
+inline std::string_view LogField(const char(&field)[N])
+{
+	size_t size = 0;
+	while (size < N && field[size] != 0) ++size;
+	return std::string_view(field, size);
+}
+
+// microseconds since the epoch
+inline int64_t LogClockMicros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+* PV01 of a product.
+*/
+struct RiskLogRecord
+{
+	static const HistoricalKind KIND = RISK_RECORD;
+
+	HistoricalRecordHeader header;
+	char cusip[12];
+	uint32_t reserved;
+	double pv01;
+	int64_t quantity;
+
+	static RiskLogRecord From(const PV01<Bond>& data)
+	{
+		RiskLogRecord record = {};
+		record.header.timestamp = LogClockMicros();
+		SetLogField(record.cusip, data.GetProduct().GetProductId());
+		record.pv01 = data.GetPV01();
+		record.quantity = data.GetQuantity();
+		return record;
+	};
+};
+
+/**
+* Execution order sent to a market.
+*/
+struct ExecutionLogRecord
+{
+	static const HistoricalKind KIND = EXECUTION_RECORD;
+
+	HistoricalRecordHeader header;
+	char cusip[12];
+	char orderId[24];
+	char parentOrderId[24];
+	uint8_t side;        // PricingSide
+	uint8_t orderType;   // OrderType
+	uint8_t isChildOrder;
+	uint8_t reserved;
+	int64_t price;       // 1/256 ticks
+	int64_t visibleQuantity;
+	int64_t hiddenQuantity;
+
+	static ExecutionLogRecord From(const ExecutionOrder<Bond>& data)
+	{
+		ExecutionLogRecord record = {};
+		record.header.timestamp = LogClockMicros();
+		SetLogField(record.cusip, data.GetProduct().GetProductId());
+		SetLogField(record.orderId, data.GetOrderId());
+		SetLogField(record.parentOrderId, data.GetParentOrderId());
+		record.side = uint8_t(data.GetSide());
+		record.orderType = uint8_t(data.GetOrderType());
+		record.isChildOrder = data.IsChildOrder() ? 1 : 0;
+		record.price = data.GetPrice().Ticks();
+		record.visibleQuantity = data.GetVisibleQuantity();
+		record.hiddenQuantity = data.GetHiddenQuantity();
+		return record;
+	};
+};
+
+/**
+* Two-way price stream.
+*/
+struct StreamingLogRecord
+{
+	static const HistoricalKind KIND = STREAMING_RECORD;
+
+	HistoricalRecordHeader header;
+	char cusip[12];
+	uint32_t reserved;
+	int64_t bidPrice;    // 1/256 ticks
+	int64_t offerPrice;  // 1/256 ticks
+	int64_t bidVisibleQuantity;
+	int64_t bidHiddenQuantity;
+	int64_t offerVisibleQuantity;
+	int64_t offerHiddenQuantity;
+
+	static StreamingLogRecord From(const PriceStream<Bond>& data)
+	{
+		StreamingLogRecord record = {};
+		record.header.timestamp = LogClockMicros();
+		SetLogField(record.cusip, data.GetProduct().GetProductId());
+		record.bidPrice = data.GetBidOrder().GetPrice().Ticks();
+		record.offerPrice = data.GetOfferOrder().GetPrice().Ticks();
+		record.bidVisibleQuantity = data.GetBidOrder().GetVisibleQuantity();
+		record.bidHiddenQuantity = data.GetBidOrder().GetHiddenQuantity();
+		record.offerVisibleQuantity = data.GetOfferOrder().GetVisibleQuantity();
+		record.offerHiddenQuantity = data.GetOfferOrder().GetHiddenQuantity();
+		return record;
+	};
+};
+
+/**
+* Customer inquiry.
+*/
+struct InquiryLogRecord
+{
+	static const HistoricalKind KIND = INQUIRY_RECORD;
+
+	HistoricalRecordHeader header;
+	char cusip[12];
+	char inquiryId[24];
+	uint8_t side;        // Side
+	uint8_t state;       // InquiryState
+	uint16_t reserved;
+	int64_t price;       // 1/256 ticks
+	int64_t quantity;
+
+	static InquiryLogRecord From(const Inquiry<Bond>& data)
+	{
+		InquiryLogRecord record = {};
+		record.header.timestamp = LogClockMicros();
+		SetLogField(record.cusip, data.GetProduct().GetProductId());
+		SetLogField(record.inquiryId, data.GetInquiryId());
+		record.side = uint8_t(data.GetSide());
+		record.state = uint8_t(data.GetState());
+		record.price = data.GetPrice().Ticks();
+		record.quantity = data.GetQuantity();
+		return record;
+	};
+};
+
+/******************************** text forms of the records ********************************/
+
+// line written to risk.txt
+inline void WriteLegacyText(ostream& os, const RiskLogRecord& record)
+{
+	os << "PV01 is: " << std::to_string(record.pv01) << '\n';
+}
+
+// name of an OrderType as ExecutionOrder prints it
+inline const char* OrderTypeName(uint8_t orderType)
+{
+	static const char* names[] = { "FOK", "IOC", "MARKET", "LIMIT", "STOP" };
+	return orderType < 5 ? names[orderType] : "OTHER";
+}
+
+// lines written to execution.txt, the same as ExecutionOrder prints, written from the record fields; the bond is
+// found in BondProductService by its packed CUSIP
+inline void WriteLegacyText(ostream& os, const ExecutionLogRecord& record)
+{
+	std::string_view cusip = LogField(record.cusip);
+	const Bond& bond = BondProductService::create_service()->GetData(SecurityId::Parse(cusip));
+	os << "Execution detail for order Id is: " << LogField(record.orderId) << ", CUSIP Id is: " << cusip << '\n';
+	os << "Product: " << bond << '\n';
+	os << "  pricingSide: " << (record.side == BID ? "BID" : "OFFER") << '\n';
+	os << "  orderID: " << LogField(record.orderId) << '\n';
+	os << "  orderType: " << OrderTypeName(record.orderType) << '\n';
+	os << "  price: " << TickPrice(record.price) << '\n';
+	os << "  visibleQuantity: " << record.visibleQuantity << '\n';
+	os << "  hiddenQuantity: " << record.hiddenQuantity << '\n';
+	os << "  parentOrderId: " << LogField(record.parentOrderId) << '\n';
+	os << "  isChildOrder: " << (record.isChildOrder ? "true" : "false") << '\n';
+	os << '\n';
+}
+
+// line written to streaming.txt
+inline void WriteLegacyText(ostream& os, const StreamingLogRecord& record)
+{
+	os << "Product Id (CUSIP) is: " << LogField(record.cusip) << ", Bid price is: " << TickPrice(record.bidPrice)
+		<< ", Offer price is: " << TickPrice(record.offerPrice) << ";" << '\n';
+}
+
+// line written to allinquiries.txt
+inline void WriteLegacyText(ostream& os, const InquiryLogRecord& record)
+{
+	const char* side = record.side == Side::BUY ? "BUY" : "SELL";
+	const char* state = record.state == InquiryState::RECEIVED ? "RECEIVED" : "OTHERS";
+	os << "Product Id: " << LogField(record.cusip) << ", Inquiry Id: " << LogField(record.inquiryId) << ", Price: " << TickPrice(record.price)
+		<< ", Quantity: " << record.quantity << ", Side: " << side << ", State: " << state << ";" << '\n';
+}
+
+inline void WriteCsvHeader(ostream& os, const RiskLogRecord&)
+{
+	os << "sequence,timestamp,product,pv01,quantity\n";
+}
+
+inline void WriteCsv(ostream& os, const RiskLogRecord& record)
+{
+	os << record.header.sequence << ',' << record.header.timestamp << ',' << LogField(record.cusip) << ','
+		<< std::to_string(record.pv01) << ',' << record.quantity << '\n';
+}
+
+inline void WriteCsvHeader(ostream& os, const ExecutionLogRecord&)
+{
+	os << "sequence,timestamp,product,orderId,side,orderType,price,visibleQuantity,hiddenQuantity,parentOrderId,isChildOrder\n";
+}
+
+inline void WriteCsv(ostream& os, const ExecutionLogRecord& record)
+{
+	os << record.header.sequence << ',' << record.header.timestamp << ',' << LogField(record.cusip) << ',' << LogField(record.orderId) << ','
+		<< (record.side == BID ? "BID" : "OFFER") << ',' << OrderTypeName(record.orderType) << ','
+		<< TickPrice(record.price) << ',' << record.visibleQuantity << ',' << record.hiddenQuantity << ','
+		<< LogField(record.parentOrderId) << ',' << (record.isChildOrder ? "true" : "false") << '\n';
+}
+
+inline void WriteCsvHeader(ostream& os, const StreamingLogRecord&)
+{
+	os << "sequence,timestamp,product,bidPrice,offerPrice,bidVisibleQuantity,bidHiddenQuantity,offerVisibleQuantity,offerHiddenQuantity\n";
+}
+
+inline void WriteCsv(ostream& os, const StreamingLogRecord& record)
+{
+	os << record.header.sequence << ',' << record.header.timestamp << ',' << LogField(record.cusip) << ','
+		<< TickPrice(record.bidPrice) << ',' << TickPrice(record.offerPrice) << ','
+		<< record.bidVisibleQuantity << ',' << record.bidHiddenQuantity << ','
+		<< record.offerVisibleQuantity << ',' << record.offerHiddenQuantity << '\n';
+}
+
+inline void WriteCsvHeader(ostream& os, const InquiryLogRecord&)
+{
+	os << "sequence,timestamp,product,inquiryId,side,quantity,price,state\n";
+}
+
+inline void WriteCsv(ostream& os, const InquiryLogRecord& record)
+{
+	os << record.header.sequence << ',' << record.header.timestamp << ',' << LogField(record.cusip) << ',' << LogField(record.inquiryId) << ','
+		<< (record.side == Side::BUY ? "BUY" : "SELL") << ',' << record.quantity << ',' << TickPrice(record.price) << ','
+		<< (record.state == InquiryState::RECEIVED ? "RECEIVED" : "OTHERS") << '\n';
+}
+
+/******************************** writer and reader ********************************/
+
+/**
+* Where a historical connector stores its binary records.
+* Append assigns the sequence number and must not block on the disk; Flush hands buffered records to the
+* operating system. Only one thread appends at a time.
+*/
+template<typename R>
+class HistoricalLogBackend
+{
+public:
+	virtual ~HistoricalLogBackend() {};
+
+	// store a record, its sequence number is assigned here
+	virtual void Append(R record) = 0;
+
+	// store count records, by default one Append each
+	virtual void AppendBatch(const R* records, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) Append(records[i]);
+	};
+
+	// write out all buffered records
+	virtual void Flush() = 0;
+
+	// change when buffered records are written out, if the backend buffers at all
+	virtual void SetConfig(const FlushConfig&) {};
+};
+
+/**
+* Appends records of type R to a historical log.
+* The file is opened on the first record: an existing log of the same kind is continued with the next sequence
+* number, anything else at that path is replaced by a new log.
+*/
+template<typename R>
+class HistoricalLogWriter : public HistoricalLogBackend<R>
+{
+private:
+	std::string path;
+	FlushConfig config;
+	std::unique_ptr<BufferedFileWriter> writer;
+	uint64_t sequence = 0;
+
+	void Open()
+	{
+		// a valid log of this kind is continued, records are fixed-size so the count gives the next sequence;
+		// a record torn by a crash during an append is cut off
+		bool valid = false;
+		size_t complete = 0;
+		{
+			MappedFile existing(path);
+			if (existing.IsOpen() && existing.Size() >= sizeof(HistoricalLogHeader))
+			{
+				HistoricalLogHeader header;
+				std::memcpy(&header, existing.Data(), sizeof(header));
+				size_t body = existing.Size() - sizeof(header);
+				valid = std::memcmp(header.magic, HISTORICAL_LOG_MAGIC, 4) == 0 && header.version == HISTORICAL_LOG_VERSION
+					&& header.kind == R::KIND && header.recordSize == sizeof(R);
+				if (valid) sequence = body / sizeof(R);
+				complete = sizeof(header) + sequence * sizeof(R);
+			}
+		}
+		std::error_code ec;
+		if (!valid) std::remove(path.c_str());
+		else if (std::filesystem::file_size(path, ec) != complete) std::filesystem::resize_file(path, complete, ec);
+
+		writer.reset(new BufferedFileWriter(path, config));
+		if (!valid)
+		{
+			HistoricalLogHeader header = {};
+			std::memcpy(header.magic, HISTORICAL_LOG_MAGIC, 4);
+			header.version = HISTORICAL_LOG_VERSION;
+			header.kind = R::KIND;
+			header.recordSize = sizeof(R);
+			header.createdMicros = LogClockMicros();
+			writer->Stream().write(reinterpret_cast<const char*>(&header), sizeof(header));
+			sequence = 0;
+		}
+	};
+
+public:
+	explicit HistoricalLogWriter(const std::string& _path, const FlushConfig& _config = FlushConfig()) :
+		path(_path), config(_config)
+	{
+	};
+
+	// append a record, its sequence number is assigned here
+	void Append(R record) override
+	{
+		if (!writer) Open();
+		record.header.sequence = sequence++;
+		writer->Stream().write(reinterpret_cast<const char*>(&record), sizeof(R));
+		writer->EndRecord();
+	};
+
+	// append count records, flushed as the policy says for all of them at once
+	void AppendBatch(const R* records, size_t count) override
+	{
+		if (!writer) Open();
+		writer->BeginBatch();
+		for (size_t i = 0; i < count; ++i) Append(records[i]);
+		writer->EndBatch();
+	};
+
+	// write out all buffered records
+	void Flush() override
+	{
+		if (writer) writer->Flush();
+	};
+
+	// change when the file is flushed
+	void SetConfig(const FlushConfig& _config) override
+	{
+		config = _config;
+		if (writer) writer->SetConfig(config);
+	};
+
+	// sequence number of the next record
+	uint64_t NextSequence() const
+	{
+		return sequence;
+	};
+};
+
+/**
+* Read-only view of a historical log, memory mapped.
+*/
+class HistoricalLogReader
+{
+private:
+	MappedFile file;
+	HistoricalLogHeader header;
+	bool valid = false;
+
+public:
+	explicit HistoricalLogReader(const std::string& path) : file(path)
+	{
+		if (!file.IsOpen() || file.Size() < sizeof(HistoricalLogHeader)) return;
+		std::memcpy(&header, file.Data(), sizeof(header));
+		valid = std::memcmp(header.magic, HISTORICAL_LOG_MAGIC, 4) == 0 && header.version == HISTORICAL_LOG_VERSION && header.recordSize > 0;
+	};
+
+	// the file exists and starts with a log header
+	bool IsValid() const
+	{
+		return valid;
+	};
+
+	const HistoricalLogHeader& GetHeader() const
+	{
+		return header;
+	};
+
+	HistoricalKind GetKind() const
+	{
+		return HistoricalKind(header.kind);
+	};
+
+	// complete records in the file, a partly written last record is ignored
+	size_t Count() const
+	{
+		return valid ? (file.Size() - sizeof(HistoricalLogHeader)) / header.recordSize : 0;
+	};
+
+	// copy record i into record, false if the log does not hold records of type R or i is out of range
+	template<typename R>
+	bool Get(size_t i, R& record) const
+	{
+		if (!valid || header.kind != R::KIND || header.recordSize != sizeof(R) || i >= Count()) return false;
+		std::memcpy(&record, file.Data() + sizeof(HistoricalLogHeader) + i * sizeof(R), sizeof(R));
+		return true;
+	};
+
+	// call f(record) for every record of type R, returns the number of records visited
+	template<typename R, typename F>
+	size_t ForEach(F f) const
+	{
+		R record;
+		size_t i = 0;
+		while (Get(i, record))
+		{
+			f(record);
+			++i;
+		}
+		return i;
+	};
+};
+
+// format of an export
+enum HistoricalExportFormat { EXPORT_CSV, EXPORT_LEGACY_TEXT };
+
+// write every record of type R of a log or journal reader to os, returns the number of records
+template<typename R, typename Reader>
+size_t ExportHistoricalLog(const Reader& reader, ostream& os, HistoricalExportFormat format)
+{
+	if (format == EXPORT_CSV) WriteCsvHeader(os, R());
+	return reader.template ForEach<R>([&](const R& record)
+	{
+		if (format == EXPORT_CSV) WriteCsv(os, record);
+		else WriteLegacyText(os, record);
+	});
+}
+
+// write every record of a log or journal reader to os whatever its kind, returns the number of records
+template<typename Reader>
+size_t ExportHistoricalLog(const Reader& reader, ostream& os, HistoricalExportFormat format)
+{
+	switch (reader.GetKind())
+	{
+	case RISK_RECORD: return ExportHistoricalLog<RiskLogRecord>(reader, os, format);
+	case EXECUTION_RECORD: return ExportHistoricalLog<ExecutionLogRecord>(reader, os, format);
+	case STREAMING_RECORD: return ExportHistoricalLog<StreamingLogRecord>(reader, os, format);
+	case INQUIRY_RECORD: return ExportHistoricalLog<InquiryLogRecord>(reader, os, format);
+	default: return 0;
+	}
+}
+
+#endif /* HistoricalLog_h */
@@ -0,0 +1,97 @@
+//
+//  HistoricalLogTool.cpp
+//  MTH 9815
+//
+//  Export a binary historical log written with historicalFormat = BINARY_LOG (output/*.bin),
+//  a compressed log (output/*.bhd) or a mapped journal given by its prefix (output/streaming.journal).
+//  usage: HistoricalLogTool <log.bin|log.bhd|journal prefix> [csv|text|info] [output file]
+//    csv   one row per record with sequence, timestamp and all fields (default)
+//    text  the lines the connectors write to the legacy .txt files
+//    info  header and record count only
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "products.hpp"
+#include "HistoricalLog.h"
+#include "MappedJournal.h"
+#include "DeltaLog.h"
+#include "GenerateTradeFile.h"
+
+static const char* KindName(HistoricalKind kind)
+{
+	static const char* kinds[] = { "unknown", "risk", "execution", "streaming", "inquiry" };
+	return kind <= 4 ? kinds[kind] : kinds[0];
+}
+
+static void PrintInfo(const HistoricalLogReader& reader, const std::string& path)
+{
+	const HistoricalLogHeader& header = reader.GetHeader();
+	std::cout << path << ": " << KindName(reader.GetKind()) << " log, version " << header.version
+		<< ", " << header.recordSize << " bytes per record, " << reader.Count() << " records, created at "
+		<< header.createdMicros << "us" << std::endl;
+}
+
+static void PrintInfo(const DeltaLogReader& reader, const std::string& path)
+{
+	const HistoricalLogHeader& header = reader.GetHeader();
+	size_t count = reader.Count();
+	std::cout << path << ": " << KindName(reader.GetKind()) << " compressed log, version " << header.version
+		<< ", " << count << " records in " << reader.Bytes() << " bytes (" << (count ? double(reader.Bytes()) / count : 0.0)
+		<< " per record, " << header.recordSize << " uncompressed), created at " << header.createdMicros << "us" << std::endl;
+}
+
+static void PrintInfo(const MappedJournalReader& reader, const std::string& path)
+{
+	std::cout << path << ": " << KindName(reader.GetKind()) << " journal, " << reader.GetSegmentCount() << " segments, "
+		<< reader.Count() << " records" << std::endl;
+}
+
+template<typename Reader>
+static int Export(const Reader& reader, const std::string& path, const std::string& mode, const char* outputPath)
+{
+	if (mode == "info")
+	{
+		PrintInfo(reader, path);
+		return 0;
+	}
+	if (mode != "csv" && mode != "text")
+	{
+		std::cerr << "unknown format " << mode << ", expected csv, text or info" << std::endl;
+		return 2;
+	}
+
+	// the text form of executions prints the bond, look it up in the same reference data as main.cpp
+	auto productService = BondProductService::create_service();
+	for (auto& bond : default_bonds()) productService->Add(bond);
+
+	std::ofstream file;
+	if (outputPath) file.open(outputPath, ios_base::binary | ios_base::trunc);
+	std::ostream& out = outputPath ? file : std::cout;
+
+	size_t count = ExportHistoricalLog(reader, out, mode == "csv" ? EXPORT_CSV : EXPORT_LEGACY_TEXT);
+	out.flush();
+	std::cerr << count << " records exported" << std::endl;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <log.bin|log.bhd|journal prefix> [csv|text|info] [output file]" << std::endl;
+		return 2;
+	}
+	std::string path = argv[1];
+	std::string mode = argc > 2 ? argv[2] : "csv";
+
+	HistoricalLogReader log(path);
+	if (log.IsValid()) return Export(log, path, mode, argc > 3 ? argv[3] : nullptr);
+	DeltaLogReader compressed(path);
+	if (compressed.IsValid()) return Export(compressed, path, mode, argc > 3 ? argv[3] : nullptr);
+	MappedJournalReader journal(path);
+	if (journal.IsValid()) return Export(journal, path, mode, argc > 3 ? argv[3] : nullptr);
+	std::cerr << path << " is not a historical log or journal" << std::endl;
+	return 1;
+}
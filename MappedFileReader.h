@@ -0,0 +1,224 @@
+#pragma once
+//
+//  MappedFileReader.h
+//  MTH 9815
+//
+
+#ifndef MappedFileReader_h
+#define MappedFileReader_h
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <charconv>
+#include <atomic>
+#include <cstring>
+#include "UringFile.h"
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+/**
+* Read-only view of a whole input file.
+* On POSIX systems the file is memory mapped; elsewhere, or with the IO_URING backend, it is read into a buffer once.
+* The bytes stay valid for the lifetime of the object, so callers can hand out string_views into them.
+*/
+class MappedFile
+{
+public:
+	// ctor: map the file at the given path, empty if it cannot be opened
+	explicit MappedFile(const std::string& path, FileIoBackend backend = IO_DEFAULT)
+	{
+#ifdef _WIN32
+		ifstream myfile(path, ios_base::binary);
+		buffer.assign(istreambuf_iterator<char>(myfile), istreambuf_iterator<char>());
+		bytes = buffer.data();
+		length = buffer.size();
+#else
+		if (backend == IO_URING)
+		{
+			// read ahead on an io_uring instead of faulting the pages in one at a time
+			size_t size = 0;
+			if (ReadFileAhead(path, loaded, size) && size > 0)
+			{
+				bytes = loaded.get();
+				length = size;
+			}
+			return;
+		}
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return;
+		struct stat st;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr != MAP_FAILED)
+			{
+				// the connectors read front to back exactly once
+				::madvise(addr, st.st_size, MADV_SEQUENTIAL);
+				bytes = static_cast<const char*>(addr);
+				length = st.st_size;
+			}
+		}
+		::close(fd);
+#endif
+	};
+
+	~MappedFile()
+	{
+#ifndef _WIN32
+		if (bytes && !loaded) ::munmap(const_cast<char*>(bytes), length);
+#endif
+	};
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// whether the file was opened and is non-empty
+	bool IsOpen() const
+	{
+		return bytes != nullptr;
+	};
+
+	const char* Data() const
+	{
+		return bytes;
+	};
+
+	size_t Size() const
+	{
+		return length;
+	};
+
+	// the whole file as a view
+	std::string_view View() const
+	{
+		return std::string_view(bytes, length);
+	};
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	std::vector<char> buffer;
+#else
+	std::unique_ptr<char[]> loaded;   // the file read with IO_URING
+#endif
+};
+
+/**
+* Line and field tokenizer over a MappedFile.
+* Lines and fields are returned as string_views into the mapping, nothing is copied.
+*/
+class MappedFileReader
+{
+private:
+	MappedFile file;
+	size_t pos = 0;
+
+public:
+	explicit MappedFileReader(const std::string& path) : file(path, InputBackend()) {};
+
+	bool IsOpen() const
+	{
+		return file.IsOpen();
+	};
+
+	// get the next line without its terminator, false at end of file
+	bool NextLine(std::string_view& line)
+	{
+		return NextLine(file.View(), pos, line);
+	};
+
+	// get the line of text starting at pos and move pos past it, false at the end of text
+	static bool NextLine(std::string_view text, size_t& pos, std::string_view& line)
+	{
+		size_t size = text.size();
+		if (pos >= size) return false;
+		const char* begin = text.data() + pos;
+		const char* end = static_cast<const char*>(memchr(begin, '\n', size - pos));
+		size_t len = end ? end - begin : size - pos;
+		pos += len + 1;
+		// tolerate files written with windows line endings
+		if (len > 0 && begin[len - 1] == '\r') --len;
+		line = std::string_view(begin, len);
+		return true;
+	};
+
+	// the part of the file not read yet
+	std::string_view Remaining() const
+	{
+		return pos < file.Size() ? file.View().substr(pos) : std::string_view();
+	};
+
+	// get the next line and split it, false at end of file
+	bool NextRow(std::vector<std::string_view>& fields, char delim = ',')
+	{
+		std::string_view line;
+		if (!NextLine(line)) return false;
+		SplitFields(line, fields, delim);
+		return true;
+	};
+
+	// split a line into fields, reusing the storage of the vector
+	static void SplitFields(std::string_view line, std::vector<std::string_view>& fields, char delim = ',')
+	{
+		fields.clear();
+		size_t start = 0;
+		while (true)
+		{
+			size_t next = line.find(delim, start);
+			if (next == std::string_view::npos)
+			{
+				fields.push_back(line.substr(start));
+				return;
+			}
+			fields.push_back(line.substr(start, next - start));
+			start = next + 1;
+		}
+	};
+};
+
+// convert a field to an integer without allocating, false unless the whole field is one
+inline bool FieldToLong(std::string_view field, long& value)
+{
+	const char* end = field.data() + field.size();
+	std::from_chars_result result = std::from_chars(field.data(), end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+// convert a field to a double without allocating, false unless the whole field is one
+inline bool FieldToDouble(std::string_view field, double& value)
+{
+	const char* end = field.data() + field.size();
+	std::from_chars_result result = std::from_chars(field.data(), end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+// rows the input connectors dropped because a quantity, price or timestamp field was not a number
+inline std::atomic<size_t>& RejectedFieldRows()
+{
+	static std::atomic<size_t> rows{ 0 };
+	return rows;
+}
+
+// count an input row with a malformed numeric field in RejectedFieldRows, returns false for ParseRow to pass on;
+// safe on the parser threads
+inline bool RejectInputField()
+{
+	RejectedFieldRows().fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+#endif /* MappedFileReader_h */
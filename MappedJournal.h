@@ -0,0 +1,476 @@
+#pragma once
+//
+//  MappedJournal.h
+//  MTH 9815
+//
+
+#ifndef MappedJournal_h
+#define MappedJournal_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include "HistoricalLog.h"
+#include "SegmentedLog.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+/**
+* Historical records in preallocated, memory-mapped journal segments.
+* A journal is a series of files prefix.000000, prefix.000001, ... of segmentBytes each. Appending a record is a
+* copy into the mapping and a store of the segment's committed count, with no system call; when a segment is full
+* the next one is created. Records reach the page cache immediately, so they survive a crash of the process; when
+* they reach the disk is decided by the sync policy on a background thread. A closed segment is truncated to its
+* records. With maxSegments the journal keeps a ring of the most recent segments and deletes older ones.
+*/
+
+// when journal segments are written to disk with msync
+// SYNC_NONE leaves it to the operating system, SYNC_INTERVAL syncs the current segment every syncIntervalMicros,
+// SYNC_ON_ROLLOVER syncs each segment once it is full; the syncing always happens on the background thread
+enum JournalSyncPolicy { SYNC_NONE, SYNC_INTERVAL, SYNC_ON_ROLLOVER };
+
+/**
+* Settings of a MappedJournal.
+*/
+struct JournalConfig
+{
+	size_t segmentBytes = 64 << 20;      // size of a segment file, header included
+	size_t maxSegments = 0;              // segments kept on disk, 0 to keep all of them
+	JournalSyncPolicy sync = SYNC_INTERVAL;
+	long syncIntervalMicros = 100000;
+
+	JournalConfig() {};
+	JournalConfig(size_t _segmentBytes, JournalSyncPolicy _sync) : segmentBytes(_segmentBytes), sync(_sync) {};
+};
+
+const char JOURNAL_MAGIC[4] = { 'B', 'J', 'N', 'L' };
+const uint16_t JOURNAL_VERSION = 1;
+
+/**
+* First bytes of every segment. The records follow it back to back.
+*/
+struct JournalSegmentHeader
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t kind;
+	uint32_t recordSize;
+	uint32_t segmentIndex;
+	int64_t createdMicros;
+	std::atomic<uint64_t> committed;   // records in the segment, stored after each record is copied
+};
+
+static_assert(sizeof(JournalSegmentHeader) == 32, "journal header layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the committed count is shared through the mapping");
+
+// file of segment index of a journal
+inline std::string JournalSegmentPath(const std::string& prefix, uint32_t index)
+{
+	return SegmentFilePath(prefix, index);
+}
+
+// indices of the segments of a journal found on disk, in order
+inline std::vector<uint32_t> FindJournalSegments(const std::string& prefix)
+{
+	return FindSegmentFiles(prefix);
+}
+
+/**
+* One mapped segment file, writable. The mapping is released and the file cut down to its records on destruction.
+*/
+class JournalSegment
+{
+private:
+	std::string path;
+	char* base = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	// no mmap: the segment lives in memory and is written out when it is closed
+	std::vector<char> buffer;
+#endif
+
+public:
+	JournalSegment(const std::string& _path, size_t _size) : path(_path), size(_size)
+	{
+#ifdef _WIN32
+		buffer.assign(size, 0);
+		base = buffer.data();
+#else
+		int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) return;
+		// reserve the blocks up front so appends never hit a full disk or extend the file
+		bool allocated = ::posix_fallocate(fd, 0, off_t(size)) == 0 || ::ftruncate(fd, off_t(size)) == 0;
+		if (allocated)
+		{
+			void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (addr != MAP_FAILED) base = static_cast<char*>(addr);
+		}
+		::close(fd);
+#endif
+	};
+
+	~JournalSegment()
+	{
+		if (!base) return;
+		size_t used = sizeof(JournalSegmentHeader) + Header()->committed.load() * Header()->recordSize;
+#ifdef _WIN32
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if (file)
+		{
+			std::fwrite(base, 1, used, file);
+			std::fclose(file);
+		}
+#else
+		::munmap(base, size);
+		// a segment deleted by the ring retention is gone already, nothing to cut
+		if (::truncate(path.c_str(), off_t(used)) != 0) {}
+#endif
+	};
+
+	JournalSegment(const JournalSegment&) = delete;
+	JournalSegment& operator=(const JournalSegment&) = delete;
+
+	bool IsOpen() const
+	{
+		return base != nullptr;
+	};
+
+	char* Data()
+	{
+		return base;
+	};
+
+	size_t Size() const
+	{
+		return size;
+	};
+
+	JournalSegmentHeader* Header()
+	{
+		return reinterpret_cast<JournalSegmentHeader*>(base);
+	};
+
+	const std::string& GetPath() const
+	{
+		return path;
+	};
+
+	// write the committed records to disk and wait for it
+	void Sync()
+	{
+#ifndef _WIN32
+		if (!base) return;
+		size_t used = sizeof(JournalSegmentHeader) + Header()->committed.load(std::memory_order_acquire) * Header()->recordSize;
+		::msync(base, std::min(size, used), MS_SYNC);
+#endif
+	};
+};
+
+/**
+* Historical log backend writing records of type R to a memory-mapped journal.
+*/
+template<typename R>
+class MappedJournal : public HistoricalLogBackend<R>
+{
+private:
+	std::string prefix;
+	JournalConfig config;
+	size_t capacity;           // records per segment
+	uint32_t nextIndex = 0;    // index of the next segment to create
+	uint64_t sequence = 0;
+	size_t used = 0;           // records in the current segment
+	char* records = nullptr;   // first record of the current segment
+	size_t dropped = 0;        // records appended while no segment could be created
+	bool createFailed = false; // the last segment could not be created, reported once until one is
+	bool retryOnFlush = false; // no new segment is tried before the next Flush or Sync
+
+	// shared with the background thread
+	std::mutex mtx;
+	std::condition_variable wakeUp;
+	std::shared_ptr<JournalSegment> current;
+	std::vector<std::shared_ptr<JournalSegment>> retired;   // full segments waiting for their sync
+	std::deque<uint32_t> kept;                               // segments on disk, oldest first
+	bool stopping = false;
+	std::thread syncer;
+	std::atomic<size_t> syncs{ 0 };
+
+	// close the current segment and start the next one
+	void Roll()
+	{
+		// nothing is appended until the next segment is open, the current one is full
+		records = nullptr;
+		used = 0;
+		std::shared_ptr<JournalSegment> segment(new JournalSegment(JournalSegmentPath(prefix, nextIndex), config.segmentBytes));
+		if (!segment->IsOpen())
+		{
+			if (!createFailed) std::cout << "Cannot create journal segment " << segment->GetPath() << std::endl;
+			createFailed = true;
+			retryOnFlush = true;
+			return;
+		}
+		createFailed = false;
+		JournalSegmentHeader* header = segment->Header();
+		std::memcpy(header->magic, JOURNAL_MAGIC, 4);
+		header->version = JOURNAL_VERSION;
+		header->kind = R::KIND;
+		header->recordSize = sizeof(R);
+		header->segmentIndex = nextIndex;
+		header->createdMicros = LogClockMicros();
+		new (&header->committed) std::atomic<uint64_t>(0);
+
+		std::vector<std::string> expired;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (current && config.sync != SYNC_NONE) retired.push_back(current);
+			current = segment;
+			kept.push_back(nextIndex);
+			while (config.maxSegments > 0 && kept.size() > config.maxSegments)
+			{
+				expired.push_back(JournalSegmentPath(prefix, kept.front()));
+				kept.pop_front();
+			}
+		}
+		wakeUp.notify_one();
+		for (auto& path : expired) std::remove(path.c_str());
+
+		++nextIndex;
+		records = segment->Data() + sizeof(JournalSegmentHeader);
+	};
+
+	void RunSyncer()
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true)
+		{
+			if (config.sync == SYNC_INTERVAL) wakeUp.wait_for(lock, std::chrono::microseconds(config.syncIntervalMicros));
+			else wakeUp.wait(lock, [this]() { return stopping || !retired.empty(); });
+
+			// take the work out of the lock so appends and rollovers never wait for the disk
+			std::vector<std::shared_ptr<JournalSegment>> full;
+			full.swap(retired);
+			std::shared_ptr<JournalSegment> active = config.sync == SYNC_INTERVAL ? current : nullptr;
+			bool done = stopping;
+			lock.unlock();
+
+			for (auto& segment : full) segment->Sync();
+			if (active) active->Sync();
+			syncs.fetch_add(full.size() + (active ? 1 : 0), std::memory_order_relaxed);
+			// the last reference to a retired segment unmaps and truncates it here
+			full.clear();
+			active.reset();
+
+			lock.lock();
+			if (done) return;
+		}
+	};
+
+public:
+	MappedJournal(const std::string& _prefix, const JournalConfig& _config = JournalConfig()) :
+		prefix(_prefix), config(_config)
+	{
+		capacity = config.segmentBytes > sizeof(JournalSegmentHeader) + sizeof(R) ? (config.segmentBytes - sizeof(JournalSegmentHeader)) / sizeof(R) : 1;
+		config.segmentBytes = sizeof(JournalSegmentHeader) + capacity * sizeof(R);
+
+		// continue after the segments of an earlier run, starting a new segment
+		for (uint32_t index : FindJournalSegments(prefix))
+		{
+			MappedFile file(JournalSegmentPath(prefix, index));
+			if (file.IsOpen() && file.Size() >= sizeof(JournalSegmentHeader))
+			{
+				const JournalSegmentHeader* header = reinterpret_cast<const JournalSegmentHeader*>(file.Data());
+				if (std::memcmp(header->magic, JOURNAL_MAGIC, 4) == 0 && header->kind == R::KIND && header->recordSize == sizeof(R))
+				{
+					// older segments may have been deleted by the ring retention, take the number after the last record
+					uint64_t count = std::min<uint64_t>(header->committed.load(), (file.Size() - sizeof(JournalSegmentHeader)) / sizeof(R));
+					if (count > 0)
+					{
+						R last;
+						std::memcpy(&last, file.Data() + sizeof(JournalSegmentHeader) + (count - 1) * sizeof(R), sizeof(R));
+						sequence = last.header.sequence + 1;
+					}
+				}
+			}
+			kept.push_back(index);
+			nextIndex = index + 1;
+		}
+
+		if (config.sync != SYNC_NONE) syncer = std::thread(&MappedJournal::RunSyncer, this);
+	};
+
+	~MappedJournal()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (current && config.sync != SYNC_NONE) retired.push_back(current);
+			current.reset();
+			stopping = true;
+		}
+		wakeUp.notify_one();
+		if (syncer.joinable()) syncer.join();
+	};
+
+	MappedJournal(const MappedJournal&) = delete;
+	MappedJournal& operator=(const MappedJournal&) = delete;
+
+	// copy the record into the current segment
+	void Append(R record) override
+	{
+		if (used == capacity || !records)
+		{
+			if (!retryOnFlush) Roll();
+			if (!records)
+			{
+				++dropped;
+				return;
+			}
+		}
+		record.header.sequence = sequence++;
+		std::memcpy(records + used * sizeof(R), &record, sizeof(R));
+		++used;
+		// publish the record to readers of the mapping and to the syncer
+		current->Header()->committed.store(used, std::memory_order_release);
+	};
+
+	// records are in the page cache as soon as Append returns, the sync policy decides the rest
+	// after a segment could not be created, the next Append tries again
+	void Flush() override
+	{
+		retryOnFlush = false;
+	};
+
+	// write the current segment to disk now and wait for it
+	void Sync()
+	{
+		retryOnFlush = false;
+		std::shared_ptr<JournalSegment> active;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			active = current;
+		}
+		if (active) active->Sync();
+	};
+
+	const JournalConfig& GetConfig() const
+	{
+		return config;
+	};
+
+	// msync calls made by the background thread so far
+	size_t GetSyncs() const
+	{
+		return syncs.load(std::memory_order_relaxed);
+	};
+
+	// records lost because no segment could be created for them
+	size_t GetDroppedRecords() const
+	{
+		return dropped;
+	};
+
+	// sequence number of the next record
+	uint64_t NextSequence() const
+	{
+		return sequence;
+	};
+};
+
+/**
+* Read-only view of all segments of a journal, possibly while it is being written.
+*/
+class MappedJournalReader
+{
+private:
+	struct Segment
+	{
+		std::unique_ptr<MappedFile> file;
+		size_t count;
+	};
+
+	std::vector<Segment> segments;
+	uint16_t kind = 0;
+	uint32_t recordSize = 0;
+
+public:
+	explicit MappedJournalReader(const std::string& prefix)
+	{
+		for (uint32_t index : FindJournalSegments(prefix))
+		{
+			std::unique_ptr<MappedFile> file(new MappedFile(JournalSegmentPath(prefix, index)));
+			if (!file->IsOpen() || file->Size() < sizeof(JournalSegmentHeader)) continue;
+			const JournalSegmentHeader* header = reinterpret_cast<const JournalSegmentHeader*>(file->Data());
+			if (std::memcmp(header->magic, JOURNAL_MAGIC, 4) != 0 || header->version != JOURNAL_VERSION || header->recordSize == 0) continue;
+			if (segments.empty())
+			{
+				kind = header->kind;
+				recordSize = header->recordSize;
+			}
+			else if (header->kind != kind || header->recordSize != recordSize) continue;
+			size_t count = std::min<size_t>(header->committed.load(std::memory_order_acquire), (file->Size() - sizeof(JournalSegmentHeader)) / recordSize);
+			segments.push_back(Segment{ std::move(file), count });
+		}
+	};
+
+	// at least one segment was found
+	bool IsValid() const
+	{
+		return !segments.empty();
+	};
+
+	HistoricalKind GetKind() const
+	{
+		return HistoricalKind(kind);
+	};
+
+	size_t GetSegmentCount() const
+	{
+		return segments.size();
+	};
+
+	// records in all segments
+	size_t Count() const
+	{
+		size_t count = 0;
+		for (auto& segment : segments) count += segment.count;
+		return count;
+	};
+
+	// call f(record) for every record of type R, oldest first, returns the number of records visited
+	template<typename R, typename F>
+	size_t ForEach(F f) const
+	{
+		if (kind != R::KIND || recordSize != sizeof(R)) return 0;
+		size_t visited = 0;
+		R record;
+		for (auto& segment : segments)
+		{
+			const char* data = segment.file->Data() + sizeof(JournalSegmentHeader);
+			for (size_t i = 0; i < segment.count; ++i)
+			{
+				std::memcpy(&record, data + i * sizeof(R), sizeof(R));
+				f(record);
+				++visited;
+			}
+		}
+		return visited;
+	};
+};
+
+#endif /* MappedJournal_h */
@@ -0,0 +1,189 @@
+//
+//  MarketDataFileTest.cpp
+//  MTH 9815
+//
+//  Checks the binary market data format of BondMarketDataFile.h: snapshots written with MarketDataFileWriter
+//  read back unchanged, truncated or corrupt files are rejected instead of read past their end, and a CUSIP
+//  past the limit of the id column is refused instead of given the id of another, and a binary file older than
+//  its text file is not taken as current.
+//  usage: MarketDataFileTest [directory]
+//    writes its scratch files under directory, the current one by default
+//    returns 1 if any check fails
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include "BondMarketDataFile.h"
+
+static long failures = 0;
+
+static void Check(bool ok, const std::string& what)
+{
+	if (ok) return;
+	if (++failures <= 20) std::cout << "FAILED: " << what << std::endl;
+}
+
+const char* CUSIPS[] = { "9128283H1", "9128283L2", "912828M80" };
+const uint32_t BLOCK_ROWS = 4;
+const long ROWS = 10;
+
+// price and quantity of level l in snapshot i
+static long Ticks(long i, int l) { return 99 * 256 + i * 8 + l; }
+static long Quantity(long i, int l) { return (i + 1) * 1000000 + l; }
+
+static void Write(const std::string& path)
+{
+	MarketDataFileWriter writer(path, BLOCK_ROWS);
+	long ticks[MARKET_DATA_LEVELS];
+	long quantities[MARKET_DATA_LEVELS];
+	for (long i = 0; i < ROWS; ++i)
+	{
+		for (int l = 0; l < MARKET_DATA_LEVELS; ++l)
+		{
+			ticks[l] = Ticks(i, l);
+			quantities[l] = Quantity(i, l);
+		}
+		Check(writer.Add(CUSIPS[i % 3], ticks, quantities), "add snapshot " + std::to_string(i));
+	}
+	Check(writer.Close(), "close " + path);
+}
+
+// snapshots of path read back until NextBlock stops, checked against what Write wrote
+static long ReadBack(const std::string& path, bool& valid)
+{
+	MarketDataFileReader reader(path);
+	valid = reader.IsValid();
+	long i = 0;
+	MarketDataBlock block;
+	while (reader.NextBlock(block))
+	{
+		for (uint32_t r = 0; r < block.rows; ++r, ++i)
+		{
+			Check(reader.GetCusips()[block.cusips[r]] == CUSIPS[i % 3], "cusip of snapshot " + std::to_string(i));
+			for (int l = 0; l < MARKET_DATA_LEVELS; ++l)
+			{
+				Check(block.prices[l][r] == Ticks(i, l) && block.quantities[l][r] == Quantity(i, l), "level of snapshot " + std::to_string(i));
+			}
+		}
+	}
+	return i;
+}
+
+static std::vector<char> Load(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void Save(const std::string& path, const std::vector<char>& bytes)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(bytes.data(), bytes.size());
+}
+
+int main(int argc, char* argv[])
+{
+	std::string directory = argc > 1 ? argv[1] : ".";
+	std::string path = directory + "/marketdata_test.bin";
+	std::string damaged = directory + "/marketdata_test_damaged.bin";
+
+	Write(path);
+	bool valid = false;
+	Check(ReadBack(path, valid) == ROWS && valid, "round trip of " + std::to_string(ROWS) + " snapshots");
+	std::cout << "round trip checked" << std::endl;
+
+	std::vector<char> bytes = Load(path);
+	size_t secondBlock = sizeof(MarketDataFileHeader) + MarketDataBlockSize(BLOCK_ROWS);
+
+	// an id past the cusip index in the second block, reading stops after the first
+	std::vector<char> corrupt = bytes;
+	uint16_t id = 3;
+	std::memcpy(&corrupt[secondBlock + 8 + sizeof(uint16_t)], &id, sizeof(id));
+	Save(damaged, corrupt);
+	Check(ReadBack(damaged, valid) == BLOCK_ROWS && valid, "cusip id past the index");
+
+	id = 0xffff;
+	std::memcpy(&corrupt[sizeof(MarketDataFileHeader) + 8], &id, sizeof(id));
+	Save(damaged, corrupt);
+	Check(ReadBack(damaged, valid) == 0 && valid, "cusip id 0xffff");
+
+	// a row count larger than a block
+	corrupt = bytes;
+	uint32_t rows = BLOCK_ROWS + 1;
+	std::memcpy(&corrupt[secondBlock], &rows, sizeof(rows));
+	Save(damaged, corrupt);
+	Check(ReadBack(damaged, valid) == BLOCK_ROWS && valid, "row count past the block size");
+
+	// a cut file and a bad magic are not valid at all
+	corrupt.assign(bytes.begin(), bytes.begin() + secondBlock);
+	Save(damaged, corrupt);
+	Check(ReadBack(damaged, valid) == 0 && !valid, "truncated file");
+	corrupt = bytes;
+	corrupt[0] = 'X';
+	Save(damaged, corrupt);
+	Check(ReadBack(damaged, valid) == 0 && !valid, "bad magic");
+	std::cout << "truncated and corrupt files checked" << std::endl;
+
+	// every CUSIP up to the limit gets its own id, the next new one is refused while known ones are still taken
+	{
+		MarketDataFileWriter writer(path, 1024);
+		long ticks[MARKET_DATA_LEVELS] = {};
+		long quantities[MARKET_DATA_LEVELS] = {};
+		bool added = true;
+		char cusip[16];
+		for (size_t i = 0; i < MARKET_DATA_MAX_CUSIPS; ++i)
+		{
+			std::snprintf(cusip, sizeof(cusip), "C%08zu", i);
+			added = writer.Add(cusip, ticks, quantities) && added;
+		}
+		Check(added, std::to_string(MARKET_DATA_MAX_CUSIPS) + " CUSIPs added");
+		std::snprintf(cusip, sizeof(cusip), "C%08zu", MARKET_DATA_MAX_CUSIPS);
+		Check(!writer.Add(cusip, ticks, quantities), "CUSIP past the limit refused");
+		Check(writer.Add("C00000001", ticks, quantities), "known CUSIP added after the limit");
+		Check(writer.Close(), "close the full file");
+	}
+	MarketDataFileReader full(path);
+	Check(full.IsValid() && full.GetCusips().size() == MARKET_DATA_MAX_CUSIPS, "index of the full file");
+	long fullRows = 0;
+	MarketDataBlock block;
+	while (full.NextBlock(block))
+	{
+		for (uint32_t r = 0; r < block.rows; ++r, ++fullRows)
+		{
+			long expected = fullRows < long(MARKET_DATA_MAX_CUSIPS) ? fullRows : 1;
+			Check(block.cusips[r] == expected, "cusip id of snapshot " + std::to_string(fullRows));
+		}
+	}
+	Check(fullRows == long(MARKET_DATA_MAX_CUSIPS) + 1, "snapshots of the full file");
+	std::cout << "cusip limit checked" << std::endl;
+
+	// a binary file is only reused while the text file it came from has not changed since
+	std::string text = directory + "/marketdata_test.txt";
+	Save(text, std::vector<char>(1, '\n'));
+	Write(path);
+	auto written = std::filesystem::last_write_time(path);
+	std::filesystem::last_write_time(text, written - std::chrono::seconds(1));
+	Check(MarketDataFileIsCurrent(text, path), "binary file newer than its text file");
+	std::filesystem::last_write_time(text, written + std::chrono::seconds(1));
+	Check(!MarketDataFileIsCurrent(text, path), "binary file older than its text file");
+	Check(!MarketDataFileIsCurrent(text, damaged), "damaged binary file");
+	std::remove(text.c_str());
+	Check(!MarketDataFileIsCurrent(text, path), "binary file without its text file");
+	std::cout << "staleness checked" << std::endl;
+
+	std::remove(path.c_str());
+	std::remove(damaged.c_str());
+	if (failures > 0)
+	{
+		std::cout << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+//
+//  MpscQueue.h
+//  MTH 9815
+//
+
+#ifndef MpscQueue_h
+#define MpscQueue_h
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+* Bounded lock-free queue for any number of producer threads and one consumer thread.
+* Every slot carries a sequence number telling whose turn it is (Vyukov's bounded queue), so producers only
+* contend on a single fetch of the enqueue position and never wait for each other to finish copying.
+* Capacity is rounded up to a power of two.
+*/
+template<typename T>
+class MpscQueue
+{
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	size_t mask;
+	std::unique_ptr<Cell[]> cells;
+	// keep the two positions on separate cache lines
+	alignas(64) std::atomic<size_t> enqueuePos{ 0 };  // shared by the producers
+	alignas(64) size_t dequeuePos = 0;                // owned by the consumer
+
+	static size_t RoundUp(size_t n)
+	{
+		size_t size = 2;
+		while (size < n) size <<= 1;
+		return size;
+	};
+
+public:
+	explicit MpscQueue(size_t capacity) : mask(RoundUp(capacity) - 1), cells(new Cell[RoundUp(capacity)])
+	{
+		for (size_t i = 0; i <= mask; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+	};
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	size_t Capacity() const
+	{
+		return mask + 1;
+	};
+
+	// producer: copy value into the queue, false if it is full
+	bool TryPush(const T& value)
+	{
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true)
+		{
+			cell = &cells[pos & mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = intptr_t(seq) - intptr_t(pos);
+			if (diff == 0)
+			{
+				// the slot is free for this lap, claim it
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			}
+			else if (diff < 0)
+			{
+				// the consumer has not freed the slot from the previous lap yet
+				return false;
+			}
+			else
+			{
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		cell->data = value;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	};
+
+	// consumer: move the oldest value into value, false if the queue is empty
+	bool TryPop(T& value)
+	{
+		Cell* cell = &cells[dequeuePos & mask];
+		if (cell->sequence.load(std::memory_order_acquire) != dequeuePos + 1) return false;
+		value = cell->data;
+		// hand the slot to the producers of the next lap
+		cell->sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+		++dequeuePos;
+		return true;
+	};
+
+	// consumer: approximate number of queued values
+	size_t Size() const
+	{
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		return pos > dequeuePos ? pos - dequeuePos : 0;
+	};
+};
+
+#endif /* MpscQueue_h */
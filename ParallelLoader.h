@@ -0,0 +1,127 @@
+#pragma once
+//
+//  ParallelLoader.h
+//  MTH 9815
+//
+
+#ifndef ParallelLoader_h
+#define ParallelLoader_h
+
+#include <iostream>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include "MappedFileReader.h"
+
+using namespace std;
+
+// split text into at most count pieces that each end right after a newline (or at the end of text)
+inline std::vector<std::string_view> SplitAtLines(std::string_view text, size_t count)
+{
+	std::vector<std::string_view> chunks;
+	if (text.empty() || count == 0) return chunks;
+	size_t target = std::max<size_t>(1, text.size() / count);
+	size_t begin = 0;
+	while (begin < text.size())
+	{
+		size_t end = begin + target;
+		if (end >= text.size() || chunks.size() + 1 == count)
+		{
+			end = text.size();
+		}
+		else
+		{
+			end = text.find('\n', end);
+			end = end == std::string_view::npos ? text.size() : end + 1;
+		}
+		chunks.push_back(text.substr(begin, end - begin));
+		begin = end;
+	}
+	return chunks;
+}
+
+/**
+* Parse the remaining rows of reader on threads worker threads and deliver them on the calling thread.
+* The text is cut into chunks at line boundaries; workers take chunks in order and decode each into its own
+* vector of rows with parse(fields, row), which returns false to skip a line. The calling thread delivers the
+* chunks strictly in file order with deliver(row) as soon as each one is complete, so the downstream services
+* see exactly the same sequence as with a sequential Subscribe(). At most window chunks are held in memory.
+* Returns the number of rows delivered.
+*/
+template<typename Row, typename Parse, typename Deliver>
+size_t RunParallel(MappedFileReader& reader, size_t threads, Parse parse, Deliver deliver, size_t chunksPerThread = 8, size_t window = 0)
+{
+	threads = std::max<size_t>(1, threads);
+	std::vector<std::string_view> chunks = SplitAtLines(reader.Remaining(), threads * chunksPerThread);
+	if (window == 0) window = 2 * threads;
+
+	std::vector<std::vector<Row>> rows(chunks.size());
+	std::vector<char> done(chunks.size(), 0);
+	size_t nextChunk = 0;   // next chunk a worker will take
+	size_t delivered = 0;   // chunks handed to deliver so far
+	std::mutex mtx;
+	std::condition_variable chunkDone;
+	std::condition_variable chunkFreed;
+
+	auto worker = [&]()
+	{
+		std::vector<std::string_view> data;
+		while (true)
+		{
+			size_t c;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				// do not run further ahead of the delivering thread than the window allows
+				chunkFreed.wait(lock, [&]() { return nextChunk >= chunks.size() || nextChunk < delivered + window; });
+				if (nextChunk >= chunks.size()) return;
+				c = nextChunk++;
+			}
+
+			std::vector<Row>& out = rows[c];
+			std::string_view text = chunks[c];
+			std::string_view line;
+			size_t pos = 0;
+			Row row;
+			while (MappedFileReader::NextLine(text, pos, line))
+			{
+				MappedFileReader::SplitFields(line, data);
+				if (parse(data, row)) out.push_back(row);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				done[c] = 1;
+			}
+			chunkDone.notify_all();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t t = 0; t < std::min(threads, chunks.size()); ++t) pool.emplace_back(worker);
+
+	size_t events = 0;
+	for (size_t c = 0; c < chunks.size(); ++c)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			chunkDone.wait(lock, [&]() { return done[c] != 0; });
+		}
+		for (auto& row : rows[c]) deliver(row);
+		events += rows[c].size();
+		std::vector<Row>().swap(rows[c]);
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			delivered = c + 1;
+		}
+		chunkFreed.notify_all();
+	}
+
+	for (auto& t : pool) t.join();
+	return events;
+}
+
+#endif /* ParallelLoader_h */
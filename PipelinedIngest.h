@@ -0,0 +1,79 @@
+#pragma once
+//
+//  PipelinedIngest.h
+//  MTH 9815
+//
+
+#ifndef PipelinedIngest_h
+#define PipelinedIngest_h
+
+#include <iostream>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include "MappedFileReader.h"
+#include "SpscRing.h"
+
+using namespace std;
+
+/**
+* Counters reported by a pipelined Subscribe().
+*/
+struct IngestStats
+{
+	size_t events = 0;           // rows decoded and delivered
+	size_t capacity = 0;         // ring slots
+	size_t maxOccupancy = 0;     // most filled slots seen by the service thread
+	double avgOccupancy = 0.0;   // average filled slots seen by the service thread
+	size_t producerStalls = 0;   // parser found the ring full
+	size_t consumerStalls = 0;   // service thread found the ring empty
+
+	friend ostream& operator<<(ostream& os, const IngestStats& stats)
+	{
+		os << "events: " << stats.events
+			<< ", ring occupancy max/avg: " << stats.maxOccupancy << "/" << stats.avgOccupancy << " of " << stats.capacity
+			<< ", parser stalls: " << stats.producerStalls
+			<< ", service stalls: " << stats.consumerStalls;
+		return os;
+	};
+};
+
+/**
+* Decode the remaining rows of reader on a dedicated parser thread and deliver them on the calling thread.
+* parse(fields, row) fills a preallocated Row slot and returns false to skip the line.
+* deliver(row) runs on the calling thread in file order, typically building the event and calling OnMessage.
+*/
+template<typename Row, typename Parse, typename Deliver>
+IngestStats RunPipelined(MappedFileReader& reader, size_t capacity, Parse parse, Deliver deliver)
+{
+	SpscRing<Row> ring(capacity);
+
+	std::thread parser([&reader, &ring, &parse]()
+	{
+		std::vector<std::string_view> data;
+		while (reader.NextRow(data))
+		{
+			Row* slot = ring.Claim();
+			if (parse(data, *slot)) ring.Publish();
+		}
+		ring.Close();
+	});
+
+	IngestStats stats;
+	while (Row* row = ring.Front())
+	{
+		deliver(*row);
+		ring.Pop();
+		++stats.events;
+	}
+	parser.join();
+
+	stats.capacity = ring.Capacity();
+	stats.maxOccupancy = ring.GetMaxOccupancy();
+	stats.avgOccupancy = ring.GetAverageOccupancy();
+	stats.producerStalls = ring.GetProducerStalls();
+	stats.consumerStalls = ring.GetConsumerStalls();
+	return stats;
+}
+
+#endif /* PipelinedIngest_h */
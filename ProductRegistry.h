@@ -0,0 +1,197 @@
+#pragma once
+//
+//  ProductRegistry.h
+//  MTH 9815
+//
+
+#ifndef ProductRegistry_h
+#define ProductRegistry_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <cstdint>
+#include "SecurityId.h"
+#include "FlatHashMap.h"
+
+using namespace std;
+
+// dense index of a product, assigned in registration order from 0
+typedef uint32_t ProductIndex;
+const ProductIndex NO_PRODUCT_INDEX = UINT32_MAX;
+
+/**
+* Interns product identifiers (CUSIPs) into dense 32-bit indices.
+* CUSIPs and ISINs are looked up by their packed SecurityId, other identifiers by their text.
+* Every Product registers its identifier when it is constructed, which happens when the bonds are loaded, and
+* copies of it carry the index along, so events reach the services with the index already resolved. Services keep
+* their per-product state in ProductTable, a vector indexed by it; only the string-keyed GetData shims look a
+* CUSIP up here. Not synchronized: register the products before the services run on other threads.
+*/
+class ProductRegistry
+{
+private:
+	FlatHashMap<SecurityId, ProductIndex> securities;
+	FlatHashMap<std::string, ProductIndex> indices;
+	std::vector<std::string> identifiers;
+
+	ProductRegistry() {};
+
+public:
+	// index of a CUSIP or ISIN, registering it if it is new
+	ProductIndex Intern(SecurityId security)
+	{
+		const ProductIndex* found = securities.Find(security);
+		if (found) return *found;
+		ProductIndex index = ProductIndex(identifiers.size());
+		identifiers.push_back(security.ToString());
+		securities.Insert(security, index);
+		return index;
+	};
+
+	// index of identifier, registering it if it is new
+	ProductIndex Intern(std::string_view identifier)
+	{
+		SecurityId security = SecurityId::Parse(identifier);
+		if (security.IsValid()) return Intern(security);
+		const ProductIndex* found = indices.Find(identifier);
+		if (found) return *found;
+		ProductIndex index = ProductIndex(identifiers.size());
+		identifiers.emplace_back(identifier);
+		indices.Insert(identifiers.back(), index);
+		return index;
+	};
+
+	// index of a CUSIP or ISIN, NO_PRODUCT_INDEX if it was never registered
+	ProductIndex Find(SecurityId security) const
+	{
+		const ProductIndex* found = securities.Find(security);
+		return found ? *found : NO_PRODUCT_INDEX;
+	};
+
+	// index of identifier, NO_PRODUCT_INDEX if it was never registered
+	ProductIndex Find(std::string_view identifier) const
+	{
+		SecurityId security = SecurityId::Parse(identifier);
+		if (security.IsValid()) return Find(security);
+		const ProductIndex* found = indices.Find(identifier);
+		return found ? *found : NO_PRODUCT_INDEX;
+	};
+
+	// identifier registered under index
+	const std::string& GetIdentifier(ProductIndex index) const
+	{
+		return identifiers.at(index);
+	};
+
+	// number of products registered, every index is below it
+	size_t Size() const
+	{
+		return identifiers.size();
+	};
+
+	// registry object pointer
+	static ProductRegistry* create_registry()
+	{
+		static ProductRegistry registry;
+		return &registry;
+	};
+};
+
+/**
+* Per-product state of a service: slots indexed by ProductIndex, with the map operations the services use.
+* An index past the end grows the table, so products registered late still work; the slots are kept in a deque so
+* growing never moves them, and a V& handed out stays valid as it did with std::map. The products registered when
+* the table is built have their slots from the start, so it does not grow under services sharded across threads.
+* Each slot starts a cache line of its own: neighbouring products belong to different shards of a ShardedListener,
+* and their threads would otherwise keep taking the same line from each other.
+*/
+template<typename V>
+class ProductTable
+{
+private:
+	struct alignas(64) PaddedSlot
+	{
+		std::optional<V> value;
+	};
+
+	std::deque<PaddedSlot> slots;
+
+	std::optional<V>& Slot(ProductIndex index)
+	{
+		if (index == NO_PRODUCT_INDEX) throw std::out_of_range("ProductTable: unregistered product");
+		if (index >= slots.size()) slots.resize(std::max<size_t>(index + 1, ProductRegistry::create_registry()->Size()));
+		return slots[index].value;
+	};
+
+public:
+	// one slot for every product registered so far
+	ProductTable() : slots(ProductRegistry::create_registry()->Size()) {};
+
+	// store value unless the product already has one, as std::map::insert, true if stored
+	bool Insert(ProductIndex index, const V& value)
+	{
+		std::optional<V>& slot = Slot(index);
+		if (slot) return false;
+		slot.emplace(value);
+		return true;
+	};
+
+	// value of the product, default constructed if it has none, as std::map::operator[]
+	V& operator[](ProductIndex index)
+	{
+		std::optional<V>& slot = Slot(index);
+		if (!slot) slot.emplace();
+		return *slot;
+	};
+
+	// value of the product, std::out_of_range if it has none, as std::map::at
+	V& At(ProductIndex index)
+	{
+		if (index >= slots.size() || !slots[index].value) throw std::out_of_range("ProductTable: no value for product");
+		return *slots[index].value;
+	};
+
+	const V& At(ProductIndex index) const
+	{
+		if (index >= slots.size() || !slots[index].value) throw std::out_of_range("ProductTable: no value for product");
+		return *slots[index].value;
+	};
+
+	// value of the product registered as identifier, for the string-keyed GetData
+	V& At(std::string_view identifier)
+	{
+		return At(ProductRegistry::create_registry()->Find(identifier));
+	};
+
+	bool Contains(ProductIndex index) const
+	{
+		return index < slots.size() && slots[index].value.has_value();
+	};
+
+	// call f(index, value) for the products with a value, in index order
+	template<typename F>
+	void ForEach(F f)
+	{
+		for (size_t i = 0; i < slots.size(); ++i)
+		{
+			if (slots[i].value) f(ProductIndex(i), *slots[i].value);
+		}
+	};
+
+	template<typename F>
+	void ForEach(F f) const
+	{
+		for (size_t i = 0; i < slots.size(); ++i)
+		{
+			if (slots[i].value) f(ProductIndex(i), *slots[i].value);
+		}
+	};
+};
+
+#endif /* ProductRegistry_h */
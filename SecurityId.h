@@ -0,0 +1,286 @@
+#pragma once
+//
+//  SecurityId.h
+//  MTH 9815
+//
+
+#ifndef SecurityId_h
+#define SecurityId_h
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+/**
+* A CUSIP or ISIN packed into one 64-bit integer, so it compares and hashes as a single word.
+* The top two bits give the kind. A CUSIP is its nine characters as a base-39 number over '#', '*', '0'-'9', '@',
+* 'A'-'Z'; an ISIN is its two letter country code in base 26, nine characters in base 36 and the check digit.
+* The digits follow ASCII order, so ids of one kind order as their text does. The text is only rebuilt when asked
+* for. Parse packs any code of the right shape; whether its check digit is right is a separate question, which the
+* input connectors ask through AcceptInputSecurity.
+*/
+class SecurityId
+{
+public:
+	enum Kind { NONE = 0, CUSIP_ID = 1, ISIN_ID = 2 };
+
+private:
+	static const int KIND_SHIFT = 62;
+	static const uint64_t VALUE_MASK = (uint64_t(1) << KIND_SHIFT) - 1;
+
+	uint64_t packed = 0;
+
+	explicit SecurityId(uint64_t _packed) : packed(_packed) {};
+
+	// base-39 CUSIP digit and base-36 alphanumeric digit of every byte, -1 where there is none
+	struct DigitTables
+	{
+		int8_t cusip[256];
+		int8_t alnum[256];
+
+		DigitTables()
+		{
+			for (int c = 0; c < 256; ++c)
+			{
+				cusip[c] = c >= '0' && c <= '9' ? int8_t(2 + c - '0') : c >= 'A' && c <= 'Z' ? int8_t(13 + c - 'A')
+					: c == '#' ? 0 : c == '*' ? 1 : c == '@' ? 12 : -1;
+				alnum[c] = c >= '0' && c <= '9' ? int8_t(c - '0') : c >= 'A' && c <= 'Z' ? int8_t(10 + c - 'A') : -1;
+			}
+		};
+	};
+
+	static const DigitTables& Digits()
+	{
+		static const DigitTables tables;
+		return tables;
+	};
+
+	static char CusipChar(int digit)
+	{
+		static const char alphabet[] = "#*0123456789@ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+		return alphabet[digit];
+	};
+
+	static int AlnumDigit(char c)
+	{
+		return Digits().alnum[uint8_t(c)];
+	};
+
+	static char AlnumChar(int digit)
+	{
+		return char(digit < 10 ? '0' + digit : 'A' + digit - 10);
+	};
+
+public:
+	// no security, what Parse returns for text that is neither a CUSIP nor an ISIN
+	SecurityId() {};
+
+	// a 9 character CUSIP or a 12 character ISIN, the empty id for anything else
+	static SecurityId Parse(std::string_view text)
+	{
+		if (text.size() == 9)
+		{
+			// one check for a bad character at the end, in two chains to shorten the multiply dependency
+			const int8_t* digits = Digits().cusip;
+			int bad = 0;
+			uint64_t high = 0, low = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				int digit = digits[uint8_t(text[i])];
+				bad |= digit;
+				high = high * 39 + uint64_t(digit);
+			}
+			for (int i = 4; i < 9; ++i)
+			{
+				int digit = digits[uint8_t(text[i])];
+				bad |= digit;
+				low = low * 39 + uint64_t(digit);
+			}
+			if (bad < 0) return SecurityId();
+			return SecurityId((uint64_t(CUSIP_ID) << KIND_SHIFT) | (high * 39ULL * 39 * 39 * 39 * 39 + low));
+		}
+		if (text.size() == 12)
+		{
+			uint64_t value = 0;
+			for (int i = 0; i < 2; ++i)
+			{
+				if (text[i] < 'A' || text[i] > 'Z') return SecurityId();
+				value = value * 26 + uint64_t(text[i] - 'A');
+			}
+			for (int i = 2; i < 11; ++i)
+			{
+				int digit = AlnumDigit(text[i]);
+				if (digit < 0) return SecurityId();
+				value = value * 36 + uint64_t(digit);
+			}
+			if (text[11] < '0' || text[11] > '9') return SecurityId();
+			value = value * 10 + uint64_t(text[11] - '0');
+			return SecurityId((uint64_t(ISIN_ID) << KIND_SHIFT) | value);
+		}
+		return SecurityId();
+	};
+
+	Kind GetKind() const
+	{
+		return Kind(packed >> KIND_SHIFT);
+	};
+
+	bool IsValid() const
+	{
+		return packed != 0;
+	};
+
+	// the packed word, equal ids have equal words
+	uint64_t Packed() const
+	{
+		return packed;
+	};
+
+	// characters of the text, 0 for the empty id
+	size_t Length() const
+	{
+		return GetKind() == CUSIP_ID ? 9 : GetKind() == ISIN_ID ? 12 : 0;
+	};
+
+	// write the text to out, which has room for 12 characters, returns its length
+	size_t ToChars(char* out) const
+	{
+		uint64_t value = packed & VALUE_MASK;
+		switch (GetKind())
+		{
+		case CUSIP_ID:
+			for (int i = 8; i >= 0; --i)
+			{
+				out[i] = CusipChar(int(value % 39));
+				value /= 39;
+			}
+			return 9;
+		case ISIN_ID:
+			out[11] = char('0' + value % 10);
+			value /= 10;
+			for (int i = 10; i >= 2; --i)
+			{
+				out[i] = AlnumChar(int(value % 36));
+				value /= 36;
+			}
+			out[1] = char('A' + value % 26);
+			out[0] = char('A' + value / 26);
+			return 12;
+		default:
+			return 0;
+		}
+	};
+
+	std::string ToString() const
+	{
+		char text[12];
+		return std::string(text, ToChars(text));
+	};
+
+	// the check digit the rest of the code calls for
+	static int CusipCheckDigit(std::string_view text)
+	{
+		int sum = 0;
+		for (int i = 0; i < 8; ++i)
+		{
+			char c = text[i];
+			int v = c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'Z' ? 10 + (c - 'A') : c == '*' ? 36 : c == '@' ? 37 : 38;
+			if (i % 2 == 1) v *= 2;
+			sum += v / 10 + v % 10;
+		}
+		return (10 - sum % 10) % 10;
+	};
+
+	static int IsinCheckDigit(std::string_view text)
+	{
+		// letters expand to two digits, then Luhn from the right with the rightmost digit doubled
+		int digits[22];
+		int count = 0;
+		for (int i = 0; i < 11; ++i)
+		{
+			int v = AlnumDigit(text[i]);
+			if (v >= 10) digits[count++] = v / 10;
+			digits[count++] = v % 10;
+		}
+		int sum = 0;
+		for (int i = count - 1, doubled = 1; i >= 0; --i, doubled ^= 1)
+		{
+			int v = digits[i] * (doubled ? 2 : 1);
+			sum += v / 10 + v % 10;
+		}
+		return (10 - sum % 10) % 10;
+	};
+
+	// true if the last character of text, a code Parse accepts, is the check digit of the others
+	static bool CheckDigitMatches(std::string_view text)
+	{
+		if (text.size() == 9) return text[8] == char('0' + CusipCheckDigit(text));
+		if (text.size() == 12) return text[11] == char('0' + IsinCheckDigit(text));
+		return false;
+	};
+
+	// true if the last character is the check digit of the others
+	bool HasValidCheckDigit() const
+	{
+		char text[12];
+		return CheckDigitMatches(std::string_view(text, ToChars(text)));
+	};
+
+	bool operator==(const SecurityId& other) const
+	{
+		return packed == other.packed;
+	};
+
+	bool operator!=(const SecurityId& other) const
+	{
+		return packed != other.packed;
+	};
+
+	bool operator<(const SecurityId& other) const
+	{
+		return packed < other.packed;
+	};
+
+	friend ostream& operator<<(ostream& output, const SecurityId& id)
+	{
+		char text[12];
+		output.write(text, std::streamsize(id.ToChars(text)));
+		return output;
+	};
+};
+
+// rows the input connectors dropped because their CUSIP was malformed or failed its check digit
+inline std::atomic<size_t>& RejectedSecurityRows()
+{
+	static std::atomic<size_t> rows{ 0 };
+	return rows;
+}
+
+// whether an input row may use id, parsed from text, counting it in RejectedSecurityRows when not; safe on the
+// parser threads
+inline bool AcceptInputSecurity(const SecurityId& id, std::string_view text)
+{
+	if (id.IsValid() && SecurityId::CheckDigitMatches(text)) return true;
+	RejectedSecurityRows().fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+namespace std
+{
+	// one multiply, the high bits of which spread the packed digits over the table
+	template<>
+	struct hash<SecurityId>
+	{
+		size_t operator()(const SecurityId& id) const
+		{
+			return size_t((id.Packed() * 0x9E3779B97F4A7C15ULL) >> 16);
+		};
+	};
+}
+
+#endif /* SecurityId_h */
@@ -0,0 +1,133 @@
+//
+//  SecurityIdTest.cpp
+//  MTH 9815
+//
+//  Checks the packing of SecurityId.h: CUSIPs and ISINs round trip through Parse and ToString, ids order as their
+//  text does, malformed codes are rejected, and the check digits of known codes are accepted and those of altered
+//  codes are not.
+//  usage: SecurityIdTest
+//    returns 1 if any check fails
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "SecurityId.h"
+
+static long failures = 0;
+
+static void Check(bool ok, const std::string& what)
+{
+	if (ok) return;
+	if (++failures <= 20) std::cout << "FAILED: " << what << std::endl;
+}
+
+// random codes over every character each kind allows
+static std::vector<std::string> RandomCodes(std::mt19937& rng, size_t count, bool isin)
+{
+	const std::string cusipChars = "#*0123456789@ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	const std::string alnum = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	std::vector<std::string> codes;
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::string code;
+		if (isin)
+		{
+			for (int c = 0; c < 2; ++c) code += char('A' + rng() % 26);
+			for (int c = 0; c < 9; ++c) code += alnum[rng() % alnum.size()];
+			code += char('0' + rng() % 10);
+		}
+		else
+		{
+			for (int c = 0; c < 9; ++c) code += cusipChars[rng() % cusipChars.size()];
+		}
+		codes.push_back(code);
+	}
+	return codes;
+}
+
+static void RoundTrip()
+{
+	std::mt19937 rng(11);
+	for (bool isin : { false, true })
+	{
+		std::vector<std::string> codes = RandomCodes(rng, 200000, isin);
+		// the extremes of each position as well
+		codes.push_back(isin ? "AA0000000000" : "#########");
+		codes.push_back(isin ? "ZZZZZZZZZZZ9" : "ZZZZZZZZZ");
+		std::vector<SecurityId> ids;
+		for (auto& code : codes)
+		{
+			SecurityId id = SecurityId::Parse(code);
+			Check(id.IsValid() && id.GetKind() == (isin ? SecurityId::ISIN_ID : SecurityId::CUSIP_ID), "kind of " + code);
+			Check(id.ToString() == code && id.Length() == code.size(), "round trip of " + code);
+			ids.push_back(id);
+		}
+
+		// sorting the ids sorts the text
+		std::vector<size_t> byId(codes.size()), byText(codes.size());
+		for (size_t i = 0; i < codes.size(); ++i) byId[i] = byText[i] = i;
+		std::sort(byId.begin(), byId.end(), [&](size_t a, size_t b) { return ids[a] < ids[b]; });
+		std::sort(byText.begin(), byText.end(), [&](size_t a, size_t b) { return codes[a] < codes[b]; });
+		bool ordered = true;
+		for (size_t i = 0; i < codes.size(); ++i) ordered = ordered && codes[byId[i]] == codes[byText[i]];
+		Check(ordered, isin ? "order of ISINs" : "order of CUSIPs");
+		std::cout << codes.size() << (isin ? " ISINs" : " CUSIPs") << " round tripped and ordered" << std::endl;
+	}
+}
+
+static void Rejects()
+{
+	const char* malformed[] = { "", "91282", "9128283h1", "9128283H1 ", "9128283-1", "US037833100", "U10378331005",
+		"us0378331005", "US037833100A", "US03783310#5" };
+	for (const char* text : malformed) Check(!SecurityId::Parse(text).IsValid(), std::string("accepted malformed ") + text);
+	std::cout << "malformed codes checked" << std::endl;
+}
+
+static void CheckDigits()
+{
+	// CUSIPs and ISINs published with their check digits
+	const char* valid[] = { "9128283H1", "912828U40", "912810RZ3", "037833100", "38259P508", "594918104", "17275R102",
+		"US0378331005", "US38259P5089", "GB0002634946", "AU0000XVGZA3" };
+	for (const char* text : valid)
+	{
+		SecurityId id = SecurityId::Parse(text);
+		Check(id.HasValidCheckDigit(), std::string("check digit of ") + text);
+
+		// every other last digit is wrong
+		std::string altered = text;
+		for (char c = '0'; c <= '9'; ++c)
+		{
+			if (c == text[altered.size() - 1]) continue;
+			altered.back() = c;
+			Check(!SecurityId::Parse(altered).HasValidCheckDigit(), "accepted check digit of " + altered);
+		}
+	}
+	Check(SecurityId::CusipCheckDigit("9128283H") == 1, "CusipCheckDigit of 9128283H");
+	Check(SecurityId::IsinCheckDigit("US037833100") == 5, "IsinCheckDigit of US037833100");
+	Check(!SecurityId().HasValidCheckDigit(), "check digit of the empty id");
+
+	// what the input connectors let through and count
+	size_t before = RejectedSecurityRows().load();
+	for (std::string text : { "9128283H1", "9128283H2", "bad", "9128283H\x01" })
+	{
+		Check(AcceptInputSecurity(SecurityId::Parse(text), text) == (text == "9128283H1"), "input of " + text);
+	}
+	Check(RejectedSecurityRows().load() == before + 3, "rejected input rows counted");
+	std::cout << "check digits checked" << std::endl;
+}
+
+int main()
+{
+	RoundTrip();
+	Rejects();
+	CheckDigits();
+	if (failures > 0)
+	{
+		std::cout << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,523 @@
+#pragma once
+//
+//  SegmentedLog.h
+//  MTH 9815
+//
+
+#ifndef SegmentedLog_h
+#define SegmentedLog_h
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "HistoricalLog.h"
+
+using namespace std;
+
+/**
+* Historical output files written as numbered segments, prefix.000000.txt, prefix.000001.txt, ..., each closed
+* once it reaches a size or covers a time span, with a small sidecar index prefix.000000.txt.idx. The index gives
+* the sequence and time range of the segment and, per CUSIP, the offsets of its first and last record, so a reader
+* goes straight to the segments and offsets of a query instead of scanning every file. A new run starts a new
+* segment and continues the sequence numbers. Without rotation the writer produces the single file prefix.txt
+* exactly as before and no index.
+*/
+
+/**
+* When a historical output file is cut into a new segment, 0 to never cut.
+*/
+struct RotationConfig
+{
+	size_t maxBytes = 0;      // segment size
+	int64_t maxMicros = 0;    // time between the first and last record of a segment
+
+	RotationConfig() {};
+	RotationConfig(size_t _maxBytes, int64_t _maxMicros) : maxBytes(_maxBytes), maxMicros(_maxMicros) {};
+
+	bool Enabled() const
+	{
+		return maxBytes > 0 || maxMicros > 0;
+	};
+};
+
+const char SEGMENT_INDEX_MAGIC[4] = { 'B', 'H', 'S', 'X' };
+const uint16_t SEGMENT_INDEX_VERSION = 1;
+
+struct SegmentIndexHeader
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t segment;
+	uint32_t cusipCount;      // entries following the header
+	uint64_t records;
+	uint64_t bytes;           // size of the segment when the index was written
+	uint64_t firstSequence;
+	uint64_t lastSequence;
+	int64_t firstTimestamp;
+	int64_t lastTimestamp;
+};
+
+struct SegmentIndexEntry
+{
+	char cusip[12];
+	uint32_t records;
+	uint64_t firstOffset;     // offset of the first and last record of the CUSIP in the segment
+	uint64_t lastOffset;
+	int64_t firstTimestamp;
+	int64_t lastTimestamp;
+};
+
+static_assert(sizeof(SegmentIndexHeader) == 64, "segment index header layout");
+static_assert(sizeof(SegmentIndexEntry) == 48, "segment index entry layout");
+
+// file of segment index of prefix, prefix.000012 followed by suffix
+inline std::string SegmentFilePath(const std::string& prefix, uint32_t index, const std::string& suffix = "")
+{
+	char number[16];
+	std::snprintf(number, sizeof(number), ".%06u", index);
+	return prefix + number + suffix;
+}
+
+// indices of the segments of prefix with the given suffix found on disk, in order
+inline std::vector<uint32_t> FindSegmentFiles(const std::string& prefix, const std::string& suffix = "")
+{
+	namespace fs = std::filesystem;
+	std::vector<uint32_t> indices;
+	fs::path base(prefix);
+	fs::path dir = base.has_parent_path() ? base.parent_path() : fs::path(".");
+	std::string name = base.filename().string() + ".";
+	std::error_code ec;
+	for (auto& entry : fs::directory_iterator(dir, ec))
+	{
+		std::string file = entry.path().filename().string();
+		if (file.size() != name.size() + 6 + suffix.size() || file.compare(0, name.size(), name) != 0) continue;
+		if (file.compare(name.size() + 6, suffix.size(), suffix) != 0) continue;
+		std::string digits = file.substr(name.size(), 6);
+		if (digits.find_first_not_of("0123456789") != std::string::npos) continue;
+		indices.push_back(uint32_t(std::stoul(digits)));
+	}
+	std::sort(indices.begin(), indices.end());
+	return indices;
+}
+
+/**
+* Index of one segment, built while it is written.
+*/
+class SegmentIndexBuilder
+{
+private:
+	SegmentIndexHeader header;
+	std::map<std::string, SegmentIndexEntry, std::less<>> entries;
+
+public:
+	SegmentIndexBuilder()
+	{
+		Reset(0);
+	};
+
+	void Reset(uint32_t segment)
+	{
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, SEGMENT_INDEX_MAGIC, 4);
+		header.version = SEGMENT_INDEX_VERSION;
+		header.segment = segment;
+		entries.clear();
+	};
+
+	// a record of cusip starting at offset in the segment
+	void Add(uint64_t sequence, int64_t timestamp, std::string_view cusip, uint64_t offset)
+	{
+		if (header.records == 0)
+		{
+			header.firstSequence = sequence;
+			header.firstTimestamp = timestamp;
+		}
+		header.lastSequence = sequence;
+		header.lastTimestamp = timestamp;
+		++header.records;
+
+		auto found = entries.find(cusip);
+		if (found == entries.end())
+		{
+			SegmentIndexEntry entry = {};
+			SetLogField(entry.cusip, cusip);
+			entry.firstOffset = offset;
+			entry.firstTimestamp = timestamp;
+			found = entries.emplace(std::string(cusip), entry).first;
+		}
+		SegmentIndexEntry& entry = found->second;
+		++entry.records;
+		entry.lastOffset = offset;
+		entry.lastTimestamp = timestamp;
+	};
+
+	uint64_t Records() const
+	{
+		return header.records;
+	};
+
+	int64_t FirstTimestamp() const
+	{
+		return header.firstTimestamp;
+	};
+
+	// write the index next to its segment, replacing the previous one in one rename
+	void Write(const std::string& path, uint64_t bytes)
+	{
+		header.bytes = bytes;
+		header.cusipCount = uint32_t(entries.size());
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, ios_base::binary | ios_base::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for (auto& entry : entries) file.write(reinterpret_cast<const char*>(&entry.second), sizeof(SegmentIndexEntry));
+		}
+		std::error_code ec;
+		std::filesystem::rename(temporary, path, ec);
+	};
+};
+
+/**
+* Append-only output cut into segments, with the interface of BufferedFileWriter plus BeginRecord.
+* Call BeginRecord before formatting each record into Stream(): it rotates if due, indexes the record and returns
+* its sequence number.
+*/
+class SegmentedFileWriter
+{
+private:
+	std::string prefix;
+	std::string extension;
+	FlushConfig config;
+	RotationConfig rotation;
+	std::unique_ptr<BufferedFileWriter> writer;
+	// writes what has to start every segment, such as a log header
+	std::function<void(std::ostream&)> segmentHeader;
+
+	SegmentIndexBuilder index;
+	uint32_t segment = 0;
+	uint64_t sequence = 0;
+	bool started = false;
+	bool batching = false;
+
+	std::string SegmentPath() const
+	{
+		return rotation.Enabled() ? SegmentFilePath(prefix, segment, extension) : prefix + extension;
+	};
+
+	// continue after the segments of an earlier run
+	void Start()
+	{
+		started = true;
+		if (!rotation.Enabled()) return;
+		std::vector<uint32_t> existing = FindSegmentFiles(prefix, extension);
+		if (existing.empty()) return;
+		segment = existing.back() + 1;
+		for (auto it = existing.rbegin(); it != existing.rend(); ++it)
+		{
+			std::ifstream file(SegmentFilePath(prefix, *it, extension) + ".idx", ios_base::binary);
+			SegmentIndexHeader header;
+			if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) && std::memcmp(header.magic, SEGMENT_INDEX_MAGIC, 4) == 0)
+			{
+				if (header.records > 0) sequence = header.lastSequence + 1;
+				break;
+			}
+		}
+	};
+
+	void Open()
+	{
+		if (!started) Start();
+		writer.reset(new BufferedFileWriter(SegmentPath(), config));
+		if (batching) writer->BeginBatch();
+		index.Reset(segment);
+		if (segmentHeader) segmentHeader(writer->Stream());
+	};
+
+	// close the current segment and its index, the next record opens the next one
+	void CloseSegment()
+	{
+		if (!writer) return;
+		uint64_t bytes = writer->GetOffset();
+		writer->Close();
+		if (rotation.Enabled()) index.Write(SegmentPath() + ".idx", bytes);
+		writer.reset();
+		++segment;
+	};
+
+public:
+	SegmentedFileWriter(const std::string& _prefix, const std::string& _extension, const FlushConfig& _config = FlushConfig()) :
+		prefix(_prefix), extension(_extension), config(_config)
+	{
+	};
+
+	~SegmentedFileWriter()
+	{
+		Close();
+	};
+
+	SegmentedFileWriter(const SegmentedFileWriter&) = delete;
+	SegmentedFileWriter& operator=(const SegmentedFileWriter&) = delete;
+
+	// start a record of cusip taken at timestamp, returns its sequence number
+	uint64_t BeginRecord(int64_t timestamp, std::string_view cusip)
+	{
+		if (writer && rotation.Enabled() && index.Records() > 0)
+		{
+			bool full = rotation.maxBytes > 0 && writer->GetOffset() >= rotation.maxBytes;
+			bool old = rotation.maxMicros > 0 && timestamp - index.FirstTimestamp() >= rotation.maxMicros;
+			if (full || old) CloseSegment();
+		}
+		if (!writer) Open();
+		index.Add(sequence, timestamp, cusip, writer->GetOffset());
+		return sequence++;
+	};
+
+	// stream to format the current record into
+	std::ostream& Stream()
+	{
+		if (!writer) Open();
+		return writer->Stream();
+	};
+
+	// mark the end of a record and flush if the policy says so
+	void EndRecord()
+	{
+		writer->EndRecord();
+	};
+
+	// apply the flush policy once for the records up to EndBatch, segments opened in between included
+	void BeginBatch()
+	{
+		batching = true;
+		if (writer) writer->BeginBatch();
+	};
+
+	void EndBatch()
+	{
+		batching = false;
+		if (writer) writer->EndBatch();
+	};
+
+	// write out everything buffered so far, and the index of the current segment
+	void Flush()
+	{
+		if (!writer) return;
+		writer->Flush();
+		if (rotation.Enabled()) index.Write(SegmentPath() + ".idx", writer->GetOffset());
+	};
+
+	// close the current segment, the next record starts a new one
+	void Close()
+	{
+		CloseSegment();
+	};
+
+	void SetConfig(const FlushConfig& _config)
+	{
+		config = _config;
+		if (writer) writer->SetConfig(config);
+	};
+
+	// change the rotation, closing the current file
+	void SetRotation(const RotationConfig& _rotation)
+	{
+		Close();
+		rotation = _rotation;
+		started = false;
+		segment = 0;
+	};
+
+	const RotationConfig& GetRotation() const
+	{
+		return rotation;
+	};
+
+	// bytes the current segment starts with, written again at the top of every segment
+	void SetSegmentHeader(std::function<void(std::ostream&)> header)
+	{
+		segmentHeader = header;
+	};
+
+	uint32_t GetSegment() const
+	{
+		return segment;
+	};
+};
+
+/**
+* Historical log backend writing records of type R to segmented binary logs, prefix.000000.bin and so on.
+* Every segment is a complete binary log that HistoricalLogReader and HistoricalLogTool can read on its own.
+*/
+template<typename R>
+class SegmentedLogWriter : public HistoricalLogBackend<R>
+{
+private:
+	SegmentedFileWriter files;
+
+public:
+	SegmentedLogWriter(const std::string& prefix, const RotationConfig& rotation, const FlushConfig& config = FlushConfig()) :
+		files(prefix, ".bin", config)
+	{
+		files.SetRotation(rotation);
+		files.SetSegmentHeader([](std::ostream& os)
+		{
+			HistoricalLogHeader header = {};
+			std::memcpy(header.magic, HISTORICAL_LOG_MAGIC, 4);
+			header.version = HISTORICAL_LOG_VERSION;
+			header.kind = R::KIND;
+			header.recordSize = sizeof(R);
+			header.createdMicros = LogClockMicros();
+			os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		});
+	};
+
+	// append a record, its sequence number is assigned here and continues across segments
+	void Append(R record) override
+	{
+		record.header.sequence = files.BeginRecord(record.header.timestamp, LogField(record.cusip));
+		files.Stream().write(reinterpret_cast<const char*>(&record), sizeof(R));
+		files.EndRecord();
+	};
+
+	void AppendBatch(const R* records, size_t count) override
+	{
+		files.BeginBatch();
+		for (size_t i = 0; i < count; ++i) Append(records[i]);
+		files.EndBatch();
+	};
+
+	void Flush() override
+	{
+		files.Flush();
+	};
+
+	void SetConfig(const FlushConfig& config) override
+	{
+		files.SetConfig(config);
+	};
+};
+
+/**
+* Segment of a segmented output and its index, if the index could be read.
+*/
+struct SegmentInfo
+{
+	uint32_t segment;
+	std::string path;
+	bool indexed = false;
+	SegmentIndexHeader header;
+	std::vector<SegmentIndexEntry> entries;
+};
+
+/**
+* Where to read the records of a query in one segment: from offset up to and including the record at lastOffset.
+*/
+struct SegmentLocation
+{
+	std::string path;
+	uint64_t offset;
+	uint64_t lastOffset;
+};
+
+/**
+* Lookups over the indexes of a segmented output. Segments without a readable index are never skipped.
+*/
+class SegmentedLogReader
+{
+private:
+	std::vector<SegmentInfo> segments;
+
+public:
+	SegmentedLogReader(const std::string& prefix, const std::string& extension)
+	{
+		for (uint32_t index : FindSegmentFiles(prefix, extension))
+		{
+			SegmentInfo info;
+			info.segment = index;
+			info.path = SegmentFilePath(prefix, index, extension);
+			std::ifstream file(info.path + ".idx", ios_base::binary);
+			if (file.read(reinterpret_cast<char*>(&info.header), sizeof(info.header))
+				&& std::memcmp(info.header.magic, SEGMENT_INDEX_MAGIC, 4) == 0 && info.header.version == SEGMENT_INDEX_VERSION)
+			{
+				info.entries.resize(info.header.cusipCount);
+				info.indexed = bool(file.read(reinterpret_cast<char*>(info.entries.data()), std::streamsize(info.entries.size() * sizeof(SegmentIndexEntry))));
+			}
+			segments.push_back(info);
+		}
+	};
+
+	const std::vector<SegmentInfo>& GetSegments() const
+	{
+		return segments;
+	};
+
+	// segment holding the record with this sequence number, nullptr if none is known to
+	const SegmentInfo* FindSequence(uint64_t sequence) const
+	{
+		for (auto& info : segments)
+		{
+			if (info.indexed && info.header.records > 0 && info.header.firstSequence <= sequence && sequence <= info.header.lastSequence) return &info;
+		}
+		return nullptr;
+	};
+
+	// the parts of the segments that can hold records of cusip with from <= timestamp <= to, in segment order
+	std::vector<SegmentLocation> Locate(std::string_view cusip, int64_t from, int64_t to) const
+	{
+		std::vector<SegmentLocation> locations;
+		for (auto& info : segments)
+		{
+			if (!info.indexed)
+			{
+				locations.push_back(SegmentLocation{ info.path, 0, UINT64_MAX });
+				continue;
+			}
+			for (auto& entry : info.entries)
+			{
+				if (LogField(entry.cusip) != cusip || entry.lastTimestamp < from || entry.firstTimestamp > to) continue;
+				locations.push_back(SegmentLocation{ info.path, entry.firstOffset, entry.lastOffset });
+			}
+		}
+		return locations;
+	};
+
+	// call f(record) for the records of type R of cusip with from <= timestamp <= to in a segmented binary log,
+	// reading only the located ranges, returns the number of records visited
+	template<typename R, typename F>
+	size_t ForEach(std::string_view cusip, int64_t from, int64_t to, F f) const
+	{
+		size_t visited = 0;
+		for (auto& location : Locate(cusip, from, to))
+		{
+			MappedFile file(location.path);
+			if (!file.IsOpen() || file.Size() < sizeof(HistoricalLogHeader)) continue;
+			HistoricalLogHeader header;
+			std::memcpy(&header, file.Data(), sizeof(header));
+			if (header.kind != R::KIND || header.recordSize != sizeof(R)) continue;
+			uint64_t offset = std::max<uint64_t>(location.offset, sizeof(HistoricalLogHeader));
+			uint64_t last = std::min<uint64_t>(location.lastOffset, file.Size() < sizeof(R) ? 0 : file.Size() - sizeof(R));
+			R record;
+			for (; offset <= last; offset += sizeof(R))
+			{
+				std::memcpy(&record, file.Data() + offset, sizeof(R));
+				if (LogField(record.cusip) != cusip || record.header.timestamp < from || record.header.timestamp > to) continue;
+				f(record);
+				++visited;
+			}
+		}
+		return visited;
+	};
+};
+
+#endif /* SegmentedLog_h */
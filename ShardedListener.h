@@ -0,0 +1,239 @@
+#pragma once
+//
+//  ShardedListener.h
+//  MTH 9815
+//
+
+#ifndef ShardedListener_h
+#define ShardedListener_h
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <cstddef>
+#include "soa.hpp"
+#include "AsyncListener.h"
+#include "MpscQueue.h"
+#include "ProductRegistry.h"
+
+using namespace std;
+
+/**
+* ServiceListener that partitions the events of a service by product across shardCount worker threads.
+* An event goes to the shard of its product index, index % shardCount, which spreads the dense indices evenly; each
+* shard is an AsyncListener in front of the same target, so the events of one product are delivered in order, on one
+* thread. The services behind it keep their per-product state in ProductTable slots, which makes every slot owned by
+* one shard: the shards run the same services side by side without sharing state, as long as those services touch
+* nothing but the state of the event's product. What is kept across products (the historical services, their files
+* and their in-memory maps) has to be reached through a MergeListener, and aggregates over products are computed by
+* Reduce. Register the products before Start, so the tables are not resized while the shards fill them.
+*/
+template<typename V>
+class ShardedListener : public ServiceListener<V>, public AsyncHop
+{
+private:
+	std::vector<std::unique_ptr<AsyncListener<V>>> shards;
+
+	AsyncListener<V>& ShardFor(V& data)
+	{
+		return *shards[ShardOf(data.GetProduct().GetProductIndex())];
+	};
+
+public:
+	ShardedListener(ServiceListener<V>* target, size_t shardCount, size_t queueCapacity = 1 << 12)
+	{
+		for (size_t i = 0; i < std::max<size_t>(shardCount, 1); ++i) shards.emplace_back(new AsyncListener<V>(target, queueCapacity));
+	};
+
+	// shard owning the state of a product
+	size_t ShardOf(ProductIndex index) const
+	{
+		return index % shards.size();
+	};
+
+	size_t GetShardCount() const
+	{
+		return shards.size();
+	};
+
+	void Start()
+	{
+		for (auto& shard : shards) shard->Start();
+	};
+
+	void Stop()
+	{
+		for (auto& shard : shards) shard->Stop();
+	};
+
+	void ProcessAdd(V& data)
+	{
+		ShardFor(data).ProcessAdd(data);
+	};
+
+	void ProcessRemove(V& data)
+	{
+		ShardFor(data).ProcessRemove(data);
+	};
+
+	void ProcessUpdate(V& data)
+	{
+		ShardFor(data).ProcessUpdate(data);
+	};
+
+	// partial(shard) on every shard's thread, after the events queued before, summed over the shards from init;
+	// waits for all of them, call it on the thread feeding the events
+	template<typename R, typename F>
+	R Reduce(R init, F partial)
+	{
+		std::vector<R> results(shards.size(), R());
+		std::atomic<size_t> done{ 0 };
+		for (size_t i = 0; i < shards.size(); ++i)
+		{
+			shards[i]->Post([&results, &done, &partial, i]()
+			{
+				results[i] = partial(i);
+				done.fetch_add(1, std::memory_order_release);
+			});
+		}
+		while (done.load(std::memory_order_acquire) < shards.size()) std::this_thread::yield();
+		for (auto& result : results) init = init + result;
+		return init;
+	};
+
+	// events delivered by every shard, an idea of the balance between them
+	std::vector<size_t> GetDelivered() const
+	{
+		std::vector<size_t> delivered;
+		for (auto& shard : shards) delivered.push_back(shard->GetDelivered());
+		return delivered;
+	};
+};
+
+/**
+* ServiceListener joining the events of several threads back onto one worker thread running target.
+* Put it in front of a service that is shared by all the shards of a ShardedListener. Events are copied into a
+* bounded lock-free MpscQueue, waiting while it is full; the events of each producer thread stay in order, those of
+* different threads are interleaved as they arrive. Until Start, and after Stop, events are passed to target inline.
+*/
+template<typename V>
+class MergeListener : public ServiceListener<V>, public AsyncHop
+{
+private:
+	enum EventKind { EVENT_ADD, EVENT_REMOVE, EVENT_UPDATE };
+
+	struct Event
+	{
+		EventKind kind = EVENT_ADD;
+		std::optional<V> data;
+	};
+
+	MpscQueue<Event> queue;
+	ServiceListener<V>* target;
+	std::thread worker;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> closed{ false };
+	bool stopped = false;
+	std::atomic<size_t> delivered{ 0 };
+	std::atomic<size_t> stalls{ 0 };
+
+	void Deliver(Event& event)
+	{
+		switch (event.kind)
+		{
+		case EVENT_ADD: target->ProcessAdd(*event.data); break;
+		case EVENT_REMOVE: target->ProcessRemove(*event.data); break;
+		case EVENT_UPDATE: target->ProcessUpdate(*event.data); break;
+		}
+		delivered.store(delivered.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	};
+
+	void Run()
+	{
+		Event event;
+		while (true)
+		{
+			if (queue.TryPop(event))
+			{
+				Deliver(event);
+				continue;
+			}
+			if (closed.load(std::memory_order_acquire))
+			{
+				// the queue is checked again after seeing closed so the last events are not lost
+				if (!queue.TryPop(event)) return;
+				Deliver(event);
+				continue;
+			}
+			std::this_thread::yield();
+		}
+	};
+
+	void Enqueue(EventKind kind, V& data)
+	{
+		Event event;
+		event.kind = kind;
+		event.data.emplace(data);
+		if (queue.TryPush(event)) return;
+		stalls.fetch_add(1, std::memory_order_relaxed);
+		while (!queue.TryPush(event)) std::this_thread::yield();
+	};
+
+public:
+	MergeListener(ServiceListener<V>* _target, size_t queueCapacity = 1 << 12) : queue(queueCapacity), target(_target) {};
+
+	~MergeListener()
+	{
+		Stop();
+	};
+
+	void Start()
+	{
+		if (stopped || running.exchange(true)) return;
+		worker = std::thread(&MergeListener::Run, this);
+	};
+
+	// call it once the threads feeding the events have stopped
+	void Stop()
+	{
+		if (!running.load()) return;
+		closed.store(true, std::memory_order_release);
+		worker.join();
+		running.store(false);
+		stopped = true;
+	};
+
+	void ProcessAdd(V& data)
+	{
+		if (running.load(std::memory_order_relaxed)) Enqueue(EVENT_ADD, data);
+		else target->ProcessAdd(data);
+	};
+
+	void ProcessRemove(V& data)
+	{
+		if (running.load(std::memory_order_relaxed)) Enqueue(EVENT_REMOVE, data);
+		else target->ProcessRemove(data);
+	};
+
+	void ProcessUpdate(V& data)
+	{
+		if (running.load(std::memory_order_relaxed)) Enqueue(EVENT_UPDATE, data);
+		else target->ProcessUpdate(data);
+	};
+
+	size_t GetDelivered() const
+	{
+		return delivered.load(std::memory_order_relaxed);
+	};
+
+	// times a producer found the queue full and waited
+	size_t GetProducerStalls() const
+	{
+		return stalls.load(std::memory_order_relaxed);
+	};
+};
+
+#endif /* ShardedListener_h */
@@ -0,0 +1,119 @@
+//
+//  ShardedRiskTest.cpp
+//  MTH 9815
+//
+//  Checks that BondRiskService risks a product the same way inline and behind a ShardedListener: the pv01 of every
+//  product moves by the draws of its own stream, in order, whichever thread risks it and however the shards
+//  interleave, so sharded runs publish the same risk as inline ones.
+//  usage: ShardedRiskTest
+//    returns 1 if any check fails
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BondRiskService.h"
+#include "ShardedListener.h"
+#include "GenerateTradeFile.h"
+
+static long failures = 0;
+
+static void Check(bool ok, const std::string& what)
+{
+	if (ok) return;
+	if (++failures <= 20) std::cout << "FAILED: " << what << std::endl;
+}
+
+const size_t SHARDS = 4;
+const int ROUNDS = 200;
+
+// pv01 and quantity published for each product, in the order the risk service published them
+class RecordingListener : public ServiceListener<PV01<Bond>>
+{
+public:
+	std::vector<std::vector<std::pair<double, long>>> records;
+
+	explicit RecordingListener(size_t products) : records(products) {};
+
+	void ProcessAdd(PV01<Bond>& data) override
+	{
+		records[data.GetProduct().GetProductIndex()].emplace_back(data.GetPV01(), data.GetQuantity());
+	};
+
+	void ProcessRemove(PV01<Bond>&) override {};
+	void ProcessUpdate(PV01<Bond>&) override {};
+};
+
+// what the risk service should have published for bond after rounds positions, computed on one thread
+static std::vector<std::pair<double, long>> Expected(const Bond& bond, int rounds)
+{
+	GeneratorRng draws = GeneratorRng::ForPartition(RISK_PV01_SEED, bond.GetProductIndex());
+	Position<Bond> position(bond);
+	std::vector<std::pair<double, long>> expected;
+	double pv01 = 0;
+	long quantity = 0;
+	for (int i = 0; i < rounds; ++i)
+	{
+		pv01 = pv01 + draws.Uniform(1000) / 100000.0;
+		quantity = quantity + position.GetAggregatePosition();
+		expected.emplace_back(pv01, quantity);
+	}
+	return expected;
+}
+
+static void CheckRecords(const std::vector<Bond>& bonds, const RecordingListener& recorder, int rounds, const std::string& what)
+{
+	for (auto& bond : bonds)
+	{
+		Check(recorder.records[bond.GetProductIndex()] == Expected(bond, rounds), what + " risk of " + bond.GetProductId());
+	}
+}
+
+int main()
+{
+	std::vector<Bond> bonds = default_bonds();
+	BondRiskService* riskService = BondRiskService::create_service();
+	for (auto& bond : bonds)
+	{
+		BondProductService::create_service()->Add(bond);
+		PV01<Bond> pv01(bond, 0, 0);
+		riskService->Add(pv01);
+	}
+	RecordingListener recorder(ProductRegistry::create_registry()->Size());
+	riskService->AddListener(&recorder);
+	BondRiskServiceListener* riskListener = BondRiskServiceListener::create_listener();
+
+	// the first rounds inline, on this thread
+	for (int round = 0; round < ROUNDS; ++round)
+	{
+		for (auto& bond : bonds)
+		{
+			Position<Bond> position(bond);
+			riskListener->ProcessAdd(position);
+		}
+	}
+	CheckRecords(bonds, recorder, ROUNDS, "inline");
+	std::cout << "inline risk checked" << std::endl;
+
+	// the next rounds on the shards carry on every product's stream where the inline rounds left it
+	ShardedListener<Position<Bond>> sharded(riskListener, SHARDS);
+	sharded.Start();
+	for (int round = 0; round < ROUNDS; ++round)
+	{
+		for (auto& bond : bonds)
+		{
+			Position<Bond> position(bond);
+			sharded.ProcessAdd(position);
+		}
+	}
+	sharded.Stop();
+	CheckRecords(bonds, recorder, 2 * ROUNDS, "sharded");
+	std::cout << "sharded risk checked" << std::endl;
+
+	if (failures > 0)
+	{
+		std::cout << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
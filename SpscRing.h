@@ -0,0 +1,145 @@
+#pragma once
+//
+//  SpscRing.h
+//  MTH 9815
+//
+
+#ifndef SpscRing_h
+#define SpscRing_h
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <cstddef>
+
+using namespace std;
+
+/**
+* Bounded lock-free ring for exactly one producer thread and one consumer thread.
+* Slots are allocated once up front and reused, so the producer decodes straight into a slot
+* and the consumer reads it in place. Capacity is rounded up to a power of two.
+*/
+template<typename T>
+class SpscRing
+{
+private:
+	// keep the two indices on separate cache lines
+	alignas(64) std::atomic<size_t> head{ 0 };  // next slot to read, owned by the consumer
+	alignas(64) std::atomic<size_t> tail{ 0 };  // next slot to write, owned by the producer
+	alignas(64) std::atomic<bool> closed{ false };
+	size_t mask;
+	std::vector<T> slots;
+
+	// statistics, each written by one side only
+	size_t producerStalls = 0;
+	size_t consumerStalls = 0;
+	size_t maxOccupancy = 0;
+	size_t occupancySum = 0;
+	size_t popCount = 0;
+
+	static size_t RoundUp(size_t n)
+	{
+		size_t size = 2;
+		while (size < n) size <<= 1;
+		return size;
+	};
+
+public:
+	explicit SpscRing(size_t capacity) : mask(RoundUp(capacity) - 1), slots(RoundUp(capacity)) {};
+
+	size_t Capacity() const
+	{
+		return slots.size();
+	};
+
+	// producer: slot to fill, or nullptr if the ring is full
+	T* TryClaim()
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == slots.size()) return nullptr;
+		return &slots[t & mask];
+	};
+
+	// producer: slot to fill, waiting while the ring is full
+	T* Claim()
+	{
+		T* slot = TryClaim();
+		if (slot) return slot;
+		++producerStalls;
+		while (!(slot = TryClaim())) std::this_thread::yield();
+		return slot;
+	};
+
+	// producer: make the claimed slot visible to the consumer
+	void Publish()
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	};
+
+	// producer: no more slots will be published
+	void Close()
+	{
+		closed.store(true, std::memory_order_release);
+	};
+
+	// consumer: oldest published slot, or nullptr if the ring is empty
+	T* TryFront()
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t t = tail.load(std::memory_order_acquire);
+		if (h == t) return nullptr;
+		size_t occupancy = t - h;
+		occupancySum += occupancy;
+		if (occupancy > maxOccupancy) maxOccupancy = occupancy;
+		++popCount;
+		return &slots[h & mask];
+	};
+
+	// consumer: oldest published slot, waiting while the ring is empty, nullptr once closed and drained
+	T* Front()
+	{
+		T* slot = TryFront();
+		if (slot) return slot;
+		++consumerStalls;
+		while (!(slot = TryFront()))
+		{
+			// tail is re-checked after seeing closed so the last slots are not lost
+			if (closed.load(std::memory_order_acquire) && !(slot = TryFront())) return nullptr;
+			if (slot) return slot;
+			std::this_thread::yield();
+		}
+		return slot;
+	};
+
+	// consumer: release the slot returned by Front()
+	void Pop()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	};
+
+	// times the producer found the ring full
+	size_t GetProducerStalls() const
+	{
+		return producerStalls;
+	};
+
+	// times the consumer found the ring empty
+	size_t GetConsumerStalls() const
+	{
+		return consumerStalls;
+	};
+
+	// largest number of filled slots seen by the consumer
+	size_t GetMaxOccupancy() const
+	{
+		return maxOccupancy;
+	};
+
+	// average number of filled slots seen by the consumer
+	double GetAverageOccupancy() const
+	{
+		return popCount ? double(occupancySum) / popCount : 0.0;
+	};
+};
+
+#endif /* SpscRing_h */
@@ -0,0 +1,100 @@
+//
+//  StaticPipelineBenchmark.cpp
+//  MTH 9815
+//
+//  Times a four-hop chain wired with AddListener, one virtual ProcessAdd per hop, against the same chain
+//  composed at compile time as a StaticPipeline behind one PipelineListener.
+//  usage: StaticPipelineBenchmark [messages]
+//
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "soa.hpp"
+
+struct Message
+{
+	int64_t value;
+};
+
+static int64_t checksum = 0;
+
+// end of both chains
+class SinkListener : public ServiceListener<Message>
+{
+public:
+	void ProcessAdd(Message& data) override { checksum += data.value; }
+	void ProcessRemove(Message&) override {}
+	void ProcessUpdate(Message&) override {}
+
+	static SinkListener* create_listener()
+	{
+		static SinkListener listener;
+		return &listener;
+	}
+};
+
+// a hop of the virtual chain, transforms the message and notifies its listeners as the services do
+class HopListener : public ServiceListener<Message>
+{
+private:
+	vector<ServiceListener<Message>*> listeners;
+
+public:
+	void AddListener(ServiceListener<Message>* listener) { listeners.push_back(listener); }
+
+	void ProcessAdd(Message& data) override
+	{
+		Message next = { data.value * 3 + 1 };
+		for (auto& listener : listeners) listener->ProcessAdd(next);
+	}
+	void ProcessRemove(Message&) override {}
+	void ProcessUpdate(Message&) override {}
+};
+
+// the same hop as a stage of the static chain
+struct HopStage
+{
+	template<typename Next>
+	void Process(Message& data, Next& next)
+	{
+		Message out = { data.value * 3 + 1 };
+		next(out);
+	}
+};
+
+typedef PipelineListener<Message, StaticPipeline<HopStage, HopStage, HopStage, HopStage, ListenerStage<SinkListener>>> StaticChain;
+
+// ns per message of messages sent into entry
+static double Time(ServiceListener<Message>* entry, int messages)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < messages; ++i)
+	{
+		Message message = { i };
+		// keep the compiler from folding the chain over the loop counter
+		asm volatile("" : "+r"(message.value));
+		entry->ProcessAdd(message);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+}
+
+int main(int argc, char* argv[])
+{
+	int messages = argc > 1 ? std::atoi(argv[1]) : 50000000;
+
+	HopListener hops[4];
+	for (int i = 0; i < 3; ++i) hops[i].AddListener(&hops[i + 1]);
+	hops[3].AddListener(SinkListener::create_listener());
+
+	for (int run = 0; run < 3; ++run)
+	{
+		double dynamic = Time(&hops[0], messages);
+		double composed = Time(StaticChain::create_listener(), messages);
+		std::cout << "virtual 4 hops " << dynamic << " ns/msg, static pipeline " << composed << " ns/msg" << std::endl;
+	}
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,239 @@
+#pragma once
+//
+//  TickPrice.h
+//  MTH 9815
+//
+
+#ifndef TickPrice_h
+#define TickPrice_h
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <cmath>
+
+using namespace std;
+
+/**
+* Parsing and formatting of US Treasury fractional prices such as "99-16+".
+* The integer part is followed by 32nds (two digits) and 256ths (one digit 0-7, '+' for 4).
+* Prices are handled as integer ticks of 1/256, so 99-16+ is 99 * 256 + 16 * 8 + 4 ticks.
+*/
+
+// number of ticks in one point of par
+const long TICKS_PER_POINT = 256;
+
+// lookup tables indexed by raw characters, -1 marks an invalid character
+struct TickTables
+{
+	// value of a decimal digit
+	std::array<int8_t, 256> digit;
+	// ticks for the trailing 256ths character
+	std::array<int8_t, 256> eighth;
+	// ticks for the two-digit 32nds field, indexed by the two digits as a number 00-99
+	std::array<int16_t, 100> thirtySecond;
+
+	constexpr TickTables() : digit(), eighth(), thirtySecond()
+	{
+		for (int c = 0; c < 256; ++c)
+		{
+			digit[c] = (c >= '0' && c <= '9') ? c - '0' : -1;
+			eighth[c] = (c >= '0' && c <= '7') ? c - '0' : -1;
+		}
+		eighth['+'] = 4;
+		for (int i = 0; i < 100; ++i) thirtySecond[i] = i < 32 ? i * 8 : -1;
+	};
+};
+
+constexpr TickTables tickTables;
+
+// longest integer part ParseTicks accepts, the ticks of any 16-digit price fit in a long
+const size_t MAX_TICK_WHOLE_DIGITS = 16;
+
+// parse a fractional price into ticks, false if the text is not in the expected notation
+inline bool ParseTicks(std::string_view str, long& ticks)
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(str.data());
+	size_t size = str.size();
+	// shortest form is "0-000"
+	if (size < 5 || p[size - 4] != '-') return false;
+
+	// the fraction is always the last three characters
+	int d1 = tickTables.digit[p[size - 3]];
+	int d2 = tickTables.digit[p[size - 2]];
+	int z = tickTables.eighth[p[size - 1]];
+	if ((d1 | d2 | z) < 0) return false;
+	int xy = tickTables.thirtySecond[d1 * 10 + d2];
+	if (xy < 0) return false;
+
+	// integer part in front of the dash, with an optional sign
+	size_t i = 0;
+	bool negative = p[0] == '-';
+	if (negative) ++i;
+	if (i == size - 4 || size - 4 - i > MAX_TICK_WHOLE_DIGITS) return false;
+	long whole = 0;
+	for (; i < size - 4; ++i)
+	{
+		int d = tickTables.digit[p[i]];
+		if (d < 0) return false;
+		whole = whole * 10 + d;
+	}
+
+	ticks = whole * TICKS_PER_POINT + xy + z;
+	if (negative) ticks = -ticks;
+	return true;
+}
+
+// parse a fractional price into a decimal price, 0 if it cannot be parsed
+inline double ParsePrice(std::string_view str)
+{
+	long ticks = 0;
+	if (!ParseTicks(str, ticks)) return 0.0;
+	return ticks / double(TICKS_PER_POINT);
+}
+
+// parse count prices taken every stride fields, e.g. the price columns of a market data row
+// returns false if any of them is malformed, leaving 0 in its slot
+inline bool ParseTicksBatch(const std::string_view* fields, size_t count, size_t stride, long* ticks)
+{
+	bool ok = true;
+	for (size_t i = 0; i < count; ++i)
+	{
+		ticks[i] = 0;
+		ok &= ParseTicks(fields[i * stride], ticks[i]);
+	}
+	return ok;
+}
+
+// largest output of FormatTicks, enough for any long integer part
+const size_t MAX_TICK_PRICE_LENGTH = 24;
+
+// write ticks in fractional notation into buf without allocating, returns the number of characters
+inline size_t FormatTicks(long ticks, char* buf)
+{
+	size_t len = 0;
+	// magnitude in unsigned, which also holds the negation of the smallest long
+	unsigned long magnitude = ticks;
+	if (ticks < 0)
+	{
+		buf[len++] = '-';
+		magnitude = 0UL - magnitude;
+	}
+	unsigned long whole = magnitude / TICKS_PER_POINT;
+	int frac = int(magnitude % TICKS_PER_POINT);
+
+	// integer part, written backwards into a scratch buffer
+	char digits[20];
+	int n = 0;
+	do
+	{
+		digits[n++] = char('0' + whole % 10);
+		whole /= 10;
+	} while (whole > 0);
+	while (n > 0) buf[len++] = digits[--n];
+
+	int xy = frac / 8;
+	int z = frac % 8;
+	buf[len++] = '-';
+	buf[len++] = char('0' + xy / 10);
+	buf[len++] = char('0' + xy % 10);
+	buf[len++] = z == 4 ? '+' : char('0' + z);
+	return len;
+}
+
+// ticks in fractional notation as a string
+inline std::string TicksToString(long ticks)
+{
+	char buf[MAX_TICK_PRICE_LENGTH];
+	return std::string(buf, FormatTicks(ticks, buf));
+}
+
+/**
+* A price held as an integer number of 1/256 ticks.
+* Sums, differences and multiples stay exact; conversion to double is only for reporting and risk maths.
+* The text form is the fractional notation of ParseTicks and FormatTicks.
+*/
+class TickPrice
+{
+private:
+	long ticks;
+
+public:
+	// zero price
+	constexpr TickPrice() : ticks(0) {};
+
+	// price of a number of 1/256 ticks
+	constexpr explicit TickPrice(long _ticks) : ticks(_ticks) {};
+
+	// nearest tick to a decimal price
+	static TickPrice FromDouble(double price)
+	{
+		return TickPrice(std::lround(price * TICKS_PER_POINT));
+	};
+
+	// parse the fractional notation, false if the text is malformed
+	static bool Parse(std::string_view str, TickPrice& price)
+	{
+		return ParseTicks(str, price.ticks);
+	};
+
+	// parse the fractional notation, zero if the text is malformed
+	static TickPrice FromString(std::string_view str)
+	{
+		TickPrice price;
+		if (!Parse(str, price)) price.ticks = 0;
+		return price;
+	};
+
+	// number of 1/256 ticks
+	constexpr long Ticks() const
+	{
+		return ticks;
+	};
+
+	// decimal price
+	constexpr double ToDouble() const
+	{
+		return ticks / double(TICKS_PER_POINT);
+	};
+
+	// write the fractional notation into buf, at least MAX_TICK_PRICE_LENGTH characters, returns the length
+	size_t Format(char* buf) const
+	{
+		return FormatTicks(ticks, buf);
+	};
+
+	// fractional notation as a string
+	std::string ToString() const
+	{
+		return TicksToString(ticks);
+	};
+
+	constexpr TickPrice operator+(TickPrice other) const { return TickPrice(ticks + other.ticks); };
+	constexpr TickPrice operator-(TickPrice other) const { return TickPrice(ticks - other.ticks); };
+	constexpr TickPrice operator-() const { return TickPrice(-ticks); };
+	constexpr TickPrice operator*(long n) const { return TickPrice(ticks * n); };
+	// integer division, rounds towards zero to stay on the tick grid
+	constexpr TickPrice operator/(long n) const { return TickPrice(ticks / n); };
+	TickPrice& operator+=(TickPrice other) { ticks += other.ticks; return *this; };
+	TickPrice& operator-=(TickPrice other) { ticks -= other.ticks; return *this; };
+
+	constexpr bool operator==(TickPrice other) const { return ticks == other.ticks; };
+	constexpr bool operator!=(TickPrice other) const { return ticks != other.ticks; };
+	constexpr bool operator<(TickPrice other) const { return ticks < other.ticks; };
+	constexpr bool operator<=(TickPrice other) const { return ticks <= other.ticks; };
+	constexpr bool operator>(TickPrice other) const { return ticks > other.ticks; };
+	constexpr bool operator>=(TickPrice other) const { return ticks >= other.ticks; };
+
+	// fractional notation, formatted on the stack
+	friend ostream& operator<<(ostream& os, TickPrice price)
+	{
+		char buf[MAX_TICK_PRICE_LENGTH];
+		os.write(buf, price.Format(buf));
+		return os;
+	};
+};
+
+#endif /* TickPrice_h */
@@ -0,0 +1,126 @@
+//
+//  TickPriceTest.cpp
+//  MTH 9815
+//
+//  Checks and times the fractional price parser of TickPrice.h.
+//  usage: TickPriceTest [repeats]
+//    round trips every tick from 0 to 200 * 256 through FormatTicks and ParseTicks, checks malformed and
+//    out-of-range text is rejected, then times the parser against the substr/stoi lambda it replaced
+//    returns 1 if any check fails
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include "TickPrice.h"
+
+// the strToPrice lambda the connectors used before TickPrice.h
+static double LegacyPrice(const std::string& str)
+{
+	int size = str.size();
+	char lstChar = str[size - 1];
+	int lstDigit = lstChar == '+' ? 4 : lstChar - '0';
+	size_t index = str.find_first_of('-');
+	int midDigit = std::stoi(str.substr(index + 1, 2));
+	double firstDigit = std::stoi(str.substr(0, index));
+	return firstDigit + midDigit / 32.0 + lstDigit / 256.0;
+}
+
+static long failures = 0;
+
+static void Check(bool ok, const std::string& what)
+{
+	if (ok) return;
+	if (++failures <= 20) std::cout << "FAILED: " << what << std::endl;
+}
+
+static void RoundTrip()
+{
+	const long lastTick = 200 * TICKS_PER_POINT;
+	for (long t = 0; t <= lastTick; ++t)
+	{
+		std::string text = TicksToString(t);
+		long back = -1;
+		Check(ParseTicks(text, back) && back == t, "round trip of " + text);
+		Check(LegacyPrice(text) == ParsePrice(text), "legacy price of " + text);
+
+		// 4/256 may be spelled as a digit as well as '+'
+		if (t % 8 == 4)
+		{
+			std::string digit = text;
+			digit.back() = '4';
+			Check(ParseTicks(digit, back) && back == t, "digit spelling of " + text);
+		}
+
+		Check(ParseTicks("-" + text, back) && back == -t, "negation of " + text);
+		Check(TicksToString(-t) == (t == 0 ? text : "-" + text), "format of -" + text);
+	}
+	std::cout << "round trip of " << lastTick + 1 << " ticks checked" << std::endl;
+}
+
+static void Rejects()
+{
+	const char* malformed[] = { "", "99", "99-1", "99-32+", "99-008", "9x-001", "99-0a1", "-0-00", "99 001", "--99-001",
+		"12345678901234567-000" };
+	for (const char* text : malformed)
+	{
+		long ticks = 0;
+		Check(!ParseTicks(text, ticks), std::string("accepted malformed ") + text);
+	}
+
+	// the longest integer part accepted, and the extremes of a long formatted without overflow
+	long ticks = 0;
+	Check(ParseTicks("9999999999999999-31+", ticks) && ticks == 9999999999999999L * TICKS_PER_POINT + 31 * 8 + 4, "16-digit price");
+	Check(TicksToString(LONG_MAX) == "36028797018963967-317", "format of LONG_MAX");
+	Check(TicksToString(LONG_MIN) == "-36028797018963968-000", "format of LONG_MIN");
+	std::cout << "malformed and extreme prices checked" << std::endl;
+}
+
+static void Benchmark(int repeats)
+{
+	// every price between 99-00 and 101-00
+	std::vector<std::string> prices;
+	for (long t = 99 * TICKS_PER_POINT; t <= 101 * TICKS_PER_POINT; ++t) prices.push_back(TicksToString(t));
+	std::vector<std::string_view> fields(prices.begin(), prices.end());
+	std::vector<long> ticks(fields.size());
+	double count = double(repeats) * prices.size();
+	double sum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; ++r) for (auto& price : prices) sum += LegacyPrice(price);
+	double legacy = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; ++r) for (auto& field : fields) sum += ParsePrice(field);
+	double table = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; ++r)
+	{
+		ParseTicksBatch(fields.data(), fields.size(), 1, ticks.data());
+		sum += ticks[r % ticks.size()];
+	}
+	double batch = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+
+	std::cout << "substr + stoi lambda " << legacy << " ns/price" << std::endl;
+	std::cout << "ParsePrice           " << table << " ns/price" << std::endl;
+	std::cout << "ParseTicksBatch      " << batch << " ns/price" << std::endl;
+	std::cout << "(checksum " << sum << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int repeats = argc > 1 ? std::atoi(argv[1]) : 400;
+	RoundTrip();
+	Rejects();
+	if (failures > 0)
+	{
+		std::cout << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	Benchmark(repeats);
+	return 0;
+}
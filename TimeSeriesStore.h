@@ -0,0 +1,317 @@
+#pragma once
+//
+//  TimeSeriesStore.h
+//  MTH 9815
+//
+
+#ifndef TimeSeriesStore_h
+#define TimeSeriesStore_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include "HistoricalLog.h"
+#include "FlatHashMap.h"
+
+using namespace std;
+
+/**
+* How much history a TimeSeriesStore keeps.
+*/
+struct HistoryRetention
+{
+	int64_t windowMicros = 24LL * 3600 * 1000000;   // records older than the newest timestamp minus this go, 0 to keep all
+	size_t maxRecords = 1 << 20;                     // records kept per CUSIP at most, 0 for no limit
+
+	HistoryRetention() {};
+	HistoryRetention(int64_t _windowMicros, size_t _maxRecords) : windowMicros(_windowMicros), maxRecords(_maxRecords) {};
+};
+
+/**
+* Fields of a record type that a TimeSeriesStore keeps in columns of their own, as member pointers.
+* A scan of one of them over a time range reads its column alone rather than striding over whole records.
+* None by default; the specializations for the historical records follow TimeSeriesStore.
+*/
+template<typename R>
+struct HistoryColumns
+{
+	static constexpr std::tuple<> fields{};
+};
+
+/**
+* In-memory, append-only history of compact records of type R, one series per CUSIP.
+* A series is a set of columns: the timestamps, which are the index for range and as-of lookups by binary search,
+* one column per field listed in HistoryColumns<R> (prices, sizes, PV01) for ForEachValueInRange scans, and the
+* whole records, which answer GetRange and GetAsOf. Records older than the retention window are dropped from the
+* front, amortized in O(1), but the latest record of every CUSIP is kept so as-of queries still answer for quiet
+* bonds. Timestamps are indexed in arrival order: one older than the previous record of its CUSIP is indexed at
+* the previous timestamp. Not synchronized, query it from the thread that feeds it.
+*/
+template<typename R>
+class TimeSeriesStore
+{
+private:
+	typedef std::decay_t<decltype(HistoryColumns<R>::fields)> Fields;
+	static const size_t COLUMN_COUNT = std::tuple_size<Fields>::value;
+
+	// type of the field a member pointer points to
+	template<typename M>
+	struct FieldType;
+
+	template<typename T, typename C>
+	struct FieldType<T C::*>
+	{
+		typedef T type;
+	};
+
+	// a vector per field
+	template<typename Tuple>
+	struct ColumnVectors;
+
+	template<typename... M>
+	struct ColumnVectors<std::tuple<M...>>
+	{
+		typedef std::tuple<std::vector<typename FieldType<M>::type>...> type;
+	};
+
+	// position of Field in HistoryColumns<R>::fields, COLUMN_COUNT if it is not there
+	template<auto Field, size_t I = 0>
+	static constexpr size_t ColumnOf()
+	{
+		if constexpr (I == COLUMN_COUNT) return I;
+		else if constexpr (std::is_same<std::tuple_element_t<I, Fields>, decltype(Field)>::value)
+		{
+			if (std::get<I>(HistoryColumns<R>::fields) == Field) return I;
+			return ColumnOf<Field, I + 1>();
+		}
+		else return ColumnOf<Field, I + 1>();
+	};
+
+	struct Series
+	{
+		std::vector<int64_t> timestamps;
+		typename ColumnVectors<Fields>::type columns;
+		std::vector<R> records;
+		size_t head = 0;    // first live entry, the ones before it are dropped
+
+		template<size_t... I>
+		void PushColumns(const R& record, std::index_sequence<I...>)
+		{
+			(std::get<I>(columns).push_back(record.*std::get<I>(HistoryColumns<R>::fields)), ...);
+		};
+
+		void Push(int64_t t, const R& record)
+		{
+			timestamps.push_back(t);
+			PushColumns(record, std::make_index_sequence<COLUMN_COUNT>());
+			records.push_back(record);
+		};
+
+		size_t Size() const
+		{
+			return timestamps.size() - head;
+		};
+
+		// first live entry with a timestamp after t
+		size_t UpperBound(int64_t t) const
+		{
+			return size_t(std::upper_bound(timestamps.begin() + head, timestamps.end(), t) - timestamps.begin());
+		};
+
+		// first live entry with a timestamp at or after t
+		size_t LowerBound(int64_t t) const
+		{
+			return size_t(std::lower_bound(timestamps.begin() + head, timestamps.end(), t) - timestamps.begin());
+		};
+
+		// drop entries before index keep, compacting once half the columns are dead
+		void DropBefore(size_t keep)
+		{
+			head = std::max(head, keep);
+			if (head > 0 && head * 2 >= timestamps.size())
+			{
+				timestamps.erase(timestamps.begin(), timestamps.begin() + head);
+				std::apply([this](auto&... column) { (column.erase(column.begin(), column.begin() + head), ...); }, columns);
+				records.erase(records.begin(), records.begin() + head);
+				head = 0;
+			}
+		};
+
+		size_t MemoryBytes() const
+		{
+			size_t bytes = timestamps.capacity() * sizeof(int64_t) + records.capacity() * sizeof(R);
+			std::apply([&bytes](auto&... column) { ((bytes += column.capacity() * sizeof(column[0])), ...); }, columns);
+			return bytes;
+		};
+	};
+
+	// sweep the quiet series every this many appends
+	static const size_t SWEEP_INTERVAL = 4096;
+
+	FlatHashMap<std::string, Series> series;
+	HistoryRetention retention;
+	int64_t newest = 0;
+	uint64_t sequence = 0;
+	size_t appends = 0;
+
+	void Evict(Series& s)
+	{
+		size_t keep = s.head;
+		if (retention.windowMicros > 0) keep = std::max(keep, s.LowerBound(newest - retention.windowMicros));
+		if (retention.maxRecords > 0 && s.timestamps.size() - keep > retention.maxRecords) keep = s.timestamps.size() - retention.maxRecords;
+		// the latest record stays
+		keep = std::min(keep, s.timestamps.size() - 1);
+		if (keep > s.head) s.DropBefore(keep);
+	};
+
+	const Series* Find(std::string_view cusip) const
+	{
+		return series.Find(cusip);
+	};
+
+public:
+	explicit TimeSeriesStore(const HistoryRetention& _retention = HistoryRetention()) : retention(_retention) {};
+
+	// add a record at the end of the series of its CUSIP, its sequence number is the arrival order in the store
+	void Append(R record)
+	{
+		std::string_view cusip = LogField(record.cusip);
+		Series* found = series.Find(cusip);
+		Series& s = found ? *found : series[std::string(cusip)];
+
+		record.header.sequence = sequence++;
+		int64_t t = s.timestamps.empty() ? record.header.timestamp : std::max(record.header.timestamp, s.timestamps.back());
+		s.Push(t, record);
+		newest = std::max(newest, t);
+
+		Evict(s);
+		if (++appends % SWEEP_INTERVAL == 0)
+		{
+			series.ForEach([this](const std::string&, Series& s) { Evict(s); });
+		}
+	};
+
+	// call f(record) for the records of cusip with from <= timestamp <= to, oldest first, returns how many
+	template<typename F>
+	size_t ForEachInRange(std::string_view cusip, int64_t from, int64_t to, F f) const
+	{
+		const Series* s = Find(cusip);
+		if (!s || from > to) return 0;
+		size_t begin = s->LowerBound(from);
+		size_t end = s->UpperBound(to);
+		for (size_t i = begin; i < end; ++i) f(s->records[i]);
+		return end - begin;
+	};
+
+	// call f(timestamp, value) with Field of the records of cusip with from <= timestamp <= to, oldest first, reading
+	// its column alone; Field is one of HistoryColumns<R>::fields, e.g. &StreamingLogRecord::bidPrice
+	template<auto Field, typename F>
+	size_t ForEachValueInRange(std::string_view cusip, int64_t from, int64_t to, F f) const
+	{
+		constexpr size_t column = ColumnOf<Field>();
+		static_assert(column < COLUMN_COUNT, "TimeSeriesStore: the field is not kept in a column of its own");
+		const Series* s = Find(cusip);
+		if (!s || from > to) return 0;
+		size_t begin = s->LowerBound(from);
+		size_t end = s->UpperBound(to);
+		const auto& values = std::get<column>(s->columns);
+		for (size_t i = begin; i < end; ++i) f(s->timestamps[i], values[i]);
+		return end - begin;
+	};
+
+	// records of cusip with from <= timestamp <= to, oldest first
+	std::vector<R> GetRange(std::string_view cusip, int64_t from, int64_t to) const
+	{
+		std::vector<R> records;
+		ForEachInRange(cusip, from, to, [&records](const R& record) { records.push_back(record); });
+		return records;
+	};
+
+	// the latest record of cusip with timestamp <= asOf, false if there is none in the store
+	bool GetAsOf(std::string_view cusip, int64_t asOf, R& record) const
+	{
+		const Series* s = Find(cusip);
+		if (!s) return false;
+		size_t end = s->UpperBound(asOf);
+		if (end == s->head) return false;
+		record = s->records[end - 1];
+		return true;
+	};
+
+	// records kept for cusip
+	size_t Size(std::string_view cusip) const
+	{
+		const Series* s = Find(cusip);
+		return s ? s->Size() : 0;
+	};
+
+	// records kept for all CUSIPs
+	size_t Size() const
+	{
+		size_t size = 0;
+		series.ForEach([&size](const std::string&, const Series& s) { size += s.Size(); });
+		return size;
+	};
+
+	// bytes held by the columns, dropped entries not yet compacted included
+	size_t MemoryBytes() const
+	{
+		size_t bytes = 0;
+		series.ForEach([&bytes](const std::string&, const Series& s) { bytes += s.MemoryBytes(); });
+		return bytes;
+	};
+
+	// CUSIPs with history
+	std::vector<std::string> GetCusips() const
+	{
+		std::vector<std::string> cusips;
+		series.ForEach([&cusips](const std::string& cusip, const Series&) { cusips.push_back(cusip); });
+		std::sort(cusips.begin(), cusips.end());
+		return cusips;
+	};
+
+	// change the retention, applied to all series now
+	void SetRetention(const HistoryRetention& _retention)
+	{
+		retention = _retention;
+		series.ForEach([this](const std::string&, Series& s) { Evict(s); });
+	};
+
+	const HistoryRetention& GetRetention() const
+	{
+		return retention;
+	};
+};
+
+// the fields intraday analytics scan: PV01 and size, prices and sizes
+template<>
+struct HistoryColumns<RiskLogRecord>
+{
+	static constexpr std::tuple<double RiskLogRecord::*, int64_t RiskLogRecord::*> fields{ &RiskLogRecord::pv01, &RiskLogRecord::quantity };
+};
+
+template<>
+struct HistoryColumns<ExecutionLogRecord>
+{
+	static constexpr std::tuple<int64_t ExecutionLogRecord::*, int64_t ExecutionLogRecord::*> fields{ &ExecutionLogRecord::price, &ExecutionLogRecord::visibleQuantity };
+};
+
+template<>
+struct HistoryColumns<StreamingLogRecord>
+{
+	static constexpr std::tuple<int64_t StreamingLogRecord::*, int64_t StreamingLogRecord::*, int64_t StreamingLogRecord::*, int64_t StreamingLogRecord::*> fields{
+		&StreamingLogRecord::bidPrice, &StreamingLogRecord::offerPrice, &StreamingLogRecord::bidVisibleQuantity, &StreamingLogRecord::offerVisibleQuantity };
+};
+
+template<>
+struct HistoryColumns<InquiryLogRecord>
+{
+	static constexpr std::tuple<int64_t InquiryLogRecord::*, int64_t InquiryLogRecord::*> fields{ &InquiryLogRecord::price, &InquiryLogRecord::quantity };
+};
+
+#endif /* TimeSeriesStore_h */
@@ -0,0 +1,128 @@
+//
+//  UringBenchmark.cpp
+//  MTH 9815
+//
+//  Compares the io_uring backend of UringFile.h with the iostream and stdio paths, for writing the historical
+//  outputs and for reading an input file. Linux only.
+//  usage: UringBenchmark [records] [read megabytes] [directory]
+//    writes records 100-byte records under each flush policy through an ofstream, BufferedFileWriter on stdio and
+//    BufferedFileWriter on io_uring, then reads a file of read megabytes with ifstream, mmap and io_uring
+//    write system calls are counted by /proc/self/io (syscw) and, for BufferedFileWriter, by GetSyscalls
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "BufferedFileWriter.h"
+#include "MappedFileReader.h"
+
+// write system calls of this process so far, from /proc/self/io
+static size_t WriteSyscalls()
+{
+	std::ifstream io("/proc/self/io");
+	std::string key;
+	size_t value = 0;
+	while (io >> key >> value)
+	{
+		if (key == "syscw:") return value;
+	}
+	return 0;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// records through an ofstream flushed with std::endl, as the connectors wrote before BufferedFileWriter
+static void WriteIostream(const std::string& path, size_t records, const std::string& line)
+{
+	std::remove(path.c_str());
+	size_t before = WriteSyscalls();
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::ofstream file(path, std::ios_base::app);
+		for (size_t i = 0; i < records; ++i) file << line << std::endl;
+	}
+	double seconds = Seconds(start);
+	std::cout << "  ofstream + endl     " << WriteSyscalls() - before << " write calls, " << seconds << " s" << std::endl;
+}
+
+static void WriteBuffered(const std::string& path, size_t records, const std::string& line, FlushPolicy policy, FileIoBackend io)
+{
+	std::remove(path.c_str());
+	size_t before = WriteSyscalls();
+	size_t syscalls = 0;
+	auto start = std::chrono::steady_clock::now();
+	{
+		BufferedFileWriter writer(path, FlushConfig(policy, io));
+		for (size_t i = 0; i < records; ++i)
+		{
+			writer.Stream() << line << '\n';
+			writer.EndRecord();
+		}
+		writer.Close();
+		syscalls = writer.GetSyscalls();
+	}
+	double seconds = Seconds(start);
+	std::cout << (io == IO_URING ? "  io_uring            " : "  stdio               ") << syscalls << " calls (" << WriteSyscalls() - before
+		<< " syscw), " << seconds << " s" << std::endl;
+}
+
+static void Read(const std::string& path, double megabytes)
+{
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::vector<char> buffer(1 << 20);
+		size_t sum = 0;
+		while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) sum += size_t(buffer[0]) + size_t(file.gcount());
+		std::cout << "  ifstream   " << Seconds(start) << " s, " << megabytes / Seconds(start) << " MB/s (" << sum % 7 << ")" << std::endl;
+	}
+	for (FileIoBackend backend : { IO_DEFAULT, IO_URING })
+	{
+		start = std::chrono::steady_clock::now();
+		MappedFile file(path, backend);
+		// read a byte of every cache line, the tokenizer reads them all
+		size_t sum = 0;
+		for (size_t i = 0; i < file.Size(); i += 64) sum += size_t(file.Data()[i]);
+		double seconds = Seconds(start);
+		std::cout << (backend == IO_URING ? "  io_uring   " : "  mmap       ") << seconds << " s, " << megabytes / seconds << " MB/s (" << sum % 7 << ")" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	size_t readMegabytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+	std::string directory = argc > 3 ? argv[3] : ".";
+	std::string path = directory + "/uring_benchmark.txt";
+	std::cout << "io_uring " << (IoRing::Available() ? "available" : "not available, the io_uring rows fall back to pwrite") << std::endl;
+
+	std::string line(99, 'x');
+	std::cout << records << " records of 100 bytes" << std::endl;
+	WriteIostream(path, records, line);
+	const char* names[] = { "FLUSH_PER_EVENT", "FLUSH_EVERY_N", "FLUSH_INTERVAL", "FLUSH_ON_SHUTDOWN" };
+	for (FlushPolicy policy : { FLUSH_PER_EVENT, FLUSH_EVERY_N, FLUSH_ON_SHUTDOWN })
+	{
+		std::cout << " " << names[policy] << std::endl;
+		WriteBuffered(path, records, line, policy, IO_DEFAULT);
+		WriteBuffered(path, records, line, policy, IO_URING);
+	}
+
+	// a file of readMegabytes to read back, in the page cache after writing it
+	std::remove(path.c_str());
+	{
+		BufferedFileWriter writer(path, FlushConfig(FLUSH_ON_SHUTDOWN));
+		std::string block(1 << 20, 'y');
+		for (size_t i = 0; i < readMegabytes; ++i) writer.Stream() << block;
+	}
+	std::cout << "reading " << readMegabytes << " MB from the page cache" << std::endl;
+	Read(path, double(readMegabytes));
+	std::remove(path.c_str());
+	return 0;
+}
@@ -0,0 +1,606 @@
+#pragma once
+//
+//  UringFile.h
+//  MTH 9815
+//
+
+#ifndef UringFile_h
+#define UringFile_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+using namespace std;
+
+// how the connectors read their input files and write their output files
+// IO_DEFAULT maps the inputs and writes the outputs through stdio, IO_URING queues both on an io_uring
+// and falls back to pread and pwrite where io_uring is not available
+enum FileIoBackend { IO_DEFAULT, IO_URING };
+
+// backend of the input files of the Subscribe() paths, set once at startup
+inline FileIoBackend& InputBackend()
+{
+	static FileIoBackend backend = IO_DEFAULT;
+	return backend;
+}
+
+#ifndef _WIN32
+
+/**
+* Submission and completion queues of one io_uring, used through the raw system calls.
+* Not thread safe: a ring belongs to the one writer or reader that created it.
+*/
+class IoRing
+{
+private:
+#ifdef __linux__
+	int fd = -1;
+	unsigned entries = 0;
+	void* sqRing = nullptr;
+	size_t sqRingBytes = 0;
+	void* cqRing = nullptr;
+	size_t cqRingBytes = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqesBytes = 0;
+
+	unsigned* sqHead = nullptr;
+	unsigned* sqTail = nullptr;
+	unsigned sqMask = 0;
+	unsigned* sqArray = nullptr;
+	unsigned* cqHead = nullptr;
+	unsigned* cqTail = nullptr;
+	unsigned cqMask = 0;
+	io_uring_cqe* cqes = nullptr;
+
+	unsigned tail = 0;        // local submission tail, published by Submit
+	unsigned unsubmitted = 0;
+#endif
+	size_t enters = 0;
+
+public:
+	explicit IoRing(unsigned depth)
+	{
+#ifdef __linux__
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+		fd = int(::syscall(__NR_io_uring_setup, depth, &params));
+		if (fd < 0) return;
+		entries = params.sq_entries;
+
+		sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+		sqRing = ::mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		cqRing = ::mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		void* sqeArea = ::mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeArea == MAP_FAILED)
+		{
+			if (sqRing != MAP_FAILED) ::munmap(sqRing, sqRingBytes);
+			if (cqRing != MAP_FAILED) ::munmap(cqRing, cqRingBytes);
+			if (sqeArea != MAP_FAILED) ::munmap(sqeArea, sqesBytes);
+			sqRing = cqRing = nullptr;
+			::close(fd);
+			fd = -1;
+			return;
+		}
+		sqes = static_cast<io_uring_sqe*>(sqeArea);
+
+		char* sq = static_cast<char*>(sqRing);
+		sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		char* cq = static_cast<char*>(cqRing);
+		cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		tail = *sqTail;
+#endif
+	};
+
+	~IoRing()
+	{
+#ifdef __linux__
+		if (fd < 0) return;
+		::munmap(sqes, sqesBytes);
+		::munmap(cqRing, cqRingBytes);
+		::munmap(sqRing, sqRingBytes);
+		::close(fd);
+#endif
+	};
+
+	IoRing(const IoRing&) = delete;
+	IoRing& operator=(const IoRing&) = delete;
+
+	bool IsOpen() const
+	{
+#ifdef __linux__
+		return fd >= 0;
+#else
+		return false;
+#endif
+	};
+
+	// whether this kernel lets the process create an io_uring, probed once
+	static bool Available()
+	{
+		static const bool available = IoRing(2).IsOpen();
+		return available;
+	};
+
+	// pin the buffers in the kernel so fixed reads and writes skip mapping them on every request
+	bool RegisterBuffers(const iovec* buffers, unsigned count)
+	{
+#ifdef __linux__
+		return fd >= 0 && ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+#else
+		return false;
+#endif
+	};
+
+#ifdef __linux__
+	// next free submission entry, cleared, or nullptr if the queue is full
+	io_uring_sqe* NextEntry()
+	{
+		unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+		if (tail - head >= entries) return nullptr;
+		unsigned index = tail & sqMask;
+		io_uring_sqe* sqe = &sqes[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		sqArray[index] = index;
+		++tail;
+		++unsubmitted;
+		return sqe;
+	};
+#endif
+
+	// hand the queued entries to the kernel and wait for waitFor completions, one system call
+	// false if the kernel refused them, the ring is of no further use then; when it is only short of resources
+	// the entries are left for the next call, after the caller has taken its completions
+	bool Submit(unsigned waitFor = 0)
+	{
+#ifdef __linux__
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+		while (unsubmitted > 0 || waitFor > 0)
+		{
+			int done = int(::syscall(__NR_io_uring_enter, fd, unsubmitted, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+			++enters;
+			if (done < 0)
+			{
+				if (errno == EINTR) continue;
+				return errno == EAGAIN || errno == EBUSY;
+			}
+			unsubmitted -= std::min<unsigned>(unsubmitted, unsigned(done));
+			waitFor = 0;
+		}
+		return true;
+#else
+		return false;
+#endif
+	};
+
+	// wait for waitFor completions without handing the kernel any queued entries, false if io_uring_enter fails
+	bool Wait(unsigned waitFor)
+	{
+#ifdef __linux__
+		while (true)
+		{
+			int done = int(::syscall(__NR_io_uring_enter, fd, 0, waitFor, IORING_ENTER_GETEVENTS, nullptr, 0));
+			++enters;
+			if (done >= 0) return true;
+			if (errno != EINTR) return false;
+		}
+#else
+		return false;
+#endif
+	};
+
+	// entries queued that the kernel has not taken yet, they complete only after another Submit
+	unsigned GetUnsubmitted() const
+	{
+#ifdef __linux__
+		return unsubmitted;
+#else
+		return 0;
+#endif
+	};
+
+	// take the oldest completion, false if there is none yet
+	bool NextCompletion(uint64_t& userData, int& result)
+	{
+#ifdef __linux__
+		unsigned head = *cqHead;
+		if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+		const io_uring_cqe& cqe = cqes[head & cqMask];
+		userData = cqe.user_data;
+		result = cqe.res;
+		__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+		return true;
+#else
+		return false;
+#endif
+	};
+
+	// io_uring_enter calls so far
+	size_t GetEnters() const
+	{
+		return enters;
+	};
+};
+
+/**
+* Append-only file written through an io_uring.
+* The writer owns depth buffers, registered with the ring when the memory lock limit allows it. The caller fills
+* Buffer() and calls Write(), which queues the buffer as one write at the end of the file and moves on to the next
+* buffer; the caller only waits when all buffers are still being written. Writes land in order because each one
+* carries its own file offset. Short or failed writes are finished with pwrite, and without io_uring every Write()
+* is a pwrite; when io_uring_enter itself fails the queued buffers are finished with pwrite and the ring is dropped.
+* Bytes count as written once they are in the file, bytes pwrite could not write either are counted as dropped and
+* the next write goes to the real end of the file.
+*/
+class UringFileWriter
+{
+private:
+	int fd = -1;
+	std::unique_ptr<IoRing> ring;
+	bool registered = false;
+	size_t bufferBytes;
+	unsigned depth;
+	std::unique_ptr<char[]> block;      // depth buffers back to back
+	std::vector<size_t> lengths;
+	std::vector<uint64_t> offsets;
+	std::vector<bool> busy;
+	unsigned current = 0;
+	unsigned inFlight = 0;
+	uint64_t offset = 0;
+	size_t pwrites = 0;
+	size_t ringEnters = 0;              // io_uring_enter calls of a ring that was dropped
+	size_t written = 0;
+	size_t dropped = 0;
+	bool failed = false;                // some bytes were dropped, offset is taken from the file once nothing is in flight
+
+	char* BufferAt(unsigned index)
+	{
+		return block.get() + index * bufferBytes;
+	};
+
+	// write bytes synchronously, retrying short writes, returns the bytes written
+	size_t WriteAt(const char* data, size_t size, uint64_t at)
+	{
+		size_t total = 0;
+		while (size > 0)
+		{
+			ssize_t done = ::pwrite(fd, data, size, off_t(at));
+			++pwrites;
+			if (done <= 0)
+			{
+				if (done < 0 && errno == EINTR) continue;
+				break;
+			}
+			data += done;
+			size -= size_t(done);
+			at += size_t(done);
+			total += size_t(done);
+		}
+		return total;
+	};
+
+	// count a buffer the kernel wrote done bytes of, finishing the rest with pwrite
+	void Finish(unsigned index, size_t done)
+	{
+		if (done < lengths[index]) done += WriteAt(BufferAt(index) + done, lengths[index] - done, offsets[index] + done);
+		written += done;
+		if (done < lengths[index])
+		{
+			dropped += lengths[index] - done;
+			failed = true;
+		}
+		busy[index] = false;
+		--inFlight;
+	};
+
+	// retire the finished writes without waiting
+	void Reap()
+	{
+		uint64_t index;
+		int result;
+		while (ring->NextCompletion(index, result)) Finish(unsigned(index), result > 0 ? size_t(result) : 0);
+	};
+
+	// io_uring_enter failed: finish the buffers still queued with pwrite and write without the ring from now on
+	void DropRing()
+	{
+		Reap();
+		for (unsigned i = 0; i < depth; ++i)
+		{
+			if (busy[i]) Finish(i, 0);
+		}
+		ringEnters += ring->GetEnters();
+		ring.reset();
+		registered = false;
+	};
+
+public:
+	UringFileWriter(const std::string& path, size_t _bufferBytes, unsigned _depth = 4) :
+		bufferBytes(std::max<size_t>(1, _bufferBytes)), depth(std::max(1u, _depth)), block(new char[bufferBytes * depth]),
+		lengths(depth, 0), offsets(depth, 0), busy(depth, false)
+	{
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+		if (fd < 0) return;
+		// append to what is there, the offsets are tracked here from now on
+		offset = uint64_t(::lseek(fd, 0, SEEK_END));
+		if (!IoRing::Available()) return;
+		ring.reset(new IoRing(depth));
+		if (!ring->IsOpen())
+		{
+			ring.reset();
+			return;
+		}
+		std::vector<iovec> buffers(depth);
+		for (unsigned i = 0; i < depth; ++i) buffers[i] = iovec{ BufferAt(i), bufferBytes };
+		registered = ring->RegisterBuffers(buffers.data(), depth);
+	};
+
+	~UringFileWriter()
+	{
+		Drain();
+		if (fd >= 0) ::close(fd);
+	};
+
+	UringFileWriter(const UringFileWriter&) = delete;
+	UringFileWriter& operator=(const UringFileWriter&) = delete;
+
+	bool IsOpen() const
+	{
+		return fd >= 0;
+	};
+
+	// whether writes go through io_uring, and with registered buffers
+	bool UsesRing() const
+	{
+		return ring != nullptr;
+	};
+
+	bool UsesRegisteredBuffers() const
+	{
+		return registered;
+	};
+
+	// buffer to fill for the next Write
+	char* Buffer()
+	{
+		return BufferAt(current);
+	};
+
+	size_t BufferBytes() const
+	{
+		return bufferBytes;
+	};
+
+	// queue the first size bytes of Buffer() at the end of the file, Buffer() is another buffer afterwards
+	void Write(size_t size)
+	{
+		if (fd < 0 || size == 0) return;
+#ifdef __linux__
+		io_uring_sqe* sqe = ring ? ring->NextEntry() : nullptr;
+#else
+		void* sqe = nullptr;
+#endif
+		if (!sqe)
+		{
+			// what could not be written is left out, the next write carries on where this one stopped
+			size_t done = WriteAt(Buffer(), size, offset);
+			written += done;
+			dropped += size - done;
+			offset += done;
+			return;
+		}
+
+#ifdef __linux__
+		sqe->opcode = registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+		sqe->fd = fd;
+		sqe->addr = reinterpret_cast<uint64_t>(Buffer());
+		sqe->len = unsigned(size);
+		sqe->off = offset;
+		sqe->buf_index = registered ? uint16_t(current) : 0;
+		sqe->user_data = current;
+#endif
+		lengths[current] = size;
+		offsets[current] = offset;
+		busy[current] = true;
+		++inFlight;
+		offset += size;
+
+		// submit, and when the next buffer is still being written wait for it in the same system call
+		current = (current + 1) % depth;
+		Reap();
+		bool submitted = ring->Submit(busy[current] ? 1 : 0);
+		if (submitted) Reap();
+		while (submitted && busy[current])
+		{
+			submitted = ring->Submit(1);
+			if (submitted) Reap();
+		}
+		if (!submitted) DropRing();
+		if (failed) Drain();
+	};
+
+	// wait until every queued write is in the file
+	void Drain()
+	{
+		if (ring)
+		{
+			Reap();
+			while (inFlight > 0)
+			{
+				if (!ring->Submit(1))
+				{
+					DropRing();
+					break;
+				}
+				Reap();
+			}
+		}
+		// a dropped write left the file shorter than the offsets handed out, carry on from where it really ends
+		struct stat st;
+		if (failed && ::fstat(fd, &st) == 0) offset = uint64_t(st.st_size);
+		failed = false;
+	};
+
+	// offset in the file of the next Write, the queued writes included
+	uint64_t GetOffset() const
+	{
+		return offset;
+	};
+
+	// bytes in the file so far, and bytes given up on because even pwrite could not write them
+	size_t GetBytesWritten() const
+	{
+		return written;
+	};
+
+	size_t GetDroppedBytes() const
+	{
+		return dropped;
+	};
+
+	// system calls made for writing so far
+	size_t GetSyscalls() const
+	{
+		return pwrites + ringEnters + (ring ? ring->GetEnters() : 0);
+	};
+};
+
+/**
+* Read a whole file into out, size bytes, with up to depth reads of chunkBytes in flight on an io_uring, so the
+* device works on the next chunks while earlier ones complete. The buffer is left uninitialized before the reads,
+* the kernel fills it directly. Falls back to pread without io_uring. Returns false if the file cannot be opened.
+*/
+inline bool ReadFileAhead(const std::string& path, std::unique_ptr<char[]>& out, size_t& size, size_t chunkBytes = 1 << 20, unsigned depth = 8)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (::fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	size = size_t(st.st_size);
+	out.reset(new char[std::max<size_t>(1, size)]);
+	chunkBytes = std::max<size_t>(4096, chunkBytes);
+
+	// read [from, end of its chunk) synchronously, a file that shrank while being read is cut where it ended
+	size_t available = size;
+	auto readChunk = [&](size_t from) {
+		size_t end = std::min(size, (from / chunkBytes + 1) * chunkBytes);
+		while (from < end)
+		{
+			ssize_t done = ::pread(fd, out.get() + from, end - from, off_t(from));
+			if (done < 0 && errno == EINTR) continue;
+			if (done <= 0)
+			{
+				available = std::min(available, from);
+				return;
+			}
+			from += size_t(done);
+		}
+	};
+
+	std::unique_ptr<IoRing> ring;
+	if (IoRing::Available()) ring.reset(new IoRing(depth));
+	if (!ring || !ring->IsOpen())
+	{
+		for (size_t from = 0; from < size; from += chunkBytes) readChunk(from);
+		::close(fd);
+		size = available;
+		return true;
+	}
+
+#ifdef __linux__
+	// a request is identified by its offset, it ends at the end of its chunk
+	std::vector<size_t> pending;
+	size_t next = 0;
+	unsigned inFlight = 0;
+	while (next < size || !pending.empty() || inFlight > 0)
+	{
+		while ((next < size || !pending.empty()) && inFlight < depth)
+		{
+			io_uring_sqe* sqe = ring->NextEntry();
+			if (!sqe) break;
+			size_t from = next;
+			if (!pending.empty())
+			{
+				from = pending.back();
+				pending.pop_back();
+			}
+			else next = std::min(size, (next / chunkBytes + 1) * chunkBytes);
+			size_t end = std::min(size, (from / chunkBytes + 1) * chunkBytes);
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = fd;
+			sqe->addr = reinterpret_cast<uint64_t>(out.get() + from);
+			sqe->len = unsigned(end - from);
+			sqe->off = from;
+			sqe->user_data = from;
+			++inFlight;
+		}
+		if (!ring->Submit(1))
+		{
+			// the ring is broken: wait for the reads the kernel has taken so none of them writes into out after it
+			// is handed back, then read the whole file synchronously
+			unsigned queued = inFlight - ring->GetUnsubmitted();
+			bool drained = true;
+			uint64_t at;
+			int result;
+			while (queued > 0 && drained)
+			{
+				if (ring->NextCompletion(at, result)) --queued;
+				else drained = ring->Wait(1);
+			}
+			if (!drained)
+			{
+				// reads may still land in the buffer whenever they complete, leave it to them and read into a new one
+				out.release();
+				out.reset(new char[std::max<size_t>(1, size)]);
+			}
+			for (size_t from = 0; from < size; from += chunkBytes) readChunk(from);
+			break;
+		}
+
+		uint64_t from;
+		int result;
+		while (ring->NextCompletion(from, result))
+		{
+			--inFlight;
+			size_t end = std::min(size, (from / chunkBytes + 1) * chunkBytes);
+			if (result > 0 && from + size_t(result) < end) pending.push_back(from + size_t(result));
+			else if (result <= 0) readChunk(size_t(from));
+		}
+	}
+#endif
+	::close(fd);
+	size = available;
+	return true;
+}
+
+#endif
+
+#endif /* UringFile_h */
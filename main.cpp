@@ -14,20 +14,16 @@
 #include "GeneratePriceFile.h"
 #include "GenerateMarketDataFile.h"
 #include "GenerateInquiryFile.h"
+#include "BondReplayEngine.h"
+#include "AsyncListener.h"
+#include "ShardedListener.h"
+#include "EventBatch.h"
 
 /****************** function for initialization *************************/
 void initialize_bondMap() 
 {
 
-	Bond bonds[] =
-	{
-		Bond(cusips[0], BondIdType::CUSIP, "T", 0.002100, date(2019,12,28)),
-		Bond(cusips[1], BondIdType::CUSIP, "T", 0.002600, date(2020,12,28)),
-		Bond(cusips[2], BondIdType::CUSIP, "T", 0.002900, date(2022,12,28)),
-		Bond(cusips[3], BondIdType::CUSIP, "T", 0.003500, date(2024,12,28)),
-		Bond(cusips[4], BondIdType::CUSIP, "T", 0.003800, date(2027,12,18)),
-		Bond(cusips[5], BondIdType::CUSIP, "T", 0.005000, date(2047,12,28))
-	};
+	std::vector<Bond> bonds = default_bonds();
 
 	auto BondProdServ = BondProductService::create_service();
 	auto BondPositionServ = BondPositionService::create_service();
@@ -47,6 +43,145 @@ void initialize_bondMap()
 	std::cout << "Finished the initializing..." << std::endl;
 };
 
+/****************** function for reading input files *******************/
+// how the connectors read their input files:
+// SEQUENTIAL parses and processes on one thread, PIPELINED parses on a second thread feeding a ring buffer,
+// PARALLEL parses chunks of the file on all cores and delivers them in file order
+// REPLAY merges all four files by timestamp and paces them with replayMode and replaySpeed
+// BINARY streams the order books from input/marketdata.bin, converted again whenever it is missing, not readable or
+// older than marketdata.txt, and reads the other three files as SEQUENTIAL
+enum IngestMode { SEQUENTIAL, PIPELINED, PARALLEL, REPLAY, BINARY };
+const IngestMode ingestMode = SEQUENTIAL;
+const ReplayMode replayMode = AS_FAST_AS_POSSIBLE;
+const double replaySpeed = 1.0;
+// IO_DEFAULT maps the input files, IO_URING reads them ahead on an io_uring (pread where it is not available)
+const FileIoBackend inputBackend = IO_DEFAULT;
+
+// when the historical connectors write their buffered records to the output files, through stdio or io_uring
+const FlushConfig historicalFlush = FlushConfig(FLUSH_EVERY_N, IO_DEFAULT);
+// legacy text files, binary logs (read them back with HistoricalLogTool) or both
+const HistoricalFormat historicalFormat = TEXT_LOG;
+// cut the historical outputs into indexed segments (output/risk.000000.txt, .bin, ...), RotationConfig() to keep one file
+const RotationConfig historicalRotation = RotationConfig();
+// write the historical data on a background thread with group commits instead of inline
+const bool asyncPersistence = false;
+const PersistConfig persistConfig = PersistConfig(1 << 16, OVERFLOW_BLOCK);
+// history kept in memory per CUSIP by the historical services for GetHistory and GetHistoryAsOf
+const HistoryRetention historyRetention = HistoryRetention(8LL * 3600 * 1000000, 1 << 16);
+// drop price streams that repeat the last persisted one of their CUSIP, still writing one per maxStalenessMicros
+const ConflationConfig streamingConflation = ConflationConfig(false, 1000000);
+// write the binary logs per-CUSIP delta compressed (output/*.bhd, read them back with HistoricalLogTool)
+const bool compressHistory = false;
+// keep the binary streaming log in memory-mapped journal segments (output/streaming.journal.*) instead of streaming.bin
+const bool streamingJournal = false;
+const JournalConfig journalConfig = JournalConfig(64 << 20, SYNC_INTERVAL);
+// run the streaming chain as a StaticPipeline fused at compile time instead of through virtual listeners
+const bool staticStreamingPipeline = false;
+// how each hop of the execution chain is called: INLINE on the thread of the service before it, ASYNC through a
+// queue of hopQueueCapacity events to a worker thread running the services after it
+enum HopMode { INLINE, ASYNC };
+const HopMode algoExecutionHop = INLINE;        // market data -> algo execution
+const HopMode executionHop = INLINE;            // algo execution -> execution
+const HopMode historicalExecutionHop = INLINE;  // execution -> historical execution
+const size_t hopQueueCapacity = 1 << 12;
+// run the position and risk services, and the algo streaming and streaming services, on serviceShards worker threads
+// each with the CUSIPs split between them, their historical services on one more; 0 runs them inline. The streaming
+// chain is not sharded when staticStreamingPipeline is set
+const size_t serviceShards = 0;
+// events passed through the services at a time: the input connectors hand their services eventBatchSize events per
+// OnMessageBatch, and the historical services persist eventBatchSize records per write, applying the flush policy
+// once per batch. 1 passes every event on by itself; larger batches make fewer calls and flushes but hold events back
+const size_t eventBatchSize = 1;
+
+// the async hops started by hop, in wiring order
+std::vector<AsyncHop*>& asyncHops()
+{
+	static std::vector<AsyncHop*> hops;
+	return hops;
+};
+
+// listener to add for a hop: listener itself, or an AsyncListener running it on a worker thread
+template<typename V>
+ServiceListener<V>* hop(ServiceListener<V>* listener, HopMode mode)
+{
+	if (mode == INLINE) return listener;
+	AsyncListener<V>* async = new AsyncListener<V>(listener, hopQueueCapacity);
+	async->Start();
+	asyncHops().push_back(async);
+	return async;
+};
+
+// the batching listeners made by batch, flushed once the threads feeding them are done
+std::vector<std::function<void()>>& batchFlushes()
+{
+	static std::vector<std::function<void()>> flushes;
+	return flushes;
+};
+
+// listener to add in front of a historical service: listener itself, or a BatchingListener of eventBatchSize events
+template<typename V>
+ServiceListener<V>* batch(ServiceListener<V>* listener)
+{
+	if (eventBatchSize <= 1) return listener;
+	BatchingListener<V>* batching = new BatchingListener<V>(listener, eventBatchSize);
+	batchFlushes().push_back([batching]() { batching->Flush(); });
+	return batching;
+};
+
+// listener to add in front of the services to shard: listener itself, or a ShardedListener running it on serviceShards threads
+template<typename V>
+ServiceListener<V>* shard(ServiceListener<V>* listener)
+{
+	if (serviceShards == 0) return listener;
+	ShardedListener<V>* sharded = new ShardedListener<V>(listener, serviceShards, hopQueueCapacity);
+	sharded->Start();
+	asyncHops().push_back(sharded);
+	return sharded;
+};
+
+// listener to add in front of a service shared by the shards: listener itself, or a MergeListener running it on one thread
+template<typename V>
+ServiceListener<V>* merge(ServiceListener<V>* listener)
+{
+	if (serviceShards == 0) return listener;
+	MergeListener<V>* merged = new MergeListener<V>(listener, hopQueueCapacity);
+	merged->Start();
+	asyncHops().push_back(merged);
+	return merged;
+};
+
+// only market data has a binary input file, the other connectors read their text files
+template<typename C>
+void subscribe_binary(C* connector)
+{
+	connector->Subscribe();
+};
+
+void subscribe_binary(BondMarketDataConnector* connector)
+{
+	const std::string txtPath = "input/marketdata.txt";
+	const std::string binPath = "input/marketdata.bin";
+	if (!MarketDataFileIsCurrent(txtPath, binPath) && convert_marketdata(txtPath, binPath) == 0)
+	{
+		// nothing to stream the books from, read the text file instead
+		connector->Subscribe();
+		return;
+	}
+	connector->SubscribeBinary(binPath);
+};
+
+template<typename C>
+void subscribe(C* connector)
+{
+	switch (ingestMode)
+	{
+	case PIPELINED: connector->SubscribePipelined(); break;
+	case PARALLEL: connector->SubscribeParallel(); break;
+	case BINARY: subscribe_binary(connector); break;
+	default: connector->Subscribe();
+	}
+};
+
 /************************** Main Function *******************************/
 int main()
 {
@@ -60,13 +195,19 @@ int main()
 	generate_marketdata();
 	// generate inquiries.txt file
 	generate_inquiry();
+	InputBackend() = inputBackend;
+	BondTradeBookingConnector::create_connector()->SetBatchSize(eventBatchSize);
+	BondMarketDataConnector::create_connector()->SetBatchSize(eventBatchSize);
+	BondPricingConnector::create_connector()->SetBatchSize(eventBatchSize);
+	BondInquiryConnector::create_connector()->SetBatchSize(eventBatchSize);
 
 	// BondTradeBookingService -> BondPositionService -> BondRiskService -> BondHisRiskService
 	// connect BondTradeBookingService with BondPositionService 
 	auto BondTradeBookingServConn = BondTradeBookingConnector::create_connector();
 	auto BondTradeBookingServ = BondTradeBookingServConn->GetService();
 	auto BondPosServListener = BondPositionServiceListener::create_listener();
-	BondTradeBookingServ->AddListener(BondPosServListener);
+	auto BondPosServHop = shard<Trade<Bond>>(BondPosServListener);
+	BondTradeBookingServ->AddListener(BondPosServHop);
 	// connect BondRiskService with BondRiskService 
 	auto BondPosServ = BondPosServListener->GetService();
 	auto BondRiskServListener = BondRiskServiceListener::create_listener();
@@ -74,53 +215,162 @@ int main()
 	auto BondRiskServ = BondRiskServListener->GetService();
 	// connect BondHisRiskService with BondRiskService
 	auto BondHisRiskServListener = BondHisRiskServiceListener::create_listener();
-	BondRiskServ->AddListener(BondHisRiskServListener);
-	// output risk data
-	BondTradeBookingServConn->Subscribe();
+	BondRiskServ->AddListener(merge<PV01<Bond>>(batch<PV01<Bond>>(BondHisRiskServListener)));
 
 	// BondMarketDataService -> BondAlgoExecutionService -> BondExecutionService -> BondHisExecutionService
 	// connect BondAlgoExecutionService with BondMarketDataService
 	auto BondMarketDataServConn = BondMarketDataConnector::create_connector();
 	auto BondMarketDataServ = BondMarketDataServConn->GetService();
 	auto BondAlgoExeServListener = BondAlgoExecutionServiceListener::create_listener();
-	BondMarketDataServ->AddListener(BondAlgoExeServListener);
+	BondMarketDataServ->AddListener(hop<OrderBook<Bond>>(BondAlgoExeServListener, algoExecutionHop));
 	auto BondAlgoExeServ = BondAlgoExeServListener->GetService();
 	// connect BondExecutionService with BondAlgoExecutionService
 	auto BondExeServListener = BondExecutionServiceListener::create_listener();
-	BondAlgoExeServ->AddListener(BondExeServListener);
+	BondAlgoExeServ->AddListener(hop<BondAlgoExecution>(BondExeServListener, executionHop));
 	auto BondExeServ = BondExeServListener->GetService();
 	// connect BondHisExecutionService with BondExecutionService
 	auto BondHisExeServListener = BondHisExecutionServiceListener::create_listener();
-	BondExeServ->AddListener(BondHisExeServListener);
-	// output execution data
-	BondMarketDataServConn->Subscribe();
+	BondExeServ->AddListener(hop<ExecutionOrder<Bond>>(batch<ExecutionOrder<Bond>>(BondHisExeServListener), historicalExecutionHop));
 
 	// BondPricingService -> BondAlgoStreamingService -> BondStreamingService -> BondHisStreamingService
 	// connect BondAlgoStreamingService with BondPricingService
 	auto BondPrServConn = BondPricingConnector::create_connector();
 	auto BondPrServ = BondPrServConn->GetService();
-	auto BondAlStreamServListener = BondAlgoStreamingServiceListener::create_listener();
-	BondPrServ->AddListener(BondAlStreamServListener);
-	auto BondAlStreamServ = BondAlStreamServListener->GetService();
-	// connect BondStreamingService with BondAlgoStreamingService
-	auto BondStreamServListener = BondStreamingServiceListener::create_listener();
-	BondAlStreamServ->AddListener(BondStreamServListener);
-	auto BondStreamServ = BondStreamServListener->GetService();
-	// connect BondHisStreamingService with BondStreamingService
-	auto BondHisStreamServListener = BondHisStreamingServiceListener::create_listener();
-	BondStreamServ->AddListener(BondHisStreamServListener);
-	// output streaming data
-	BondPrServConn->Subscribe();
+	if (staticStreamingPipeline)
+	{
+		// the same chain wired at compile time, one virtual call per price
+		typedef StaticPipeline<BondAlgoStreamingStage, BondStreamingStage, ListenerStage<BondHisStreamingServiceListener>> StreamingPipeline;
+		BondPrServ->AddListener(PipelineListener<Price<Bond>, StreamingPipeline>::create_listener());
+	}
+	else
+	{
+		auto BondAlStreamServListener = BondAlgoStreamingServiceListener::create_listener();
+		BondPrServ->AddListener(shard<Price<Bond>>(BondAlStreamServListener));
+		auto BondAlStreamServ = BondAlStreamServListener->GetService();
+		// connect BondStreamingService with BondAlgoStreamingService
+		auto BondStreamServListener = BondStreamingServiceListener::create_listener();
+		BondAlStreamServ->AddListener(BondStreamServListener);
+		auto BondStreamServ = BondStreamServListener->GetService();
+		// connect BondHisStreamingService with BondStreamingService
+		auto BondHisStreamServListener = BondHisStreamingServiceListener::create_listener();
+		BondStreamServ->AddListener(merge<PriceStream<Bond>>(batch<PriceStream<Bond>>(BondHisStreamServListener)));
+	}
 
 	// BondInquiryService -> BondHisInquiryService
 	// connect BondHisInquiryService with BondInquiryService
 	auto BondInqServConn = BondInquiryConnector::create_connector();
 	auto BondInqServ = BondInqServConn->GetService();
 	auto BondHisInqServListener = BondHisInquiryServiceListener::create_listener();
-	BondInqServ->AddListener(BondHisInqServListener);
-	// output inquiry data
-	BondInqServConn->Subscribe();
+	BondInqServ->AddListener(batch<Inquiry<Bond>>(BondHisInqServListener));
+
+	// keep the output files open and buffered for the whole run
+	BondHisRiskConnector::create_connector()->SetFlushConfig(historicalFlush);
+	BondHisExecutionConnector::create_connector()->SetFlushConfig(historicalFlush);
+	BondHisStreamingConnector::create_connector()->SetFlushConfig(historicalFlush);
+	BondHisInquiryConnector::create_connector()->SetFlushConfig(historicalFlush);
+	BondHisRiskConnector::create_connector()->SetFormat(historicalFormat);
+	BondHisExecutionConnector::create_connector()->SetFormat(historicalFormat);
+	BondHisStreamingConnector::create_connector()->SetFormat(historicalFormat);
+	BondHisInquiryConnector::create_connector()->SetFormat(historicalFormat);
+	if (historicalRotation.Enabled())
+	{
+		BondHisRiskConnector::create_connector()->SetRotation(historicalRotation);
+		BondHisExecutionConnector::create_connector()->SetRotation(historicalRotation);
+		BondHisStreamingConnector::create_connector()->SetRotation(historicalRotation);
+		BondHisInquiryConnector::create_connector()->SetRotation(historicalRotation);
+		BondHisRiskConnector::create_connector()->SetLogBackend(new SegmentedLogWriter<RiskLogRecord>("output/risk", historicalRotation, historicalFlush));
+		BondHisExecutionConnector::create_connector()->SetLogBackend(new SegmentedLogWriter<ExecutionLogRecord>("output/execution", historicalRotation, historicalFlush));
+		BondHisStreamingConnector::create_connector()->SetLogBackend(new SegmentedLogWriter<StreamingLogRecord>("output/streaming", historicalRotation, historicalFlush));
+		BondHisInquiryConnector::create_connector()->SetLogBackend(new SegmentedLogWriter<InquiryLogRecord>("output/allinquiries", historicalRotation, historicalFlush));
+	}
+	if (compressHistory)
+	{
+		BondHisRiskConnector::create_connector()->SetLogBackend(new DeltaLogWriter<RiskLogRecord>("output/risk.bhd", historicalFlush));
+		BondHisExecutionConnector::create_connector()->SetLogBackend(new DeltaLogWriter<ExecutionLogRecord>("output/execution.bhd", historicalFlush));
+		BondHisStreamingConnector::create_connector()->SetLogBackend(new DeltaLogWriter<StreamingLogRecord>("output/streaming.bhd", historicalFlush));
+		BondHisInquiryConnector::create_connector()->SetLogBackend(new DeltaLogWriter<InquiryLogRecord>("output/allinquiries.bhd", historicalFlush));
+	}
+	if (streamingJournal)
+	{
+		BondHisStreamingConnector::create_connector()->SetLogBackend(new MappedJournal<StreamingLogRecord>("output/streaming.journal", journalConfig));
+	}
+
+	BondHisRiskService::create_service()->SetHistoryRetention(historyRetention);
+	BondHisExecutionService::create_service()->SetHistoryRetention(historyRetention);
+	BondHisStreamingService::create_service()->SetHistoryRetention(historyRetention);
+	BondHisInquiryService::create_service()->SetHistoryRetention(historyRetention);
+	BondHisStreamingService::create_service()->SetConflation(streamingConflation);
+
+	AsyncPersister* persister = nullptr;
+	if (asyncPersistence)
+	{
+		persister = AsyncPersister::create_persister(persistConfig);
+		persister->Start();
+		BondHisRiskService::create_service()->SetPersister(persister);
+		BondHisExecutionService::create_service()->SetPersister(persister);
+		BondHisStreamingService::create_service()->SetPersister(persister);
+		BondHisInquiryService::create_service()->SetPersister(persister);
+	}
+
+	if (ingestMode == REPLAY)
+	{
+		// output all data from one time-ordered stream
+		BondReplayEngine engine;
+		engine.AddDefaultSources();
+		engine.Run(replayMode, replaySpeed);
+	}
+	else
+	{
+		// output risk data
+		subscribe(BondTradeBookingServConn);
+		// output execution data
+		subscribe(BondMarketDataServConn);
+		// output streaming data
+		subscribe(BondPrServConn);
+		// output inquiry data
+		subscribe(BondInqServConn);
+	}
+
+	// bucketed risk merged from the shards, each adding up the bonds it owns
+	if (serviceShards > 0)
+	{
+		auto sharded = dynamic_cast<ShardedListener<Trade<Bond>>*>(BondPosServHop);
+		BucketedSector<Bond> allBonds(default_bonds(), "All");
+		double pv01 = sharded->Reduce(0.0, [&](size_t shard)
+		{
+			return BondRiskServ->GetBucketedRisk(allBonds, [&](ProductIndex index) { return sharded->ShardOf(index) == shard; });
+		});
+		std::cout << "Bucketed risk of all bonds over " << sharded->GetShardCount() << " shards: " << pv01 << std::endl;
+	}
+
+	// deliver the events left in the hops, upstream first so each drains into the next
+	for (auto async : asyncHops()) async->Stop();
+	for (auto& flush : batchFlushes()) flush();
+
+	// drain the persistence queue
+	if (persister)
+	{
+		persister->Stop();
+		std::cout << "Persistence " << persister->GetStats() << std::endl;
+	}
+
+	if (streamingConflation.enabled)
+	{
+		const RecordConflator<StreamingLogRecord>& conflator = BondHisStreamingService::create_service()->GetConflator();
+		std::cout << "Streaming conflation: " << conflator.GetAdmitted() << " persisted, " << conflator.GetSuppressed()
+			<< " suppressed, " << conflator.GetHeartbeats() << " heartbeats" << std::endl;
+	}
+
+	// rows of the input files left out for a CUSIP failing its check digit
+	if (RejectedSecurityRows() > 0) std::cout << "Input rows rejected for a bad CUSIP: " << RejectedSecurityRows() << std::endl;
+	// and for a quantity, price or timestamp that is not a number
+	if (RejectedFieldRows() > 0) std::cout << "Input rows rejected for a malformed number: " << RejectedFieldRows() << std::endl;
 
+	// make all output visible before pausing
+	BondHisRiskConnector::create_connector()->Flush();
+	BondHisExecutionConnector::create_connector()->Flush();
+	BondHisStreamingConnector::create_connector()->Flush();
+	BondHisInquiryConnector::create_connector()->Flush();
 
 	system("pause");
 
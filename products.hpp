@@ -9,6 +9,9 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <memory>
+#include "ProductRegistry.h"
 
 #include "boost/date_time/gregorian/gregorian.hpp"
 
@@ -29,6 +32,8 @@ public:
 	Product(string _productId, ProductType _productType) {
 		productId = _productId;
 		productType = _productType;
+		securityId = SecurityId::Parse(productId);
+		productIndex = securityId.IsValid() ? ProductRegistry::create_registry()->Intern(securityId) : ProductRegistry::create_registry()->Intern(productId);
 	}
 
 
@@ -44,8 +49,22 @@ public:
 	}
 
 
+	// Get the product identifier packed, the empty SecurityId if it is not a CUSIP or ISIN
+	SecurityId GetSecurityId() const {
+		return securityId;
+	}
+
+
+	// Get the dense index of the product identifier, see ProductRegistry
+	ProductIndex GetProductIndex() const {
+		return productIndex;
+	}
+
+
 private:
 	string productId;
+	SecurityId securityId;
+	ProductIndex productIndex;
 	ProductType productType;
 
 };
@@ -110,11 +129,10 @@ public:
 
 
 private:
-	std::string productId;
-	BondIdType bondIdType;
 	std::string ticker;
-	float coupon;
 	date maturityDate;
+	float coupon;
+	BondIdType bondIdType;
 };
 
 /******************************** Code for derived classes *****************************/
@@ -122,36 +140,68 @@ private:
 class BondProductService
 {
 private:
-	// a map of bond products
-	std::map<std::string, Bond> bondMap; 
-	// BondProductService ctor
+	// bond products by product index, each allocated once and never changed, so events can point at it
+	std::vector<std::unique_ptr<const Bond>> bondMap;
+	// BondProductService ctor, the default bond is kept from the start so events built on other threads only read
 	BondProductService()
 	{
-		bondMap = std::map<std::string, Bond>();
+		Bond defaultBond;
+		Store(defaultBond.GetProductIndex(), defaultBond);
+	};
+
+	// the bond kept for index, bond stored there if there is none yet
+	const Bond& Store(ProductIndex index, const Bond& bond)
+	{
+		if (index >= bondMap.size()) bondMap.resize(std::max<size_t>(index + 1, ProductRegistry::create_registry()->Size()));
+		if (!bondMap[index]) bondMap[index].reset(new Bond(bond));
+		return *bondMap[index];
 	};
 
 public:
-	// get bond info given cusip
-	Bond& GetData(std::string key)
+	// get bond info given cusip, a default bond if it was never added
+	const Bond& GetData(std::string key)
+	{
+		ProductIndex index = ProductRegistry::create_registry()->Find(key);
+		return index == NO_PRODUCT_INDEX ? Intern(Bond()) : GetData(index);
+	};
+
+	// get bond info given its packed cusip or isin, a default bond if it was never added
+	const Bond& GetData(SecurityId security)
 	{
-		return bondMap[key];
+		ProductIndex index = ProductRegistry::create_registry()->Find(security);
+		return index == NO_PRODUCT_INDEX ? Intern(Bond()) : GetData(index);
 	};
 
-	// add a bond to a service
-	void Add(Bond &bond)
+	// get bond info given its product index
+	const Bond& GetData(ProductIndex index)
 	{
-		bondMap.insert(std::make_pair(bond.GetProductId(), bond));
+		if (index < bondMap.size() && bondMap[index]) return *bondMap[index];
+		return Store(index, Bond());
 	};
 
-	// get all bonds based on a ticker
+	// add a bond to a service, a bond already added for its cusip stays
+	void Add(const Bond &bond)
+	{
+		Store(bond.GetProductIndex(), bond);
+	};
+
+	// the shared instance of bond, added if its cusip is new
+	const Bond& Intern(const Bond& bond)
+	{
+		ProductIndex index = bond.GetProductIndex();
+		if (index < bondMap.size() && bondMap[index]) return *bondMap[index];
+		return Store(index, bond);
+	};
+
+	// get all bonds based on a ticker, in product index order
 	std::vector<Bond> GetBonds(const std::string& tik) const
 	{
 		std::vector<Bond> bondVec;
 		for (auto& bd : bondMap)
 		{
-			if (bd.second.GetTicker() == tik)
+			if (bd && bd->GetTicker() == tik)
 			{
-				bondVec.push_back(bd.second);
+				bondVec.push_back(*bd);
 			}
 		}
 		return bondVec;
@@ -165,6 +215,39 @@ public:
 	};
 };
 
+// the one shared instance of a bond, owned by BondProductService
+inline const Bond& CanonicalProduct(const Bond& bond)
+{
+	return BondProductService::create_service()->Intern(bond);
+}
+
+/**
+* What events hold instead of a copy of their product: a pointer to the shared, immutable instance of it.
+* Built from any instance of the product, it resolves to the one CanonicalProduct returns, so copying an event
+* copies a pointer rather than the product's strings and dates.
+*/
+template<typename T>
+class ProductHandle
+{
+private:
+	const T* product;
+
+public:
+	// the default product, as a default constructed event had before
+	ProductHandle()
+	{
+		static const T* defaultProduct = &CanonicalProduct(T());
+		product = defaultProduct;
+	};
+
+	ProductHandle(const T& _product) : product(&CanonicalProduct(_product)) {};
+
+	const T& Get() const
+	{
+		return *product;
+	};
+};
+
 
 
 /**
@@ -9,6 +9,7 @@
 #define SOA_HPP
 
 #include <vector>
+#include <cstddef>
 
 using namespace std;
 
@@ -32,6 +33,12 @@ public:
   // Listener callback to process an update event to the Service
   virtual void ProcessUpdate(V &data) = 0;
 
+  // Listener callback to process count add events at once, by default one ProcessAdd per event
+  virtual void ProcessAddBatch(V *data, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i) ProcessAdd(data[i]);
+  }
+
 };
 
 /**
@@ -50,6 +57,12 @@ public:
   // The callback that a Connector should invoke for any new or updated data
   virtual void OnMessage(V &data) = 0;
 
+  // The callback for count new or updated data at once, by default one OnMessage per event
+  virtual void OnMessageBatch(V *data, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i) OnMessage(data[i]);
+  }
+
   // Add a listener to the Service for callbacks on add, remove, and update events
   // for data to the Service.
   virtual void AddListener(ServiceListener<V> *listener) = 0;
@@ -76,6 +89,113 @@ public:
   // Publish data to the Connector
   virtual void Publish(V &data) = 0;
 
+  // Publish count data at once, by default one Publish per event
+  virtual void PublishBatch(V *data, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i) Publish(data[i]);
+  }
+
+};
+
+/**
+ * Compile-time wiring of services, for chains that do not need to change at run time.
+ * A stage is a type with a member template
+ *   template<typename Next> void Process(V &data, Next &next)
+ * that does the work of one service on data and calls next(output) for each output it produces, where a service
+ * wired with AddListener would notify its listeners. StaticPipeline<S1, S2, ..., Sn> passes its input to S1, the
+ * outputs of S1 to S2 and so on, all through templates, so the compiler sees the whole chain and can inline the
+ * hops into one call. Stages default construct and are expected to reach their services through create_service().
+ * Listeners added with AddListener to the services inside a static chain are not notified by it.
+ */
+template<typename... Stages>
+class StaticPipeline;
+
+template<>
+class StaticPipeline<>
+{
+
+public:
+
+  // end of the chain, outputs of the last stage are dropped
+  template<typename V>
+  void operator()(V &) {}
+
+};
+
+template<typename Stage, typename... Rest>
+class StaticPipeline<Stage, Rest...>
+{
+
+public:
+
+  // run data through this stage and its outputs through the rest
+  template<typename V>
+  void operator()(V &data)
+  {
+    stage.Process(data, rest);
+  }
+
+private:
+
+  Stage stage;
+  StaticPipeline<Rest...> rest;
+
+};
+
+/**
+ * Stage calling an existing listener L as the end of a static chain.
+ * The call names L's ProcessAdd directly, so it is not dispatched through the vtable and can be inlined.
+ */
+template<typename L>
+class ListenerStage
+{
+
+public:
+
+  ListenerStage() : listener(L::create_listener()) {}
+
+  template<typename V, typename Next>
+  void Process(V &data, Next &)
+  {
+    listener->L::ProcessAdd(data);
+  }
+
+private:
+
+  L *listener;
+
+};
+
+/**
+ * ServiceListener running a StaticPipeline, to hang a statically wired chain off a service wired with AddListener.
+ * Only the hop into the chain is a virtual call.
+ */
+template<typename V, typename Pipeline>
+class PipelineListener : public ServiceListener<V>
+{
+
+public:
+
+  void ProcessAdd(V &data) override
+  {
+    pipeline(data);
+  }
+
+  // the stages only carry adds
+  void ProcessRemove(V &) override {}
+
+  void ProcessUpdate(V &) override {}
+
+  static PipelineListener *create_listener()
+  {
+    static PipelineListener listener;
+    return &listener;
+  }
+
+private:
+
+  Pipeline pipeline;
+
 };
 
 #endif